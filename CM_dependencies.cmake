@@ -4,5 +4,6 @@
 
 FIND_PACKAGE (Threads			REQUIRED)
 FIND_PACKAGE (OpenCV	CONFIG	REQUIRED)
+FIND_PACKAGE (OpenMP			REQUIRED)
 
 INCLUDE_DIRECTORIES (${OpenCV_INCLUDE_DIRS})
@@ -2,13 +2,1519 @@
 // MIT license applies.  See "license.txt" for details.
 
 #include "darknet-ng.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <numeric>
+#include <omp.h>
+#include <optional>
+#include <sstream>
+
+
+int compile_cfg(const std::filesystem::path & cfg_filename, const std::filesystem::path & plan_filename)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+		network.save_plan(plan_filename);
+
+		std::cout << "compiled " << cfg_filename.string() << " (" << network.layers.size() << " layers) to " << plan_filename.string() << std::endl;
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_gemm()
+{
+	// typical (m, n, k) shapes from the convolutional layers of YOLOv4 at 416x416:  m is the number of filters, n is the
+	// output width x height, and k is the kernel size x kernel size x input channels
+	const std::vector<std::array<int, 3>> shapes =
+	{
+		{  32, 173056,   27 },
+		{  64,  43264,  288 },
+		{ 128,  10816,  576 },
+		{ 256,   2704, 1152 },
+		{ 512,    676, 2304 },
+		{1024,    169, 4608 },
+		{ 255,    676,  512 },
+		{ 128,   2704,  256 },
+	};
+
+	std::cout << "GEMM microkernel: " << Darknet_ng::gemm_kernel_name() << std::endl;
+
+	for (const auto & [m, n, k] : shapes)
+	{
+		Darknet_ng::VF a(static_cast<size_t>(m) * k);
+		Darknet_ng::VF b(static_cast<size_t>(k) * n);
+		Darknet_ng::VF c(static_cast<size_t>(m) * n);
+		Darknet_ng::VF r(static_cast<size_t>(m) * n);
+		for (size_t i = 0; i < a.size(); i ++) a[i] = std::sin(i * 0.37f);
+		for (size_t i = 0; i < b.size(); i ++) b[i] = std::cos(i * 0.11f);
+
+		const auto time_it = [&](auto && fn) -> double
+		{
+			fn(); // warm up the caches and the packing buffers
+			const int iterations = 3;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i ++)
+			{
+				fn();
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double>(end - start).count() / iterations;
+		};
+
+		const double packed_time	= time_it([&]() { Darknet_ng::gemm			(0, 0, m, n, k, 1.0f, a.data(), k, b.data(), n, 0.0f, c.data(), n); });
+		const double reference_time	= time_it([&]() { std::fill(r.begin(), r.end(), 0.0f); Darknet_ng::gemm_reference(0, 0, m, n, k, 1.0f, a.data(), k, b.data(), n, 1.0f, r.data(), n); });
+
+		float max_diff = 0.0f;
+		float max_val = 1.0f;
+		for (size_t i = 0; i < c.size(); i ++)
+		{
+			max_diff	= std::max(max_diff	, std::fabs(c[i] - r[i]));
+			max_val		= std::max(max_val	, std::fabs(r[i]));
+		}
+
+		const double flops = 2.0 * m * n * k;
+		std::printf("m=%5d n=%7d k=%5d:  %8.2f GFLOPS  (reference %7.2f GFLOPS, %5.1fx)  rel diff=%g\n",
+				m, n, k,
+				flops / packed_time / 1.0e9,
+				flops / reference_time / 1.0e9,
+				reference_time / packed_time,
+				max_diff / max_val);
+	}
+
+	return 0;
+}
+
+
+namespace
+{
+	/// The size of @ref Darknet_ng::Layer before the training, recurrent, and GPU state was moved out of it.
+	constexpr size_t kLegacyLayerSize = 2616;
+
+	/** The original @p layer was a plain C structure, so @p "layer l = net.layers[i]" and every call through @p l.forward()
+	 * copied the entire structure.  @ref Darknet_ng::Layer is now much smaller and is not trivially copyable, so this is a
+	 * trivially copyable block of the original size which points at the real layer.  Copying it costs the same as copying
+	 * the original structure did.
+	 */
+	struct LegacyLayer final
+	{
+		Darknet_ng::Layer * layer;
+		unsigned char fields[kLegacyLayerSize - sizeof(Darknet_ng::Layer *)];
+	};
+	static_assert(sizeof(LegacyLayer) == kLegacyLayerSize);
+
+	/// The signature of the original @p forward pointer stored in every layer.  Both structures are passed by value.
+	using LegacyForward = void(*)(LegacyLayer l, Darknet_ng::NetworkState state);
+
+
+	template <Darknet_ng::LayerKernel kernel>
+	void legacy_forward(LegacyLayer l, Darknet_ng::NetworkState state)
+	{
+		kernel(*l.layer, state);
+
+		return;
+	}
+
+
+	/// The equivalent of the @p forward pointer which the original code stored in every layer.
+	LegacyForward get_legacy_forward(const Darknet_ng::ELayerType layer_type)
+	{
+		switch (layer_type)
+		{
+			case Darknet_ng::ELayerType::kConvolutional:	return legacy_forward<Darknet_ng::forward_convolutional_layer>;
+			case Darknet_ng::ELayerType::kMaxPool:			return legacy_forward<Darknet_ng::forward_maxpool_layer>;
+			case Darknet_ng::ELayerType::kRoute:			return legacy_forward<Darknet_ng::forward_route_layer>;
+			case Darknet_ng::ELayerType::kShortcut:			return legacy_forward<Darknet_ng::forward_shortcut_layer>;
+			case Darknet_ng::ELayerType::kUpsample:			return legacy_forward<Darknet_ng::forward_upsample_layer>;
+			case Darknet_ng::ELayerType::kYOLO:				return legacy_forward<Darknet_ng::forward_yolo_layer>;
+			default:										break;
+		}
+
+		/// @throw Exception There is no forward kernel for this type of layer.
+		throw Darknet_ng::Exception("layer type #" + std::to_string(static_cast<int>(layer_type)) + " does not have a forward kernel", DNG_LOC);
+	}
+
+
+	/** A transliteration of @p forward_network() from @p src-old/network.c, kept to benchmark @ref Darknet_ng::Network::forward()
+	 * against.  The layers are copied and dispatched by value exactly like the original loop.  The only difference is the
+	 * state references the network by pointer, since the original @p network_state contained a copy of the network.
+	 */
+	void forward_network_reference(const Darknet_ng::Network & net, const std::vector<LegacyLayer> & legacy_layers, const std::vector<LegacyForward> & forwards, Darknet_ng::NetworkState state)
+	{
+		state.workspace = net.get_workspace();
+		state.net = &net;
+		state.layers = net.layers.data();
+		for (size_t i = 0; i < net.layers.size(); ++i)
+		{
+			state.index = i;
+			LegacyLayer l = legacy_layers[i];
+			forwards[i](l, state);
+			state.input = l.layer->output;
+		}
+
+		return;
+	}
+}
+
+
+int benchmark_forward(const std::filesystem::path & cfg_filename)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+		network.fuse_layers();
+
+		const Darknet_ng::Layer & last = network.layers.back();
+		const size_t output_size = static_cast<size_t>(last.batch) * last.outputs;
+
+		Darknet_ng::VF input(static_cast<size_t>(network.settings.batch) * network.settings.w * network.settings.h * network.settings.c);
+		for (size_t i = 0; i < input.size(); i ++)
+		{
+			input[i] = std::fabs(std::sin(i * 0.37f));
+		}
+
+		std::vector<LegacyLayer> legacy_layers;
+		std::vector<LegacyForward> forwards;
+		for (auto & layer : network.layers)
+		{
+			LegacyLayer l;
+			std::memset(&l, '\0', sizeof(l));
+			l.layer = &layer;
+			legacy_layers.push_back(l);
+			forwards.push_back(get_legacy_forward(layer.type));
+		}
+
+		Darknet_ng::NetworkState state;
+		std::memset(&state, '\0', sizeof(state));
+		state.input = input.data();
+
+		const auto run_reference	= [&]() { forward_network_reference(network, legacy_layers, forwards, state); };
+		const auto run_forward		= [&]() { Darknet_ng::NetworkState s = state; network.forward(s); };
+
+		// warm up the caches, and remember the results of both
+		run_reference();
+		const Darknet_ng::VF expected(last.output, last.output + output_size);
+		run_forward();
+		const Darknet_ng::VF result(last.output, last.output + output_size);
+
+		const auto time_it = [](auto && fn) -> double
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			fn();
+			const auto end = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double>(end - start).count();
+		};
+
+		/* The difference between the two is small compared to the time spent in the layers, so the runs are interleaved
+		 * to avoid favouring either one, and the best time of each is kept.
+		 */
+		double reference_time	= 0.0;
+		double forward_time		= 0.0;
+		const int iterations = 10;
+		for (int i = 0; i < iterations; i ++)
+		{
+			const double r = time_it(run_reference);
+			const double f = time_it(run_forward);
+			reference_time	= (i == 0 ? r : std::min(reference_time	, r));
+			forward_time	= (i == 0 ? f : std::min(forward_time	, f));
+		}
+
+		// both run the exact same kernels, so compare the bits (the weights are random, so some outputs may be NaN)
+		size_t mismatches = 0;
+		for (size_t i = 0; i < output_size; i ++)
+		{
+			if (std::memcmp(&expected[i], &result[i], sizeof(float)) != 0)
+			{
+				mismatches ++;
+			}
+		}
+
+		std::printf("%s (%d layers, %zu bytes per layer copy):  %8.3f ms  (reference %8.3f ms, %5.3fx)  %s\n",
+				cfg_filename.filename().string().c_str(),
+				static_cast<int>(network.layers.size()),
+				sizeof(LegacyLayer),
+				forward_time * 1000.0,
+				reference_time * 1000.0,
+				reference_time / forward_time,
+				(mismatches == 0 ? "OK" : ("MISMATCH in " + std::to_string(mismatches) + " values").c_str()));
+
+		if (mismatches)
+		{
+			return 1;
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_winograd(const std::filesystem::path & cfg_filename)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+		network.fuse_layers();
+
+		std::cout << "GEMM microkernel: " << Darknet_ng::gemm_kernel_name() << std::endl;
+
+		double winograd_total = 0.0;
+		double direct_total = 0.0;
+
+		for (auto & layer : network.layers)
+		{
+			if (layer.type != Darknet_ng::ELayerType::kConvolutional or layer.conv_algorithm != Darknet_ng::EConvAlgorithm::kWinograd)
+			{
+				continue;
+			}
+
+			Darknet_ng::VF input(static_cast<size_t>(layer.inputs) * layer.batch);
+			for (size_t i = 0; i < input.size(); i ++)
+			{
+				input[i] = std::fabs(std::sin(i * 0.37f));
+			}
+
+			Darknet_ng::NetworkState state;
+			std::memset(&state, '\0', sizeof(state));
+			state.input		= input.data();
+			state.workspace	= network.get_workspace();
+			state.net		= &network;
+
+			const auto time_it = [&](const Darknet_ng::EConvAlgorithm algorithm) -> double
+			{
+				layer.conv_algorithm = algorithm;
+				Darknet_ng::forward_convolutional_layer(layer, state); // warm up the caches
+				const int iterations = 3;
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i ++)
+				{
+					Darknet_ng::forward_convolutional_layer(layer, state);
+				}
+				const auto end = std::chrono::high_resolution_clock::now();
+				return std::chrono::duration<double>(end - start).count() / iterations;
+			};
+
+			const double direct_time = time_it(Darknet_ng::EConvAlgorithm::kImplicitGEMM);
+			const Darknet_ng::VF direct(layer.output, layer.output + layer.outputs * layer.batch);
+			const double winograd_time = time_it(Darknet_ng::EConvAlgorithm::kWinograd);
+
+			float max_diff = 0.0f;
+			float max_val = 1.0e-6f;
+			for (size_t i = 0; i < direct.size(); i ++)
+			{
+				max_diff	= std::max(max_diff	, std::fabs(direct[i] - layer.output[i]));
+				max_val		= std::max(max_val	, std::fabs(direct[i]));
+			}
+
+			winograd_total	+= winograd_time;
+			direct_total	+= direct_time;
+
+			std::printf("layer #%3d %4d x %3d x %3d -> %4d:  winograd %8.3f ms  (implicit GEMM %8.3f ms, %5.2fx)  rel diff=%g\n",
+					layer.index, layer.c, layer.h, layer.w, layer.n,
+					winograd_time * 1000.0,
+					direct_time * 1000.0,
+					direct_time / winograd_time,
+					max_diff / max_val);
+		}
+
+		std::printf("total:  winograd %.3f ms  (implicit GEMM %.3f ms, %.2fx)\n", winograd_total * 1000.0, direct_total * 1000.0, direct_total / std::max(winograd_total, 1.0e-9));
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_blocked(const std::filesystem::path & cfg_filename)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+
+		/* Without a .weights file the rolling variance is zero, so every batch-normalized layer multiplies its outputs by
+		 * about 300 and the activations overflow.  A variance of 1 keeps them finite so the comparison below is meaningful.
+		 */
+		for (auto & layer : network.layers)
+		{
+			if (layer.type == Darknet_ng::ELayerType::kConvolutional and layer.batch_normalize and layer.share_layer == nullptr)
+			{
+				std::fill(layer.rolling_variance, layer.rolling_variance + layer.n, 1.0f);
+			}
+		}
+		network.fuse_layers();
+
+		std::cout << "blocked kernels: " << Darknet_ng::blocked_kernel_name() << std::endl;
+
+		const size_t batch			= network.settings.batch;
+		const size_t output_size	= batch * network.layers.back().outputs;
+
+		Darknet_ng::VF input(batch * network.settings.w * network.settings.h * network.settings.c);
+		for (size_t i = 0; i < input.size(); i ++)
+		{
+			input[i] = std::fabs(std::sin(i * 0.37f));
+		}
+
+		// switching the layout re-orders the weights, so all the runs with one layout are done before switching to the other
+		const auto time_it = [&](Darknet_ng::VF & output) -> double
+		{
+			network.predict(input.data(), batch); // warm up the caches
+			double best = 0.0;
+			const int iterations = 5;
+			for (int i = 0; i < iterations; i ++)
+			{
+				const auto start = std::chrono::high_resolution_clock::now();
+				const float * result = network.predict(input.data(), batch);
+				const auto end = std::chrono::high_resolution_clock::now();
+				const double duration = std::chrono::duration<double>(end - start).count();
+				best = (i == 0 ? duration : std::min(best, duration));
+				output.assign(result, result + output_size);
+			}
+			return best;
+		};
+
+		Darknet_ng::VF nchw;
+		Darknet_ng::VF blocked;
+		Darknet_ng::VF restored;
+		const double nchw_time = time_it(nchw);
+
+		network.use_blocked_layout(true);
+		const int blocked_layers = std::count_if(network.layers.begin(), network.layers.end(), [](const Darknet_ng::Layer & layer) { return layer.blocked; });
+		const double blocked_time = time_it(blocked);
+
+		network.use_blocked_layout(false);
+		time_it(restored);
+
+		/* The blocked kernels add up the channels in a different order, so the results are compared within a tolerance.
+		 * Going back to NCHW must give the exact same bits as before.
+		 */
+		float max_diff	= 0.0f;
+		float max_val	= 1.0e-6f;
+		size_t nan_mismatches = 0;
+		for (size_t i = 0; i < output_size; i ++)
+		{
+			if (std::isnan(nchw[i]) or std::isnan(blocked[i]))
+			{
+				nan_mismatches += (std::isnan(nchw[i]) != std::isnan(blocked[i]) ? 1 : 0);
+				continue;
+			}
+			max_diff	= std::max(max_diff	, std::fabs(nchw[i] - blocked[i]));
+			max_val		= std::max(max_val	, std::fabs(nchw[i]));
+		}
+		const bool restored_ok = (std::memcmp(nchw.data(), restored.data(), output_size * sizeof(float)) == 0);
+		const bool ok = (nan_mismatches == 0 and max_diff / max_val <= 1.0e-4f and restored_ok);
+
+		std::printf("%s (%d of %d layers blocked):  blocked %8.3f ms  (NCHW %8.3f ms, %5.3fx)  rel diff=%g%s  %s\n",
+				cfg_filename.filename().string().c_str(),
+				blocked_layers,
+				static_cast<int>(network.layers.size()),
+				blocked_time * 1000.0,
+				nchw_time * 1000.0,
+				nchw_time / blocked_time,
+				max_diff / max_val,
+				(restored_ok ? "" : ", NCHW not restored"),
+				(ok ? "OK" : "MISMATCH"));
+
+		if (not ok)
+		{
+			return 1;
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int autotune(const std::filesystem::path & cfg_filename, const std::filesystem::path & cache_filename, const size_t batch)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+		network.fuse_layers();
+		network.autotune(cache_filename, batch);
+
+		for (const auto & layer : network.layers)
+		{
+			if (layer.type == Darknet_ng::ELayerType::kConvolutional)
+			{
+				std::printf("layer #%3d %4d x %3d x %3d -> %4d  size=%d stride=%d groups=%-4d %s\n",
+						layer.index, layer.c, layer.h, layer.w, layer.n, layer.size, layer.stride_x, layer.groups,
+						Darknet_ng::to_string(layer.conv_algorithm).c_str());
+			}
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_contexts(const std::filesystem::path & cfg_filename, const int threads)
+{
+	try
+	{
+		Darknet_ng::Network network(cfg_filename);
+		network.fuse_layers();
+
+		const size_t input_size		= static_cast<size_t>(network.settings.w) * network.settings.h * network.settings.c;
+		const size_t output_size	= network.layers.back().outputs;
+
+		Darknet_ng::VF input(input_size);
+		for (size_t i = 0; i < input.size(); i ++)
+		{
+			input[i] = std::fabs(std::sin(i * 0.37f));
+		}
+
+		// warm up the caches, and remember the results of the network itself
+		network.predict(input.data());
+		const float * output = network.predict(input.data());
+		const Darknet_ng::VF expected(output, output + output_size);
+
+		// the same number of images one after the other on the network, each of them using all the OpenMP threads
+		const int iterations = 3;
+		const auto serial_start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < threads * iterations; i ++)
+		{
+			network.predict(input.data());
+		}
+		const auto serial_end = std::chrono::high_resolution_clock::now();
+		const double serial_time = std::chrono::duration<double>(serial_end - serial_start).count();
+
+		// ...and side-by-side on one context per thread, where each layer runs on a single thread
+		size_t mismatches		= 0;
+		size_t context_size		= 0;
+		double parallel_time	= 0.0;
+		#pragma omp parallel num_threads(threads) reduction(+:mismatches)
+		{
+			Darknet_ng::InferenceContext context(network);
+			context.predict(input.data());
+
+			const float * result = nullptr;
+			#pragma omp barrier
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i ++)
+			{
+				result = context.predict(input.data());
+			}
+			#pragma omp barrier
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			// the same kernels run on the same weights, so compare the bits (the weights are random, so some outputs may be NaN)
+			for (size_t i = 0; i < output_size; i ++)
+			{
+				if (std::memcmp(&expected[i], &result[i], sizeof(float)) != 0)
+				{
+					mismatches ++;
+				}
+			}
+
+			#pragma omp master
+			{
+				context_size	= context.size();
+				parallel_time	= std::chrono::duration<double>(end - start).count();
+			}
+		}
+
+		const int images = threads * iterations;
+		std::printf("%s with %d threads:  %d contexts %8.3f images/sec  (1 network %8.3f images/sec, %5.2fx)  %s\n",
+				cfg_filename.filename().string().c_str(),
+				threads,
+				threads,
+				images / parallel_time,
+				images / serial_time,
+				serial_time / parallel_time,
+				(mismatches == 0 ? "OK" : ("MISMATCH in " + std::to_string(mismatches) + " values").c_str()));
+		std::printf("each context uses %1.2f MB, the network arena with the weights is %1.2f MB\n",
+				context_size / 1000000.0,
+				network.arena.size() / 1000000.0);
+
+		if (mismatches)
+		{
+			return 1;
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_config(const std::filesystem::path & directory)
+{
+	try
+	{
+		std::vector<std::filesystem::path> filenames;
+		for (const auto & entry : std::filesystem::directory_iterator(directory))
+		{
+			if (entry.path().extension() == ".cfg")
+			{
+				filenames.push_back(entry.path());
+			}
+		}
+		std::sort(filenames.begin(), filenames.end());
+
+		const auto time_it = [](auto && fn) -> double
+		{
+			fn(); // warm up the file cache and the interned keys
+			const int iterations = 5;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; i ++)
+			{
+				fn();
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double>(end - start).count() / iterations;
+		};
+
+		double scanner_total = 0.0;
+		double reference_total = 0.0;
+		size_t failures = 0;
+
+		for (const auto & filename : filenames)
+		{
+			Darknet_ng::Config scanner;
+			Darknet_ng::Config reference;
+
+			bool scanner_ok = true;
+			bool reference_ok = true;
+			try { scanner.read(filename); } catch (const std::exception &) { scanner_ok = false; }
+			try { reference.read_reference(filename); } catch (const std::exception &) { reference_ok = false; }
+
+			if (not scanner_ok or not reference_ok)
+			{
+				// lines with nothing but whitespace are only accepted by the scanner
+				const bool expected = (scanner_ok or not reference_ok);
+				std::printf("%-40s  scanner %s, reference %s  %s\n",
+						filename.filename().string().c_str(),
+						(scanner_ok ? "ok" : "failed"),
+						(reference_ok ? "ok" : "failed"),
+						(expected ? "SKIPPED" : "MISMATCH"));
+				if (not expected)
+				{
+					failures ++;
+				}
+				continue;
+			}
+
+			/* The reference parser keeps any whitespace between the value and an inline "#" comment, which the scanner
+			 * strips.  Apart from that the sections, keys, and values must be identical.
+			 */
+			size_t mismatches = 0;
+			if (scanner.sections.size() != reference.sections.size())
+			{
+				mismatches ++;
+			}
+			for (size_t idx = 0; idx < std::min(scanner.sections.size(), reference.sections.size()); idx ++)
+			{
+				const auto & lhs = scanner.sections[idx];
+				const auto & rhs = reference.sections[idx];
+				if (lhs.name != rhs.name or lhs.line_number != rhs.line_number or lhs.options.size() != rhs.options.size())
+				{
+					mismatches ++;
+					continue;
+				}
+				for (size_t opt = 0; opt < lhs.options.size(); opt ++)
+				{
+					if (lhs.options[opt].key != rhs.options[opt].key or
+						lhs.options[opt].value != Darknet_ng::strip_text(rhs.options[opt].value))
+					{
+						mismatches ++;
+					}
+				}
+			}
+
+			const double scanner_time	= time_it([&]() { Darknet_ng::Config cfg; cfg.read(filename); });
+			const double reference_time	= time_it([&]() { Darknet_ng::Config cfg; cfg.read_reference(filename); });
+			scanner_total	+= scanner_time;
+			reference_total	+= reference_time;
+
+			std::printf("%-40s  %4zu sections:  %8.3f ms  (reference %8.3f ms, %5.2fx)  %s\n",
+					filename.filename().string().c_str(),
+					scanner.sections.size(),
+					scanner_time * 1000.0,
+					reference_time * 1000.0,
+					reference_time / scanner_time,
+					(mismatches == 0 ? "OK" : ("MISMATCH in " + std::to_string(mismatches) + " sections or values").c_str()));
+
+			if (mismatches)
+			{
+				failures ++;
+			}
+		}
+
+		std::printf("total:  %8.3f ms  (reference %8.3f ms, %5.2fx)\n",
+				scanner_total * 1000.0,
+				reference_total * 1000.0,
+				reference_total / scanner_total);
+
+		if (failures)
+		{
+			return 1;
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+namespace
+{
+	/** The map-based section lookups used before options were parsed up front and stored in @ref Darknet_ng::Section::options.
+	 * This is a straight transliteration of the original @p Section accessors (minus the debug output), kept to check the
+	 * new accessors against.  Every call returns either the value, or @p std::nullopt if the original would have thrown.
+	 */
+	struct ReferenceSection final
+	{
+		explicit ReferenceSection(const Darknet_ng::Section & section)
+		{
+			for (const auto & option : section.options)
+			{
+				kv_pairs[Darknet_ng::key_name(option.key)] = option.value;
+			}
+		}
+
+		std::optional<int> i(const std::string & key) const
+		{
+			try
+			{
+				return std::stod(kv_pairs.at(Darknet_ng::lowercase(key)));
+			}
+			catch (const std::exception &)
+			{
+				return std::nullopt;
+			}
+		}
+
+		std::optional<float> f(const std::string & key) const
+		{
+			try
+			{
+				return std::stof(kv_pairs.at(Darknet_ng::lowercase(key)));
+			}
+			catch (const std::exception &)
+			{
+				return std::nullopt;
+			}
+		}
+
+		std::optional<bool> b(const std::string & key) const
+		{
+			const auto iter = kv_pairs.find(Darknet_ng::lowercase(key));
+			if (iter == kv_pairs.end())
+			{
+				return std::nullopt;
+			}
+
+			const std::string val = Darknet_ng::lowercase(iter->second);
+			if (val == "0" or val == "f" or val == "off" or val == "false")
+			{
+				return false;
+			}
+			if (val == "1" or val == "t" or val == "on" or val == "true")
+			{
+				return true;
+			}
+
+			return std::nullopt;
+		}
+
+		std::optional<std::string> s(const std::string & key) const
+		{
+			const auto iter = kv_pairs.find(Darknet_ng::lowercase(key));
+			if (iter == kv_pairs.end())
+			{
+				return std::nullopt;
+			}
+
+			return iter->second;
+		}
+
+		template <typename T, typename F>
+		std::optional<std::vector<T>> list(const std::string & key, F && convert) const
+		{
+			std::vector<T> v;
+			std::string token;
+			std::stringstream ss(s(key).value_or(""));
+			try
+			{
+				while (std::getline(ss, token, ','))
+				{
+					v.push_back(convert(token));
+				}
+			}
+			catch (const std::exception &)
+			{
+				return std::nullopt;
+			}
+
+			return v;
+		}
+
+		std::optional<Darknet_ng::VI> vi(const std::string & key) const { return list<int>	(key, [](const std::string & t) { return std::stoi(t); }); }
+		std::optional<Darknet_ng::VF> vf(const std::string & key) const { return list<float>(key, [](const std::string & t) { return std::stof(t); }); }
+
+		std::map<std::string, std::string> kv_pairs;
+	};
+
+
+	/// Call one of the @ref Darknet_ng::Section accessors, turning any exception into @p std::nullopt.
+	template <typename F>
+	auto try_accessor(F && fn) -> std::optional<std::decay_t<decltype(fn())>>
+	{
+		try
+		{
+			return fn();
+		}
+		catch (const std::exception &)
+		{
+			return std::nullopt;
+		}
+	}
+
+
+	/// Floats are compared bit-for-bit since both sides are expected to have been parsed from the exact same text.
+	bool same_value(const float lhs, const float rhs)
+	{
+		return std::memcmp(&lhs, &rhs, sizeof(float)) == 0;
+	}
+
+
+	template <typename T>
+	bool same_value(const T & lhs, const T & rhs)
+	{
+		return lhs == rhs;
+	}
+
+
+	bool same_value(const Darknet_ng::VF & lhs, const Darknet_ng::VF & rhs)
+	{
+		return lhs.size() == rhs.size() and std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const float l, const float r) { return same_value(l, r); });
+	}
+
+
+	template <typename T>
+	bool same_value(const std::optional<T> & lhs, const std::optional<T> & rhs)
+	{
+		return lhs.has_value() == rhs.has_value() and (not lhs.has_value() or same_value(*lhs, *rhs));
+	}
+}
+
+
+int check_config_options(const std::filesystem::path & directory)
+{
+	try
+	{
+		std::vector<std::filesystem::path> filenames;
+		for (const auto & entry : std::filesystem::directory_iterator(directory))
+		{
+			if (entry.path().extension() == ".cfg")
+			{
+				filenames.push_back(entry.path());
+			}
+		}
+		std::sort(filenames.begin(), filenames.end());
+
+		size_t failures = 0;
+
+		for (const auto & filename : filenames)
+		{
+			Darknet_ng::Config cfg;
+			try
+			{
+				cfg.read(filename);
+			}
+			catch (const std::exception &)
+			{
+				std::printf("%-40s  cannot be parsed  SKIPPED\n", filename.filename().string().c_str());
+				continue;
+			}
+
+			size_t lookups = 0;
+			std::vector<std::string> mismatches;
+
+			// the accessors print every value they return, which is not what we want to see here
+			std::stringstream discard;
+			auto * const cout_buffer = std::cout.rdbuf(discard.rdbuf());
+
+			for (const auto & section : cfg.sections)
+			{
+				const ReferenceSection reference(section);
+
+				// check every key in this section, once in lowercase and once in uppercase, and a key which does not exist
+				std::vector<std::string> keys;
+				for (const auto & [key, val] : reference.kv_pairs)
+				{
+					keys.push_back(key);
+					std::string upper = key;
+					std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+					keys.push_back(upper);
+				}
+				keys.push_back("no_such_key");
+
+				for (const auto & key : keys)
+				{
+					const auto compare = [&](const std::string & accessor, const auto & expected, const auto & result)
+					{
+						lookups ++;
+						if (not same_value(expected, result))
+						{
+							mismatches.push_back("[" + section.name + "] line #" + std::to_string(section.line_number) + " " + accessor + "(" + key + ")");
+						}
+					};
+
+					const auto s = reference.s(key);
+
+					compare("i"		, reference.i(key)				, try_accessor([&]() { return section.i(key);			}));
+					compare("f"		, reference.f(key)				, try_accessor([&]() { return section.f(key);			}));
+					compare("b"		, reference.b(key)				, try_accessor([&]() { return section.b(key);			}));
+					compare("s"		, s								, try_accessor([&]() { return section.s(key);			}));
+					compare("vi"	, reference.vi(key)				, try_accessor([&]() { return section.vi(key);			}));
+					compare("vf"	, reference.vf(key)				, try_accessor([&]() { return section.vf(key);			}));
+					compare("i/def"	, s ? reference.i(key) : 7		, try_accessor([&]() { return section.i(key, 7);		}));
+					compare("f/def"	, s ? reference.f(key) : 0.5f	, try_accessor([&]() { return section.f(key, 0.5f);		}));
+					compare("b/def"	, s ? reference.b(key) : true	, try_accessor([&]() { return section.b(key, true);		}));
+					compare("s/def"	, s ? s : std::string("x")		, try_accessor([&]() { return section.s(key, "x");		}));
+				}
+			}
+
+			std::cout.rdbuf(cout_buffer);
+
+			std::printf("%-40s  %6zu lookups  %s\n",
+					filename.filename().string().c_str(),
+					lookups,
+					(mismatches.empty() ? "OK" : ("MISMATCH in " + std::to_string(mismatches.size()) + " lookups").c_str()));
+
+			for (const auto & msg : mismatches)
+			{
+				std::printf("\t%s\n", msg.c_str());
+			}
+
+			if (not mismatches.empty())
+			{
+				failures ++;
+			}
+		}
+
+		if (failures)
+		{
+			return 1;
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_im2col()
+{
+	struct Shape
+	{
+		int channels;
+		int size;		// height and width of the input
+		int kernel;
+		int stride;
+		int pad;
+		int dilation;
+	};
+
+	// the first layers of YOLOv4 at 416x416, followed by the less common strides, dilations, and kernel sizes
+	const std::vector<Shape> shapes =
+	{
+		{   3, 416, 3, 1, 1, 1 },
+		{  32, 416, 3, 2, 1, 1 },
+		{  64, 208, 3, 1, 1, 1 },
+		{  64, 208, 3, 2, 1, 1 },
+		{ 128, 104, 3, 1, 1, 1 },
+		{ 256,  52, 3, 1, 2, 2 },
+		{  64, 104, 5, 1, 2, 1 },
+		{  32, 104, 7, 2, 3, 1 },
+		{  32, 104, 3, 3, 0, 1 },
+		{  64,  13, 1, 2, 0, 1 },
+	};
+
+	try
+	{
+		for (const auto & shape : shapes)
+		{
+			const int out_size = (shape.size + 2 * shape.pad - (shape.dilation * (shape.kernel - 1) + 1)) / shape.stride + 1;
+			const size_t col_size = static_cast<size_t>(shape.channels) * shape.kernel * shape.kernel * out_size * out_size;
+
+			Darknet_ng::VF im(static_cast<size_t>(shape.channels) * shape.size * shape.size);
+			Darknet_ng::VF expected(col_size);
+			Darknet_ng::VF result(col_size);
+			for (size_t i = 0; i < im.size(); i ++) im[i] = std::sin(i * 0.37f);
+
+			const auto time_it = [&](auto && fn, Darknet_ng::VF & col) -> double
+			{
+				const auto run = [&]()
+				{
+					fn(im.data(), shape.channels, shape.size, shape.size, shape.kernel, shape.kernel, shape.pad, shape.pad,
+							shape.stride, shape.stride, shape.dilation, shape.dilation, col.data());
+				};
+
+				run(); // warm up the caches
+				const int iterations = 5;
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i ++)
+				{
+					run();
+				}
+				const auto end = std::chrono::high_resolution_clock::now();
+				return std::chrono::duration<double>(end - start).count() / iterations;
+			};
+
+			const double reference_time	= time_it(Darknet_ng::im2col_cpu_ext_reference, expected);
+			const double optimized_time	= time_it(Darknet_ng::im2col_cpu_ext, result);
+			const size_t mismatches		= col_size - std::inner_product(expected.begin(), expected.end(), result.begin(), size_t(0), std::plus<>(), std::equal_to<>());
+
+			// im2col only copies, so the throughput is the size of the matrix written out
+			const double gigabytes = col_size * sizeof(float) / 1.0e9;
+
+			std::printf("c=%4d %3dx%-3d k=%d s=%d p=%d d=%d:  %8.3f ms %6.2f GB/s  (reference %8.3f ms %6.2f GB/s, %5.2fx)  %s\n",
+					shape.channels, shape.size, shape.size, shape.kernel, shape.stride, shape.pad, shape.dilation,
+					optimized_time * 1000.0, gigabytes / optimized_time,
+					reference_time * 1000.0, gigabytes / reference_time,
+					reference_time / optimized_time,
+					(mismatches == 0 ? "OK" : ("MISMATCH in " + std::to_string(mismatches) + " values").c_str()));
+
+			if (mismatches)
+			{
+				return 1;
+			}
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_activations()
+{
+	using Darknet_ng::EActivation;
+
+	// the double precision reference for each of the activations which have an array version
+	const std::vector<std::pair<EActivation, double(*)(double)>> activations =
+	{
+		{ EActivation::kLogistic,	[](double x) { return 1.0 / (1.0 + std::exp(-x)); }									},
+		{ EActivation::kTANH,		[](double x) { return std::tanh(x); }												},
+		{ EActivation::kLOGGY,		[](double x) { return 2.0 / (1.0 + std::exp(-x)) - 1.0; }							},
+		{ EActivation::kSWISH,		[](double x) { return x / (1.0 + std::exp(-x)); }									},
+		{ EActivation::kMISH,		[](double x) { return x * std::tanh(std::log1p(std::exp(x))); }						},
+		{ EActivation::kHardMISH,	[](double x) { return (x > 0.0 ? x : x > -2.0 ? x * x / 2.0 + x : 0.0); }			},
+		{ EActivation::kELU,		[](double x) { return (x >= 0.0 ? x : std::expm1(x)); }								},
+		{ EActivation::kSELU,		[](double x) { return 1.0507 * (x >= 0.0 ? x : 1.6732 * std::expm1(x)); }			},
+		{ EActivation::kGELU,		[](double x) { return 0.5 * x * (1.0 + std::tanh(0.797885 * x + 0.035677 * x * x * x)); }	},
+		{ EActivation::kLeaky,		[](double x) { return (x > 0.0 ? x : 0.1 * x); }									},
+		{ EActivation::kRELU,		[](double x) { return (x > 0.0 ? x : 0.0); }										},
+		{ EActivation::kRELU6,		[](double x) { return std::min(std::max(x, 0.0), 6.0); }							},
+		{ EActivation::kRELIE,		[](double x) { return (x > 0.0 ? x : 0.01 * x); }									},
+		{ EActivation::kRamp,		[](double x) { return (x > 0.0 ? x : 0.0) + 0.1 * x; }								},
+		{ EActivation::kPLSE,		[](double x) { return (x < -4.0 ? 0.01 * (x + 4.0) : x > 4.0 ? 0.01 * (x - 4.0) + 1.0 : 0.125 * x + 0.5); }	},
+		{ EActivation::kHardTAN,	[](double x) { return std::min(std::max(x, -1.0), 1.0); }							},
+		{ EActivation::kLHTAN,		[](double x) { return (x < 0.0 ? 0.001 * x : x > 1.0 ? 0.001 * (x - 1.0) + 1.0 : x); }	},
+		{ EActivation::kStair,		[](double x) { const double n = std::floor(x); return (std::fmod(n, 2.0) == 0.0 ? 0.0 : x - n) + std::floor(x / 2.0); }	},
+	};
+
+	// distance between 2 floats in units in the last place, using the fact that the bits of a float sort like an integer
+	const auto ulp_distance = [](const float a, const float b) -> int64_t
+	{
+		int32_t ia;
+		int32_t ib;
+		std::memcpy(&ia, &a, sizeof(ia));
+		std::memcpy(&ib, &b, sizeof(ib));
+		const int64_t oa = (ia < 0 ? std::numeric_limits<int32_t>::min() - static_cast<int64_t>(ia) : ia);
+		const int64_t ob = (ib < 0 ? std::numeric_limits<int32_t>::min() - static_cast<int64_t>(ib) : ib);
+		return std::abs(oa - ob);
+	};
+
+	// every value in [-30, 30] which is a multiple of 2^-12, plus the extremes of the range of exp()
+	Darknet_ng::VF input;
+	for (int i = -30 * 4096; i <= 30 * 4096; i ++)
+	{
+		input.push_back(i / 4096.0f);
+	}
+	for (const float x : { -1000.0f, -104.0f, -88.0f, -87.0f, 87.0f, 88.0f, 89.0f, 1000.0f })
+	{
+		input.push_back(x);
+	}
+
+	std::cout << "activation kernels: " << Darknet_ng::get_kernel_implementations().at("activations") << std::endl;
+
+	try
+	{
+		for (const auto & [activation, reference] : activations)
+		{
+			Darknet_ng::VF result(input);
+			Darknet_ng::activate_array_cpu_custom(result.data(), result.size(), activation);
+
+			int64_t array_ulp	= 0;
+			int64_t scalar_ulp	= 0;
+			double array_error	= 0.0;
+			size_t failures		= 0;
+			for (size_t i = 0; i < input.size(); i ++)
+			{
+				const double expected	= reference(input[i]);
+				const double error		= std::fabs(result[i] - expected);
+				array_error = std::max(array_error, error);
+				if (not std::isfinite(result[i]) or error > 1.0e-4 * std::max(1.0, std::fabs(expected)))
+				{
+					failures ++;
+				}
+
+				// the extremes are only checked for the absolute error, since exp_approx() returns zero below -87.3
+				if (std::fabs(input[i]) <= 30.0f)
+				{
+					array_ulp	= std::max(array_ulp	, ulp_distance(result[i], static_cast<float>(expected)));
+					scalar_ulp	= std::max(scalar_ulp	, ulp_distance(Darknet_ng::activate(input[i], activation), static_cast<float>(expected)));
+				}
+			}
+
+			const auto time_it = [&](auto && fn) -> double
+			{
+				Darknet_ng::VF x(input);
+				fn(x); // warm up the caches
+				const int iterations = 10;
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i ++)
+				{
+					fn(x);
+				}
+				const auto end = std::chrono::high_resolution_clock::now();
+				return std::chrono::duration<double>(end - start).count() / iterations;
+			};
+
+			// the values are fed back in, but every activation maps [-30, 30] into a range which does not overflow
+			const double scalar_time = time_it([&](Darknet_ng::VF & x)
+				{
+					for (auto & v : x)
+					{
+						v = Darknet_ng::activate(v, activation);
+					}
+				});
+			const double array_time = time_it([&](Darknet_ng::VF & x)
+				{
+					Darknet_ng::activate_array_cpu_custom(x.data(), x.size(), activation);
+				});
+
+			// where the formula cancels out -- such as loggy and elu near zero -- both versions have a large error in ULP, so the absolute error is also shown
+			std::printf("%-10s max error %10lld ULP %.2e absolute (activate() %10lld ULP):  %7.1f Mvalues/s (activate() %6.1f Mvalues/s, %5.2fx)  %s\n",
+					Darknet_ng::to_string(activation).c_str(),
+					static_cast<long long>(array_ulp), array_error, static_cast<long long>(scalar_ulp),
+					input.size() / array_time / 1.0e6, input.size() / scalar_time / 1.0e6, scalar_time / array_time,
+					(failures == 0 ? "OK" : ("WRONG in " + std::to_string(failures) + " values").c_str()));
+
+			if (failures)
+			{
+				return 1;
+			}
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_normalize_channels()
+{
+	using Darknet_ng::EActivation;
+
+	struct Shape
+	{
+		int batch;
+		int channels;
+		int size;		// height and width of the layer
+	};
+
+	// the channel counts and sizes of the YOLO heads and of the layers in front of them, plus sizes which are not a multiple of the tile
+	const std::vector<Shape> shapes =
+	{
+		{ 1,   64, 104 },
+		{ 1,  128,  52 },
+		{ 1,  255,  52 },
+		{ 1,  256,  26 },
+		{ 1,  255,  13 },
+		{ 1,  512,  13 },
+		{ 1, 1024,  19 },
+		{ 4,  128,  38 },
+		{ 2,   21,   7 },
+	};
+
+	const std::vector<EActivation> activations =
+	{
+		EActivation::kNormCHAN,
+		EActivation::kNormCHANSoftmax,
+		EActivation::kNormCHANSoftmaxMaxVal,
+	};
+
+	try
+	{
+		for (const auto & shape : shapes)
+		{
+			const int wh_step	= shape.size * shape.size;
+			const int n			= shape.batch * shape.channels * wh_step;
+
+			Darknet_ng::VF input(n);
+			for (int i = 0; i < n; i ++) input[i] = 3.0f * std::sin(i * 0.37f);
+
+			for (const auto activation : activations)
+			{
+				const auto run = [&](const bool reference, Darknet_ng::VF & output)
+				{
+					float * x = input.data();
+					if (activation == EActivation::kNormCHAN)
+					{
+						(reference ? Darknet_ng::activate_array_normalize_channels_reference : Darknet_ng::activate_array_normalize_channels)
+							(x, n, shape.batch, shape.channels, wh_step, output.data());
+					}
+					else
+					{
+						(reference ? Darknet_ng::activate_array_normalize_channels_softmax_reference : Darknet_ng::activate_array_normalize_channels_softmax)
+							(x, n, shape.batch, shape.channels, wh_step, output.data(), activation == EActivation::kNormCHANSoftmaxMaxVal);
+					}
+				};
+
+				const auto time_it = [&](const bool reference, Darknet_ng::VF & output) -> double
+				{
+					run(reference, output); // warm up the caches
+					const int iterations = 10;
+					const auto start = std::chrono::high_resolution_clock::now();
+					for (int i = 0; i < iterations; i ++)
+					{
+						run(reference, output);
+					}
+					const auto end = std::chrono::high_resolution_clock::now();
+					return std::chrono::duration<double>(end - start).count() / iterations;
+				};
+
+				Darknet_ng::VF expected(n);
+				Darknet_ng::VF result(n);
+				const double reference_time	= time_it(true	, expected);
+				const double optimized_time	= time_it(false	, result);
+
+				// every output is in [0, 1], so the absolute error is also close to the relative error of the larger values
+				double error = 0.0;
+				for (int i = 0; i < n; i ++)
+				{
+					error = std::max(error, static_cast<double>(std::fabs(result[i] - expected[i])));
+				}
+				const bool ok = (error <= 1.0e-6);
+
+				std::printf("%-33s b=%d c=%4d %3dx%-3d:  %8.3f ms  (reference %8.3f ms, %5.2fx)  max error %.2e  %s\n",
+						Darknet_ng::to_string(activation).c_str(), shape.batch, shape.channels, shape.size, shape.size,
+						optimized_time * 1000.0, reference_time * 1000.0, reference_time / optimized_time,
+						error, (ok ? "OK" : "WRONG"));
+
+				if (not ok)
+				{
+					return 1;
+				}
+			}
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int benchmark_xnor_gemm()
+{
+	struct Shape
+	{
+		int filters;	// M
+		int channels;
+		int size;		// height and width of the output
+		int kernel;
+	};
+
+	// the XNOR layers of yolov3-tiny_xnor.cfg at 416x416
+	const std::vector<Shape> shapes =
+	{
+		{   32,   16, 208, 3 },
+		{   64,   32, 104, 3 },
+		{  128,   64,  52, 3 },
+		{  256,  128,  26, 3 },
+		{  512,  256,  13, 3 },
+		{ 1024,  512,  13, 3 },
+		{  256, 1024,  13, 1 },
+		{  128,  256,  13, 1 },
+		{  256,  384,  26, 3 },
+	};
+
+	std::cout << "XNOR GEMM kernel: " << Darknet_ng::get_kernel_implementations().at("gemm_nn_custom_bin_mean_transposed") << std::endl;
+
+	try
+	{
+		for (const auto & shape : shapes)
+		{
+			const int M = shape.filters;
+			const int N = shape.size * shape.size;
+			const int K = shape.kernel * shape.kernel * shape.channels;
+
+			// same padding as the binary convolutional layers, where the bits past K are zero in both A and B
+			const int ld = K + (256 - K % 256);
+
+			std::vector<unsigned char> A(static_cast<size_t>(M) * ld / 8);
+			std::vector<unsigned char> B(static_cast<size_t>(N) * ld / 8);
+			Darknet_ng::VF mean(M);
+			uint32_t seed = 12345;
+			const auto random_bits = [&](std::vector<unsigned char> & v, const int rows)
+			{
+				for (int row = 0; row < rows; row ++)
+				{
+					for (int k = 0; k < K; k ++)
+					{
+						seed = seed * 1664525u + 1013904223u;
+						if (seed & 0x80000000u)
+						{
+							Darknet_ng::set_bit(v.data() + static_cast<size_t>(row) * ld / 8, k);
+						}
+					}
+				}
+			};
+			random_bits(A, M);
+			random_bits(B, N);
+			for (int i = 0; i < M; i ++) mean[i] = 0.01f * (i % 7 + 1);
+
+			const auto time_it = [&](auto && fn, Darknet_ng::VF & C) -> double
+			{
+				const auto run = [&]()
+				{
+					fn(M, N, K, 1.0f, A.data(), ld, B.data(), ld, C.data(), N, mean.data());
+				};
+
+				run(); // warm up the caches
+				const int iterations = 5;
+				const auto start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < iterations; i ++)
+				{
+					run();
+				}
+				const auto end = std::chrono::high_resolution_clock::now();
+				return std::chrono::duration<double>(end - start).count() / iterations;
+			};
+
+			Darknet_ng::VF expected(static_cast<size_t>(M) * N);
+			Darknet_ng::VF result(static_cast<size_t>(M) * N);
+			const double portable_time	= time_it(Darknet_ng::portable::gemm_nn_custom_bin_mean_transposed, expected);
+			const double optimized_time	= time_it(Darknet_ng::gemm_nn_custom_bin_mean_transposed, result);
+			double original_time		= 0.0;
+			#if DNG_X86
+			if (Darknet_ng::get_cpu_features().avx2)
+			{
+				Darknet_ng::VF original(static_cast<size_t>(M) * N);
+				original_time = time_it(Darknet_ng::avx2::gemm_nn_custom_bin_mean_transposed_reference, original);
+			}
+			#endif
+
+			// the counts are integers, so every kernel must give exactly the same results
+			const size_t mismatches = expected.size() - std::inner_product(expected.begin(), expected.end(), result.begin(), size_t(0), std::plus<>(), std::equal_to<>());
+
+			// each bit of the product is an XNOR and a popcount
+			const double gops = 2.0 * M * N * K / 1.0e9;
+
+			std::printf("M=%4d N=%5d K=%4d:  %8.3f ms %7.1f Gops  (original avx2 %8.3f ms, %5.2fx)  (portable %8.3f ms, %5.2fx)  %s\n",
+					M, N, K,
+					optimized_time * 1000.0, gops / optimized_time,
+					original_time * 1000.0, original_time / optimized_time,
+					portable_time * 1000.0, portable_time / optimized_time,
+					(mismatches == 0 ? "OK" : ("MISMATCH in " + std::to_string(mismatches) + " values").c_str()));
+
+			if (mismatches)
+			{
+				return 1;
+			}
+		}
+	}
+	catch (const std::exception & e)
+	{
+		std::cout << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int cpu_features()
+{
+	std::cout << "CPU features: " << Darknet_ng::to_string(Darknet_ng::get_cpu_features()) << std::endl;
+
+	for (const auto & [kernel, implementation] : Darknet_ng::get_kernel_implementations())
+	{
+		std::printf("%-36s %s\n", kernel.c_str(), implementation.c_str());
+	}
+
+	return 0;
+}
 
 
 int main(int argc, char ** argv)
 {
 	std::cout << "Darknet Next Generation v" << Darknet_ng::version() << std::endl;
 
+	if (argc > 1 and std::string(argv[1]) == "compile-cfg")
+	{
+		if (argc != 4)
+		{
+			std::cout << "Usage: " << argv[0] << " compile-cfg <filename.cfg> <output.plan>" << std::endl;
+			return 1;
+		}
+
+		return compile_cfg(argv[2], argv[3]);
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "--cpu-features")
+	{
+		return cpu_features();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-gemm")
+	{
+		return benchmark_gemm();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-activations")
+	{
+		return benchmark_activations();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-normalize-channels")
+	{
+		return benchmark_normalize_channels();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-xnor-gemm")
+	{
+		return benchmark_xnor_gemm();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-config")
+	{
+		return benchmark_config(argc > 2 ? argv[2] : "cfg");
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "check-config-options")
+	{
+		return check_config_options(argc > 2 ? argv[2] : "cfg");
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-im2col")
+	{
+		return benchmark_im2col();
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-forward")
+	{
+		if (argc != 3)
+		{
+			std::cout << "Usage: " << argv[0] << " benchmark-forward <filename.cfg>" << std::endl;
+			return 1;
+		}
+
+		return benchmark_forward(argv[2]);
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-contexts")
+	{
+		if (argc != 3 and argc != 4)
+		{
+			std::cout << "Usage: " << argv[0] << " benchmark-contexts <filename.cfg> [threads]" << std::endl;
+			return 1;
+		}
+
+		return benchmark_contexts(argv[2], (argc == 4 ? std::stoi(argv[3]) : omp_get_max_threads()));
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-winograd")
+	{
+		if (argc != 3)
+		{
+			std::cout << "Usage: " << argv[0] << " benchmark-winograd <filename.cfg>" << std::endl;
+			return 1;
+		}
+
+		return benchmark_winograd(argv[2]);
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "benchmark-blocked")
+	{
+		if (argc != 3)
+		{
+			std::cout << "Usage: " << argv[0] << " benchmark-blocked <filename.cfg>" << std::endl;
+			return 1;
+		}
+
+		return benchmark_blocked(argv[2]);
+	}
+
+	if (argc > 1 and std::string(argv[1]) == "autotune")
+	{
+		if (argc != 4 and argc != 5)
+		{
+			std::cout << "Usage: " << argv[0] << " autotune <filename.cfg> <cache.txt> [batch]" << std::endl;
+			return 1;
+		}
+
+		return autotune(argv[2], argv[3], (argc == 5 ? std::stoul(argv[4]) : 1));
+	}
+
 #if 0
 	Darknet_ng::Config cfg("test.cfg");
 	std::cout << cfg << std::endl;
@@ -1,6 +1,7 @@
 // Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
 // MIT license applies.  See "license.txt" for details.
 
+#include <algorithm>
 #include "darknet-ng.hpp"
 
 
@@ -58,14 +59,48 @@ std::string Darknet_ng::to_string(const Darknet_ng::EActivation & activation)
 }
 
 
+float Darknet_ng::activate(const float x, const Darknet_ng::EActivation a)
+{
+	// was:  float activate(float x, ACTIVATION a)
+
+	switch (a)
+	{
+		case EActivation::kLinear:		return linear_activate(x);
+		case EActivation::kLogistic:	return logistic_activate(x);
+		case EActivation::kLOGGY:		return loggy_activate(x);
+		case EActivation::kRELU:		return relu_activate(x);
+		case EActivation::kRELU6:		return relu6_activate(x);
+		case EActivation::kELU:			return elu_activate(x);
+		case EActivation::kSELU:		return selu_activate(x);
+		case EActivation::kGELU:		return gelu_activate(x);
+		case EActivation::kRELIE:		return relie_activate(x);
+		case EActivation::kRamp:		return ramp_activate(x);
+		case EActivation::kRevLeaky:	// fall through
+		case EActivation::kLeaky:		return leaky_activate(x);
+		case EActivation::kTANH:		return tanh_activate(x);
+		case EActivation::kPLSE:		return plse_activate(x);
+		case EActivation::kStair:		return stair_activate(x);
+		case EActivation::kHardTAN:		return hardtan_activate(x);
+		case EActivation::kLHTAN:		return lhtan_activate(x);
+		case EActivation::kSWISH:		return x * logistic_activate(x);
+		case EActivation::kMISH:		return x * tanh_activate(softplus_activate(x, 20.0f));
+		case EActivation::kHardMISH:	return hard_mish_yashas(x);
+		default:						break;
+	}
+
+	/// @throw Exception The activation cannot be applied to a single value.
+	throw Exception("activation \"" + to_string(a) + "\" cannot be applied to individual values", DNG_LOC);
+}
+
+
 void Darknet_ng::activate_array_swish(float *x, const int n, float * output_sigmoid, float * output)
 {
 	int i;
-	#pragma omp parallel for
+	#pragma omp parallel for simd
 	for (i = 0; i < n; ++i)
 	{
 		float x_val = x[i];
-		float sigmoid = logistic_activate(x_val);
+		float sigmoid = logistic_approx(x_val);
 		output_sigmoid[i] = sigmoid;
 		output[i] = x_val * sigmoid;
 	}
@@ -78,21 +113,21 @@ void Darknet_ng::activate_array_mish(float * x, const int n, float * activation_
 {
 	// https://github.com/digantamisra98/Mish
 
-	const float MISH_THRESHOLD = 20.0f;
-
-	#pragma omp parallel for
+	#pragma omp parallel for simd
 	for (int i = 0; i < n; ++i)
 	{
 		float x_val = x[i];
 		activation_input[i] = x_val;    // store value before activation
-		output[i] = x_val * tanh_activate( softplus_activate(x_val, MISH_THRESHOLD) );
+		output[i] = mish_approx(x_val);	// x_val * tanh_activate(softplus_activate(x_val, 20.0f))
 	}
+
+	return;
 }
 
 
 void Darknet_ng::activate_array_hard_mish(float * x, const int n, float * activation_input, float * output)
 {
-	#pragma omp parallel for
+	#pragma omp parallel for simd
 	for (int i = 0; i < n; ++i)
 	{
 		float x_val = x[i];
@@ -104,8 +139,149 @@ void Darknet_ng::activate_array_hard_mish(float * x, const int n, float * activa
 }
 
 
+namespace
+{
+	/** Number of spatial positions done at once by the normalize_channels activations.  The running sums of a tile stay
+	 * in registers or in L1, and each channel of the tile is a contiguous run of memory the compiler turns into SIMD
+	 * instructions.
+	 */
+	constexpr int kChannelTile = 64;
+
+	/// Layers smaller than this many floats are done on a single thread, since waking up the other threads costs more.
+	constexpr int kChannelTileMinParallelSize = 64 * 1024;
+
+	/** Call @p fn for every tile of spatial positions in every image of the batch.  @p fn is given the offset of the
+	 * first value of the tile in channel zero, and the number of positions in the tile.  The tiles are independent, so
+	 * they are split across the threads.
+	 */
+	template <typename FN>
+	inline void for_each_channel_tile(const int n, const int batch, const int wh_step, FN && fn)
+	{
+		const int tiles = (wh_step + kChannelTile - 1) / kChannelTile;
+
+		#pragma omp parallel for schedule(static) if (n >= kChannelTileMinParallelSize)
+		for (int i = 0; i < batch * tiles; ++i)
+		{
+			const int b			= i / tiles;
+			const int start		= (i % tiles) * kChannelTile;
+			const int length	= std::min(kChannelTile, wh_step - start);
+
+			fn(static_cast<size_t>(b) * (n / batch) + start, length);
+		}
+
+		return;
+	}
+}
+
+
 void Darknet_ng::activate_array_normalize_channels(float * x, const int n, int batch, int channels, int wh_step, float * output)
 {
+	/* The original loop walked over the channels of one spatial position at a time, reading a single float from each
+	 * cache line.  Instead, the channels are added up for a whole tile of positions, then every channel of the tile is
+	 * divided by those sums.  The results are the same as activate_array_normalize_channels_reference().
+	 */
+
+	for_each_channel_tile(n, batch, wh_step, [&](const size_t offset, const int length)
+		{
+			alignas(64) float sum[kChannelTile];
+			std::fill(sum, sum + length, 0.0001f);
+
+			for (int k = 0; k < channels; ++k)
+			{
+				const float * in = x + offset + static_cast<size_t>(k) * wh_step;
+
+				#pragma omp simd
+				for (int j = 0; j < length; ++j)
+				{
+					sum[j] += blend(in[j] > 0.0f, in[j], 0.0f);
+				}
+			}
+
+			for (int k = 0; k < channels; ++k)
+			{
+				const float * in	= x			+ offset + static_cast<size_t>(k) * wh_step;
+				float * out			= output	+ offset + static_cast<size_t>(k) * wh_step;
+
+				#pragma omp simd
+				for (int j = 0; j < length; ++j)
+				{
+					out[j] = blend(in[j] > 0.0f, in[j] / sum[j], 0.0f);
+				}
+			}
+		});
+
+	return;
+}
+
+
+void Darknet_ng::activate_array_normalize_channels_softmax(float * x, const int n, int batch, int channels, int wh_step, float * output, int use_max_val)
+{
+	/* Same tiles as activate_array_normalize_channels().  The original calculated expf() twice for every value; here the
+	 * exponentials are written to the output while they are added up, and the last pass only divides by the sums.
+	 * exp_approx() is within 1 ULP of expf(), so the results are within a few ULP of
+	 * activate_array_normalize_channels_softmax_reference().
+	 */
+
+	for_each_channel_tile(n, batch, wh_step, [&](const size_t offset, const int length)
+		{
+			alignas(64) float max_val[kChannelTile];
+			alignas(64) float sum[kChannelTile];
+			std::fill(sum, sum + length, 0.0001f);
+
+			if (use_max_val)
+			{
+				std::copy(x + offset, x + offset + length, max_val);
+				for (int k = 1; k < channels; ++k)
+				{
+					const float * in = x + offset + static_cast<size_t>(k) * wh_step;
+
+					#pragma omp simd
+					for (int j = 0; j < length; ++j)
+					{
+						max_val[j] = blend(in[j] > max_val[j], in[j], max_val[j]);
+					}
+				}
+			}
+			else
+			{
+				std::fill(max_val, max_val + length, 0.0f);
+			}
+
+			// x and output may be the same array, but each value is read before it is overwritten
+			for (int k = 0; k < channels; ++k)
+			{
+				const float * in	= x			+ offset + static_cast<size_t>(k) * wh_step;
+				float * out			= output	+ offset + static_cast<size_t>(k) * wh_step;
+
+				#pragma omp simd
+				for (int j = 0; j < length; ++j)
+				{
+					const float e = exp_approx(in[j] - max_val[j]);
+					out[j] = e;
+					sum[j] += e;
+				}
+			}
+
+			for (int k = 0; k < channels; ++k)
+			{
+				float * out = output + offset + static_cast<size_t>(k) * wh_step;
+
+				#pragma omp simd
+				for (int j = 0; j < length; ++j)
+				{
+					out[j] /= sum[j];
+				}
+			}
+		});
+
+	return;
+}
+
+
+void Darknet_ng::activate_array_normalize_channels_reference(float * x, const int n, int batch, int channels, int wh_step, float * output)
+{
+	// was: void activate_array_normalize_channels(...)
+
 	int size = n / channels;
 
 	#pragma omp parallel for
@@ -147,8 +323,10 @@ void Darknet_ng::activate_array_normalize_channels(float * x, const int n, int b
 }
 
 
-void Darknet_ng::activate_array_normalize_channels_softmax(float *x, const int n, int batch, int channels, int wh_step, float *output, int use_max_val)
+void Darknet_ng::activate_array_normalize_channels_softmax_reference(float *x, const int n, int batch, int channels, int wh_step, float *output, int use_max_val)
 {
+	// was: void activate_array_normalize_channels_softmax(...)
+
 	int size = n / channels;
 
 	#pragma omp parallel for
@@ -194,18 +372,3 @@ void Darknet_ng::activate_array_normalize_channels_softmax(float *x, const int n
 
 	return;
 }
-
-
-/*static*/ float Darknet_ng::hard_mish_yashas(float x)
-{
-	if (x > 0.0f)
-	{
-		return x;
-	}
-	if (x > -2.0f)
-	{
-		return x * x / 2.0f + x;
-	}
-
-	return 0;
-}
@@ -46,11 +46,20 @@ namespace Darknet_ng
 	void activate_array_swish						(float * x, const int n, float * output_sigmoid		, float * output);
 	void activate_array_mish						(float * x, const int n, float * activation_input	, float * output);
 	void activate_array_hard_mish					(float * x, const int n, float * activation_input	, float * output);
+
+	/** @{ The activations which normalize each spatial position across all of the channels.  These work on tiles of
+	 * spatial positions so the memory is read one contiguous row at a time, and the tiles are split across the OpenMP
+	 * threads.  @p x and @p output may be the same array.
+	 */
 	void activate_array_normalize_channels			(float * x, const int n, int batch, int channels, int wh_step, float * output);
 	void activate_array_normalize_channels_softmax	(float * x, const int n, int batch, int channels, int wh_step, float * output, int use_max_val);
+	/// @}
+
+	/// @{ The original loops which visit one spatial position at a time, kept to test the activations above against.
+	void activate_array_normalize_channels_reference			(float * x, const int n, int batch, int channels, int wh_step, float * output);
+	void activate_array_normalize_channels_softmax_reference	(float * x, const int n, int batch, int channels, int wh_step, float * output, int use_max_val);
+	/// @}
 
-	/// @todo This was a static.  Looks like a GPU version also exists?  Should this be exposed?
-	float hard_mish_yashas(float x);
 
 	static inline float logistic_activate(const float x)
 	{
@@ -77,5 +86,199 @@ namespace Darknet_ng
 		return (2 / (1 + expf(-2 * x)) - 1);
 	}
 
+
+	/** Returns @p a when @p condition is @p true, otherwise @p b.  This is the ternary operator done with bit masks.
+	 * When a ternary operator chooses between 2 calculations, GCC moves each calculation into a branch so only one of
+	 * them is done, and the loop is then no longer vectorized since that would mean calculating the side which was not
+	 * taken, which might raise a floating point exception.  Both sides are always used here, so the loop stays free of
+	 * branches.
+	 */
+	static inline float blend(const bool condition, const float a, const float b)
+	{
+		const unsigned int mask = 0u - static_cast<unsigned int>(condition);
+
+		unsigned int bits_a;
+		unsigned int bits_b;
+		std::memcpy(&bits_a, &a, sizeof(bits_a));
+		std::memcpy(&bits_b, &b, sizeof(bits_b));
+
+		const unsigned int bits = (bits_a & mask) | (bits_b & ~mask);
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+
+		return result;
+	}
+
+	/// Same as @p std::floor(), which GCC only vectorizes when floating point exceptions are disabled.
+	static inline float floor_simd(const float x)
+	{
+		// floats this large are already integers, and would overflow the conversion to int
+		const bool small	= std::fabs(x) < 8388608.0f;
+		const float t		= static_cast<float>(static_cast<int>(blend(small, x, 0.0f)));
+
+		return blend(small, blend(t > x, t - 1.0f, t), x);
+	}
+
+	/// @todo This was a static.  Looks like a GPU version also exists?  Should this be exposed?
+	static inline float hard_mish_yashas(const float x)
+	{
+		const float curve = x * x / 2.0f + x;
+		return blend(x > 0.0f, x, blend(x > -2.0f, curve, 0.0f));
+	}
+
+	static inline float stair_activate(const float x)
+	{
+		const float n		= floor_simd(x);
+		const float half	= floor_simd(x / 2.0f);
+
+		// n is even when it is exactly twice the half, which avoids converting to an int
+		return blend(n == 2.0f * half, half, (x - n) + half);
+	}
+
+	static inline float hardtan_activate(const float x)
+	{
+		return blend(x < -1.0f, -1.0f, blend(x > 1.0f, 1.0f, x));
+	}
+
+	static inline float plse_activate(const float x)
+	{
+		return blend(x < -4.0f, 0.01f * (x + 4.0f), blend(x > 4.0f, 0.01f * (x - 4.0f) + 1.0f, 0.125f * x + 0.5f));
+	}
+
+	static inline float lhtan_activate(const float x)
+	{
+		return blend(x < 0.0f, 0.001f * x, blend(x > 1.0f, 0.001f * (x - 1.0f) + 1.0f, x));
+	}
+
+	static inline float linear_activate	(const float x) { return x; }
+	static inline float loggy_activate	(const float x) { return 2.0f / (1.0f + expf(-x)) - 1.0f; }
+	static inline float relu_activate	(const float x) { return blend(x > 0.0f, x, 0.0f); }
+	static inline float relu6_activate	(const float x) { const float y = relu_activate(x); return blend(y < 6.0f, y, 6.0f); }
+	static inline float elu_activate	(const float x) { return (x >= 0.0f) * x + (x < 0.0f) * (expf(x) - 1.0f); }
+	static inline float selu_activate	(const float x) { return (x >= 0.0f) * 1.0507f * x + (x < 0.0f) * 1.0507f * 1.6732f * (expf(x) - 1.0f); }
+	static inline float relie_activate	(const float x) { return blend(x > 0.0f, x, 0.01f * x); }
+	static inline float ramp_activate	(const float x) { return relu_activate(x) + 0.1f * x; }
+	static inline float leaky_activate	(const float x) { return blend(x > 0.0f, x, 0.1f * x); }
+	static inline float gelu_activate	(const float x) { return 0.5f * x * (1.0f + tanhf(0.797885f * x + 0.035677f * powf(x, 3))); }
+
+	/** @{ Polynomial approximations of the transcendental functions used by the activations.  These are made only of
+	 * multiplications, additions, comparisons, and bit manipulations -- no calls into libm, and @ref blend() instead of
+	 * branches -- so a loop over an array is turned into SIMD instructions by the compiler, and compiles to AVX2 or
+	 * AVX-512 in the kernels chosen by @ref get_kernels().  The error against a double precision reference, as measured by the
+	 * @p benchmark-activations command:
+	 *
+	 * | function			| max error	| range				|
+	 * |--------------------|-----------|-------------------|
+	 * | exp_approx()		| 1 ULP		| [-87.3, 88.3]		|
+	 * | tanh_approx()		| 1 ULP		| all values		|
+	 * | logistic_approx()	| 2 ULP		| [-88.3, 87.3]		|
+	 * | mish_approx()		| 4 ULP		| [-87.3, +inf)		|
+	 *
+	 * Outside of those ranges @ref exp_approx() returns zero or infinity, so the results are off by less than 1e-38.
+	 */
+	static inline float exp_approx(const float x)
+	{
+		/* Cephes expf():  exp(x) = 2^n * exp(r) with n = round(x / ln 2) and |r| <= ln(2)/2.  Adding 1.5 * 2^23 rounds
+		 * x / ln 2 to an integer which ends up in the low bits of the mantissa, so no conversion to int is needed.
+		 */
+		const float t	= x * 1.44269504088896341f + 12582912.0f;
+		unsigned int n;
+		std::memcpy(&n, &t, sizeof(n));
+		const float fn	= t - 12582912.0f;
+
+		// ln 2 is split in 2 parts so r is exact
+		const float r	= x - fn * 0.693359375f + fn * 2.12194440e-4f;
+
+		float p = 1.9875691500e-4f;
+		p = p * r + 1.3981999507e-3f;
+		p = p * r + 8.3334519073e-3f;
+		p = p * r + 4.1665795894e-2f;
+		p = p * r + 1.6666665459e-1f;
+		p = p * r + 5.0000001201e-1f;
+		p = p * r * r + r + 1.0f;
+
+		// 2^n is built directly from the exponent bits, which is only valid while n is within [-126, 127]
+		const unsigned int bits = (n - 0x4B400000u + 127u) << 23;
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(scale));
+
+		/* The range is checked last rather than by clamping x first, since GCC would otherwise calculate the clamped
+		 * values on their own branches, and the loop would not be vectorized.
+		 */
+		const float result = blend(x < 88.3762626647949f, p * scale, HUGE_VALF);
+
+		return blend(x > -87.3365447505531f, result, 0.0f);
+	}
+
+	static inline float tanh_approx(const float x)
+	{
+		const float ax = std::fabs(x);
+
+		// Cephes tanhf():  small values use an odd polynomial, since 1 - 2/(exp(2x)+1) loses all its precision near zero
+		const float z = x * x;
+		float p = -5.70498872745e-3f;
+		p = p * z + 2.06390887954e-2f;
+		p = p * z - 5.37397155531e-2f;
+		p = p * z + 1.33314422036e-1f;
+		p = p * z - 3.33332819422e-1f;
+		const float small = p * z * x + x;
+
+		const float large = std::copysign(1.0f - 2.0f / (exp_approx(2.0f * ax) + 1.0f), x);
+
+		return blend(ax < 0.625f, small, large);
+	}
+
+	static inline float logistic_approx(const float x)
+	{
+		return 1.0f / (1.0f + exp_approx(-x));
+	}
+
+	static inline float mish_approx(const float x)
+	{
+		/* tanh(softplus(x)) = ((1+e)^2 - 1) / ((1+e)^2 + 1) where e = exp(x), so the log() and the tanh() are not needed.
+		 * Above 20 the fraction rounds to 1, same as the threshold used by softplus_activate().
+		 */
+		const float e = exp_approx(x);
+		const float n = e * (e + 2.0f);
+
+		return blend(x < 20.0f, x * n / (n + 2.0f), x);
+	}
+	/// @}
+
+	/** Apply the activation to a single value.  Throws for the activations such as @ref EActivation::kNormCHAN which
+	 * need to see all of the channels at once.  This uses the functions from libm, and is the reference for the
+	 * faster array versions such as @ref activate_array_cpu_custom().
+	 */
+	float activate(const float x, const EActivation a);
+
+	/// Returns @p true if the activation can be applied to each value on its own, meaning @ref activate() can be used.
+	constexpr bool is_elementwise(const EActivation a)
+	{
+		return
+			a != EActivation::kNormCHAN			and
+			a != EActivation::kNormCHANSoftmax	and
+			a != EActivation::kNormCHANSoftmaxMaxVal;
+	}
+
+	/** Adds @p bias to the @p n values in @p x and applies one specific activation.  There is one of these for each of
+	 * the elementwise activations, so the loop does not need to check which activation to use.
+	 *
+	 * @see @ref get_activation_kernel()
+	 *
+	 * @since 2026-10-17
+	 */
+	using ActivationKernel = void(*)(float * x, const int n, const float bias);
+
+	/** Get the kernel for the given activation, using the fastest instruction set supported by this CPU.  This is
+	 * looked up once when a layer is made and stored in @ref Layer::activation_kernel.  Throws for
+	 * the activations which are not elementwise.  @see @ref is_elementwise()
+	 */
+	ActivationKernel get_activation_kernel(const EActivation a);
+
+	/** Add @p bias to the @p n values in @p x and apply the activation, all in a single pass over the memory.  This
+	 * looks up the kernel on every call, so the layers call @ref Layer::activation_kernel directly instead.
+	 */
+	void bias_activate_array(float * x, const int n, const float bias, const EActivation a);
+
 	void activate_array_cpu_custom(float * x, const int n, const EActivation a);
 }
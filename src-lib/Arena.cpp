@@ -0,0 +1,107 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+#include <cstdlib>
+
+
+namespace
+{
+	inline size_t align_up(const size_t bytes)
+	{
+		return (bytes + Darknet_ng::kArenaAlignment - 1) & ~(Darknet_ng::kArenaAlignment - 1);
+	}
+}
+
+
+Darknet_ng::Arena::~Arena()
+{
+	clear();
+
+	return;
+}
+
+
+Darknet_ng::Arena::Arena() :
+	raw(nullptr),
+	base(nullptr),
+	total(0),
+	offset(0)
+{
+	return;
+}
+
+
+Darknet_ng::Arena & Darknet_ng::Arena::clear()
+{
+	free(raw);
+
+	raw		= nullptr;
+	base	= nullptr;
+	total	= 0;
+	offset	= 0;
+
+	return *this;
+}
+
+
+Darknet_ng::Arena & Darknet_ng::Arena::commit()
+{
+	if (committed())
+	{
+		/// @throw Exception The arena has already been committed.
+		throw Exception("arena memory has already been allocated", DNG_LOC);
+	}
+
+	total = offset;
+	offset = 0;
+
+	/* calloc() is used instead of std::aligned_alloc() so large arenas come directly from the kernel as zeroed pages
+	 * which are only faulted in when they are first touched.  We over-allocate so we can align the start manually.
+	 * Note this is done even when nothing was requested, since a non-null base is how we know planning is done.
+	 */
+	raw = calloc(total + kArenaAlignment, 1);
+	if (raw == nullptr)
+	{
+		/// @throw Exception Failed to allocate the arena.
+		throw Exception("failed to allocate " + std::to_string(total) + " bytes for the network arena", DNG_LOC);
+	}
+
+	base = reinterpret_cast<uint8_t*>(align_up(reinterpret_cast<uintptr_t>(raw)));
+
+	return *this;
+}
+
+
+Darknet_ng::Arena & Darknet_ng::Arena::rewind()
+{
+	offset = 0;
+
+	return *this;
+}
+
+
+void * Darknet_ng::Arena::carve_bytes(const size_t bytes)
+{
+	if (bytes == 0)
+	{
+		return nullptr;
+	}
+
+	const size_t start = offset;
+	offset += align_up(bytes);
+
+	if (not committed())
+	{
+		// we're still planning, so all we need to do is remember the size
+		return nullptr;
+	}
+
+	if (offset > total)
+	{
+		/// @throw Exception More memory was carved than was planned.  Both passes must make the same requests.
+		throw Exception("network arena overflow: " + std::to_string(offset) + " bytes requested but only " + std::to_string(total) + " bytes were planned", DNG_LOC);
+	}
+
+	return base + start;
+}
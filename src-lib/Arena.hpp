@@ -0,0 +1,100 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#pragma once
+
+#include "darknet-ng.hpp"
+
+
+namespace Darknet_ng
+{
+	/// Every buffer carved out of an @ref Arena starts on this boundary, which is suitable for aligned AVX-512 loads.
+	constexpr size_t kArenaAlignment = 64;
+
+	/** A single block of memory from which all of the layer buffers in a @ref Network are carved.  This replaces the
+	 * dozens of individual calls to @p calloc() that each layer used to make.
+	 *
+	 * The arena is used in two passes:
+	 *
+	 * @li While "planning", every call to @ref carve() only records how many bytes are needed and returns @p nullptr.
+	 * @li @ref commit() then allocates the entire block in one call, and the exact same sequence of @ref carve() calls
+	 * is made a second time to get the real pointers.
+	 *
+	 * All of the memory is zeroed, and is released in one call by @ref clear() or the destructor.  Any pointers
+	 * previously returned by @ref carve() are no longer valid once the arena has been cleared.
+	 *
+	 * ~~~~
+	 * Darknet_ng::Arena arena;
+	 * for (int pass = 0; pass < 2; pass ++)
+	 * {
+	 *     layer.weights = arena.carve<float>(layer.nweights);
+	 *     layer.biases  = arena.carve<float>(layer.n);
+	 *     if (pass == 0)
+	 *     {
+	 *         arena.commit();
+	 *     }
+	 * }
+	 * ~~~~
+	 *
+	 * @see @ref Network::allocate_layers()
+	 *
+	 * @since 2026-10-17
+	 */
+	class Arena final
+	{
+		public:
+
+			/// Destructor.  Releases all of the memory.
+			~Arena();
+
+			/// Constructor.  The arena starts out empty and in planning mode.
+			Arena();
+
+			/// @{ Arenas own their memory and cannot be copied.
+			Arena(const Arena &) = delete;
+			Arena & operator=(const Arena &) = delete;
+			/// @}
+
+			/// Release all of the memory and go back to planning mode.
+			Arena & clear();
+
+			/** Allocate all of the bytes requested so far while planning.  The memory is zeroed.  After calling this,
+			 * @ref carve() returns real pointers, starting again from the beginning of the arena.
+			 */
+			Arena & commit();
+
+			/** Restart carving from the beginning of the arena without releasing any memory.  This is needed when the
+			 * exact same sequence of calls to @ref carve() must be repeated.
+			 */
+			Arena & rewind();
+
+			/** Carve out a buffer for @p count objects of type @p T.  While planning this only records the size and
+			 * returns @p nullptr.  Once committed, this returns a pointer aligned to @ref kArenaAlignment.  Requesting
+			 * zero objects always returns @p nullptr.
+			 */
+			template <typename T>
+			T * carve(const size_t count)
+			{
+				return static_cast<T*>(carve_bytes(count * sizeof(T)));
+			}
+
+			/// Untyped version of @ref carve().
+			void * carve_bytes(const size_t bytes);
+
+			/// Returns @p true once @ref commit() has been called.
+			bool committed() const { return base != nullptr; }
+
+			/// The total number of bytes planned or allocated, including padding.
+			size_t size() const { return total; }
+
+			/// The number of bytes carved so far in the current pass.
+			size_t used() const { return offset; }
+
+		private:
+
+			void *		raw;	///< pointer returned by @p calloc(), which is needed to free the memory
+			uint8_t *	base;	///< @p raw rounded up to @ref kArenaAlignment
+			size_t		total;	///< total number of bytes needed by all the calls to @ref carve()
+			size_t		offset;	///< where the next buffer will be carved from
+	};
+}
@@ -3,8 +3,297 @@
 
 #include "darknet-ng.hpp"
 #include "Config.hpp"
+#include <cerrno>
+#include <climits>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <regex>
+#include <shared_mutex>
+
+
+namespace
+{
+	/// Similar to @ref Darknet_ng::strip_text() but does not modify or copy the text.
+	inline std::string_view strip_view(std::string_view text)
+	{
+		const size_t first = text.find_first_not_of(" \t\r\n");
+		if (first == std::string_view::npos)
+		{
+			return std::string_view();
+		}
+
+		const size_t last = text.find_last_not_of(" \t\r\n");
+
+		return text.substr(first, last - first + 1);
+	}
+
+
+	/** All of the interned key names.  A deque is used so references returned by @ref Darknet_ng::key_name() remain
+	 * valid as new keys are added.  The @p sorted vector contains the same keys ordered by name, which is what
+	 * @ref Darknet_ng::find_key() uses to do a binary search.
+	 */
+	struct KeyTable final
+	{
+		std::deque<std::string>			names;
+		std::vector<Darknet_ng::KeyId>	sorted;
+		std::shared_mutex				mutex;
+	};
+
+
+	KeyTable & get_key_table()
+	{
+		static KeyTable table;
+
+		return table;
+	}
+
+
+	/** Compare a key of any case with a lowercase key name.  Returns a negative number if @p lhs sorts first, a positive
+	 * number if @p rhs sorts first, and zero if they match.
+	 */
+	inline int compare_key(std::string_view lhs, const std::string & rhs)
+	{
+		const size_t len = std::min(lhs.size(), rhs.size());
+		for (size_t idx = 0; idx < len; idx ++)
+		{
+			// keys are plain ASCII, so avoid the locale lookup done by std::tolower()
+			const char c = (lhs[idx] >= 'A' and lhs[idx] <= 'Z' ? lhs[idx] + ('a' - 'A') : lhs[idx]);
+			if (c != rhs[idx])
+			{
+				return (c < rhs[idx] ? -1 : 1);
+			}
+		}
+
+		if (lhs.size() == rhs.size())
+		{
+			return 0;
+		}
+
+		return (lhs.size() < rhs.size() ? -1 : 1);
+	}
+
+
+	/// Find where @p key is (or would be) within the sorted list of keys.  The caller must already hold the lock.
+	inline std::vector<Darknet_ng::KeyId>::iterator lower_bound_key(KeyTable & table, std::string_view key)
+	{
+		return std::lower_bound(table.sorted.begin(), table.sorted.end(), key,
+			[&](const Darknet_ng::KeyId id, std::string_view k)
+			{
+				return compare_key(k, table.names[id]) > 0;
+			});
+	}
+
+
+	/// Find the option within a section.  The key must exist, otherwise an exception is thrown.
+	const Darknet_ng::Option & get_option(const Darknet_ng::Section & section, std::string_view key)
+	{
+		const Darknet_ng::Option * option = section.find(key);
+		if (option == nullptr)
+		{
+			/// @throw Exception The given key does not exist in this section.
+			throw Darknet_ng::Exception("section [" + section.name + "] does not contain the key " + Darknet_ng::lowercase(std::string(key)), DNG_LOC);
+		}
+
+		return *option;
+	}
+
+
+	/// Get the integer value of an option, or throw if the value is not an integer.
+	int to_int(const Darknet_ng::Section & section, const Darknet_ng::Option & option)
+	{
+		std::cout << "i[" << Darknet_ng::key_name(option.key) << "]=" << option.value << std::endl;
+
+		if (not option.is_int)
+		{
+			/// @throw Exception The given key cannot be converted to an integer.
+			throw Darknet_ng::Exception(Darknet_ng::key_name(option.key) + " in section [" + section.name + "] cannot be converted to an integer (" + option.value + ")", DNG_LOC);
+		}
+
+		return option.int_value;
+	}
+
+
+	/// Get the float value of an option, or throw if the value is not a float.
+	float to_float(const Darknet_ng::Section & section, const Darknet_ng::Option & option)
+	{
+		std::cout << "f[" << Darknet_ng::key_name(option.key) << "]=" << option.value << std::endl;
+
+		if (not option.is_float)
+		{
+			/// @throw Exception The given key cannot be converted to a float.
+			throw Darknet_ng::Exception(Darknet_ng::key_name(option.key) + " in section [" + section.name + "] cannot be converted to a float (" + option.value + ")", DNG_LOC);
+		}
+
+		return option.float_value;
+	}
+
+
+	/// Get the bool value of an option, or throw if the value is not a bool.
+	bool to_bool(const Darknet_ng::Section & section, const Darknet_ng::Option & option)
+	{
+		if (not option.is_bool)
+		{
+			/// @throw Exception The given key cannot be converted to a bool.
+			throw Darknet_ng::Exception(Darknet_ng::key_name(option.key) + " in section [" + section.name + "] cannot be converted to a bool (" + Darknet_ng::lowercase(option.value) + ")", DNG_LOC);
+		}
+
+		std::cout << "b[" << Darknet_ng::key_name(option.key) << "]=" << (option.bool_value ? "true" : "false") << std::endl;
+
+		return option.bool_value;
+	}
+}
+
+
+Darknet_ng::KeyId Darknet_ng::intern_key(std::string_view key)
+{
+	KeyTable & table = get_key_table();
+
+	std::unique_lock lock(table.mutex);
+
+	auto iter = lower_bound_key(table, key);
+	if (iter != table.sorted.end() and compare_key(key, table.names[*iter]) == 0)
+	{
+		return *iter;
+	}
+
+	const KeyId id = table.names.size();
+	table.names.push_back(lowercase(std::string(key)));
+	table.sorted.insert(iter, id);
+
+	return id;
+}
+
+
+bool Darknet_ng::find_key(std::string_view key, KeyId & id)
+{
+	KeyTable & table = get_key_table();
+
+	std::shared_lock lock(table.mutex);
+
+	const auto iter = lower_bound_key(table, key);
+	if (iter == table.sorted.end() or compare_key(key, table.names[*iter]) != 0)
+	{
+		return false;
+	}
+
+	id = *iter;
+
+	return true;
+}
+
+
+const std::string & Darknet_ng::key_name(const KeyId id)
+{
+	KeyTable & table = get_key_table();
+
+	std::shared_lock lock(table.mutex);
+
+	return table.names.at(id);
+}
+
+
+Darknet_ng::Option::Option(const KeyId k, std::string_view v) :
+	key(k),
+	value(v),
+	is_int(false),
+	is_float(false),
+	is_bool(false),
+	is_int_list(true),
+	is_float_list(true),
+	int_value(0),
+	float_value(0.0f),
+	bool_value(false)
+{
+	/* Parse the value every way the accessors in Section might need it.  The conversions mirror what was previously
+	 * done on every call with std::stod(), std::stof(), and std::stoi():  leading whitespace is skipped, trailing text
+	 * is ignored, and values which are out of range are rejected.
+	 */
+	const char * const text = value.c_str();
+	char * end = nullptr;
+
+	errno = 0;
+	const double d = std::strtod(text, &end);
+	if (end != text and errno != ERANGE and d > INT_MIN - 1.0 and d < INT_MAX + 1.0)
+	{
+		is_int = true;
+		int_value = static_cast<int>(d);
+	}
+
+	errno = 0;
+	const float f = std::strtof(text, &end);
+	if (end != text and errno != ERANGE)
+	{
+		is_float = true;
+		float_value = f;
+	}
+
+	const std::string lower = lowercase(value);
+	if (lower == "0" or
+		lower == "f" or
+		lower == "off" or
+		lower == "false")
+	{
+		is_bool = true;
+		bool_value = false;
+	}
+	else if (lower == "1" or
+		lower == "t" or
+		lower == "on" or
+		lower == "true")
+	{
+		is_bool = true;
+		bool_value = true;
+	}
+
+	// lists are comma-separated, such as:  steps=-1,100,20000,30000
+	size_t pos = 0;
+	while (pos < value.size())
+	{
+		size_t next = value.find(',', pos);
+		if (next == std::string::npos)
+		{
+			next = value.size();
+		}
+
+		const char * const token = text + pos;
+
+		errno = 0;
+		const long l = std::strtol(token, &end, 10);
+		if (end == token or errno == ERANGE or l < INT_MIN or l > INT_MAX)
+		{
+			is_int_list = false;
+		}
+		else if (is_int_list)
+		{
+			int_list.push_back(l);
+		}
+
+		errno = 0;
+		const float val = std::strtof(token, &end);
+		if (end == token or errno == ERANGE)
+		{
+			is_float_list = false;
+		}
+		else if (is_float_list)
+		{
+			float_list.push_back(val);
+		}
+
+		pos = next + 1;
+	}
+
+	if (not is_int_list)
+	{
+		int_list.clear();
+	}
+	if (not is_float_list)
+	{
+		float_list.clear();
+	}
+
+	return;
+}
 
 
 Darknet_ng::Section::~Section()
@@ -31,14 +320,14 @@ Darknet_ng::Section::Section(const std::string & n, const size_t line) :
 
 bool Darknet_ng::Section::empty() const
 {
-	return kv_pairs.empty();
+	return options.empty();
 }
 
 
 Darknet_ng::Section & Darknet_ng::Section::clear()
 {
 	line_number	= 0;
-	kv_pairs	.clear();
+	options		.clear();
 	name		.clear();
 
 	return *this;
@@ -49,7 +338,7 @@ bool Darknet_ng::Section::operator==(const Darknet_ng::Section & rhs) const
 {
 	return
 		name		== rhs.name and
-		kv_pairs	== rhs.kv_pairs
+		options		== rhs.options
 		/* The line number is meta-data used for debugging.
 		 * Don't bother comparing the line number.
 		 *
@@ -59,195 +348,195 @@ bool Darknet_ng::Section::operator==(const Darknet_ng::Section & rhs) const
 }
 
 
-const std::string & Darknet_ng::Section::operator[](const std::string & key) const
-{
-	return s(key);
-}
-
-
-int Darknet_ng::Section::i(const std::string & key) const
+Darknet_ng::Section & Darknet_ng::Section::add(std::string_view key, std::string_view value)
 {
-	const auto key_name = lowercase(key);
-
-	const std::string & val = kv_pairs.at(key_name);
+	const KeyId id = intern_key(key);
 
-	std::cout << "i[" << key_name << "]=" << val << std::endl;
+	auto iter = std::lower_bound(options.begin(), options.end(), id,
+		[](const Option & option, const KeyId k)
+		{
+			return option.key < k;
+		});
 
-	int result = 0;
-	try
-	{
-		result = std::stod(val);
-	}
-	catch (std::exception & e)
+	if (iter != options.end() and iter->key == id)
 	{
-		/// @throw Exception The given key cannot be converted to an integer.
-		throw Exception(key_name + " in section [" + name + "] cannot be converted to an integer (" + val + ")", DNG_LOC);
+		/// @throw Exception A section should not contain duplicate keys.
+		throw Exception("[" + name + "] already contains " + key_name(id) + "=" + iter->value, DNG_LOC);
 	}
 
-	return result;
+	options.emplace(iter, id, value);
+
+	return *this;
 }
 
 
-int Darknet_ng::Section::i(const std::string & key, const int default_value) const
+const Darknet_ng::Option * Darknet_ng::Section::find(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
+	KeyId id = 0;
+	if (not find_key(key, id))
+	{
+		// this key was never seen in any configuration file, so it cannot exist in this section
+		return nullptr;
+	}
 
-	if (kv_pairs.count(key_name) == 0)
+	const auto iter = std::lower_bound(options.begin(), options.end(), id,
+		[](const Option & option, const KeyId k)
+		{
+			return option.key < k;
+		});
+
+	if (iter == options.end() or iter->key != id)
 	{
-		std::cout << "i[" << key_name << "]=" << default_value << " (default value)" << std::endl;
-		return default_value;
+		return nullptr;
 	}
 
-	return i(key_name);
+	return &(*iter);
 }
 
 
-float Darknet_ng::Section::f(const std::string & key) const
+const std::string & Darknet_ng::Section::operator[](std::string_view key) const
 {
-	const auto key_name = lowercase(key);
-
-	const std::string & val = kv_pairs.at(key_name);
-
-	std::cout << "f[" << key_name << "]=" << val << std::endl;
+	return s(key);
+}
 
-	float result = 0.0f;
-	try
-	{
-		result = std::stof(val);
-	}
-	catch (std::exception & e)
-	{
-		/// @throw Exception The given key cannot be converted to a float.
-		throw Exception(key_name + " in section [" + name + "] cannot be converted to a float (" + val + ")", DNG_LOC);
-	}
 
-	return result;
+int Darknet_ng::Section::i(std::string_view key) const
+{
+	return to_int(*this, get_option(*this, key));
 }
 
 
-float Darknet_ng::Section::f(const std::string & key, const float default_value) const
+int Darknet_ng::Section::i(std::string_view key, const int default_value) const
 {
-	const auto key_name = lowercase(key);
-
-	if (kv_pairs.count(key_name) == 0)
+	const Option * option = find(key);
+	if (option == nullptr)
 	{
-		std::cout << "f[" << key_name << "]=" << default_value << " (default value)" << std::endl;
+		std::cout << "i[" << key << "]=" << default_value << " (default value)" << std::endl;
 		return default_value;
 	}
 
-	return f(key_name);
+	return to_int(*this, *option);
 }
 
 
-bool Darknet_ng::Section::b(const std::string & key) const
+float Darknet_ng::Section::f(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
-	const std::string val = lowercase(kv_pairs.at(key_name));
+	return to_float(*this, get_option(*this, key));
+}
 
-	if (val == "0" or
-		val == "f" or
-		val == "off" or
-		val == "false")
-	{
-		std::cout << "b[" << key_name << "]=false" << std::endl;
-		return false;
-	}
 
-	if (val == "1" or
-		val == "t" or
-		val == "on" or
-		val == "true")
+float Darknet_ng::Section::f(std::string_view key, const float default_value) const
+{
+	const Option * option = find(key);
+	if (option == nullptr)
 	{
-		std::cout << "b[" << key_name << "]=true" << std::endl;
-		return true;
+		std::cout << "f[" << key << "]=" << default_value << " (default value)" << std::endl;
+		return default_value;
 	}
 
-	/// @throw Exception The given key cannot be converted to a bool.
-	throw Exception(key_name + " in section [" + name + "] cannot be converted to a bool (" + val + ")", DNG_LOC);
+	return to_float(*this, *option);
 }
 
 
-bool Darknet_ng::Section::b(const std::string & key, const bool default_value) const
+bool Darknet_ng::Section::b(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
+	return to_bool(*this, get_option(*this, key));
+}
+
 
-	if (kv_pairs.count(key_name) == 0)
+bool Darknet_ng::Section::b(std::string_view key, const bool default_value) const
+{
+	const Option * option = find(key);
+	if (option == nullptr)
 	{
-		std::cout << "b[" << key_name << "]=" << default_value << " (default value)" << std::endl;
+		std::cout << "b[" << key << "]=" << default_value << " (default value)" << std::endl;
 		return default_value;
 	}
 
-	return b(key_name);
+	return to_bool(*this, *option);
 }
 
 
-const std::string & Darknet_ng::Section::s(const std::string & key) const
+const std::string & Darknet_ng::Section::s(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
+	const Option & option = get_option(*this, key);
 
-	std::cout << "f[" << key_name << "]=" << kv_pairs.at(key_name) << std::endl;
+	std::cout << "s[" << key_name(option.key) << "]=" << option.value << std::endl;
 
-	return kv_pairs.at(key_name);
+	return option.value;
 }
 
 
-std::string Darknet_ng::Section::s(const std::string & key, const std::string & default_value) const
+std::string Darknet_ng::Section::s(std::string_view key, const std::string & default_value) const
 {
-	const auto key_name = lowercase(key);
-
-	if (kv_pairs.count(key_name) == 0)
+	const Option * option = find(key);
+	if (option == nullptr)
 	{
-		std::cout << "s[" << key_name << "]=" << default_value << " (default value)" << std::endl;
+		std::cout << "s[" << key << "]=" << default_value << " (default value)" << std::endl;
 		return default_value;
 	}
 
-	return kv_pairs.at(key_name);
+	return option->value;
 }
 
 
-Darknet_ng::VI Darknet_ng::Section::vi(const std::string & key) const
+const Darknet_ng::VI & Darknet_ng::Section::vi(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
+	static const VI empty_list;
 
 	// for example:  steps=-1,100,20000,30000
 
-	VI v;
-	std::string token;
-	std::stringstream ss(s(key_name, ""));
-	std::cout << "vi[" << key_name << "]=";
+	const Option * option = find(key);
+	if (option == nullptr)
+	{
+		std::cout << "vi[" << key << "]=" << std::endl;
+		return empty_list;
+	}
 
-	while (std::getline(ss, token, ','))
+	if (not option->is_int_list)
+	{
+		/// @throw Exception The given key cannot be converted to a list of integers.
+		throw Exception(key_name(option->key) + " in section [" + name + "] cannot be converted to a list of integers (" + option->value + ")", DNG_LOC);
+	}
+
+	std::cout << "vi[" << key_name(option->key) << "]=";
+	for (const auto val : option->int_list)
 	{
-		const auto val = std::stoi(token);
 		std::cout << val << " ";
-		v.push_back(val);
 	}
 	std::cout << std::endl;
 
-	return v;
+	return option->int_list;
 }
 
 
-Darknet_ng::VF Darknet_ng::Section::vf(const std::string & key) const
+const Darknet_ng::VF & Darknet_ng::Section::vf(std::string_view key) const
 {
-	const auto key_name = lowercase(key);
+	static const VF empty_list;
 
 	// for example:  scales=.1,.1
 
-	VF v;
-	std::string token;
-	std::stringstream ss(s(key_name, ""));
-	std::cout << "vf[" << key_name << "]=";
+	const Option * option = find(key);
+	if (option == nullptr)
+	{
+		std::cout << "vf[" << key << "]=" << std::endl;
+		return empty_list;
+	}
 
-	while (std::getline(ss, token, ','))
+	if (not option->is_float_list)
+	{
+		/// @throw Exception The given key cannot be converted to a list of floats.
+		throw Exception(key_name(option->key) + " in section [" + name + "] cannot be converted to a list of floats (" + option->value + ")", DNG_LOC);
+	}
+
+	std::cout << "vf[" << key_name(option->key) << "]=";
+	for (const auto val : option->float_list)
 	{
-		const auto val = std::stof(token);
 		std::cout << val << " ";
-		v.push_back(val);
 	}
 	std::cout << std::endl;
 
-	return v;
+	return option->float_list;
 }
 
 
@@ -289,7 +578,8 @@ Darknet_ng::Config & Darknet_ng::Config::read(const std::filesystem::path & cfg_
 {
 	clear();
 
-	auto v = read_text_file(cfg_filename);
+	// the entire file is read in one go, and then everything else is a view into that single buffer
+	const std::string text = read_entire_file(cfg_filename);
 
 	/* Everything in the .cfg file is one of the following:
 	 *
@@ -298,6 +588,106 @@ Darknet_ng::Config & Darknet_ng::Config::read(const std::filesystem::path & cfg_
 	 *	3) section names, such as "[net]"
 	 *	4) key-value pairs, such as "batch = 1"
 	 */
+
+	std::string_view remaining(text);
+	size_t line_number = 0;
+	while (not remaining.empty())
+	{
+		line_number ++;
+
+		const size_t eol = remaining.find('\n');
+		std::string_view line = strip_view(remaining.substr(0, eol));
+		remaining.remove_prefix(eol == std::string_view::npos ? remaining.size() : eol + 1);
+
+		if (line.empty() or line[0] == '#' or line[0] == ';')
+		{
+			// ignore blank lines and comments
+			continue;
+		}
+
+		if (line[0] == '[')
+		{
+			// new section found, such as "[net]" -- anything after the closing "]" is ignored
+			const size_t pos = line.find(']');
+			const std::string_view section_name = (pos == std::string_view::npos ? std::string_view() : strip_view(line.substr(1, pos - 1)));
+			if (section_name.empty())
+			{
+				/// @throw Exception The line is not a valid configuration line.
+				throw Exception("failed to parse line #" + std::to_string(line_number) + " in " + cfg_filename.string(), DNG_LOC);
+			}
+
+			sections.emplace_back(std::string(section_name), line_number);
+			continue;
+		}
+
+		/* We have a key-value pair, such as "batch=1" or "mask = 3,4,5  # comment".  The key is the first word.  If the
+		 * "=" is not found after the first word, then the key ends at the last "=" within that word, which is how the
+		 * regular expression previously used to parse this line also behaved.
+		 */
+		size_t key_end = line.find_first_of(" \t\r\n");
+		if (key_end == std::string_view::npos)
+		{
+			key_end = line.size();
+		}
+		size_t pos = line.find_first_not_of(" \t\r\n", key_end);
+		if (pos == std::string_view::npos or line[pos] != '=')
+		{
+			pos = line.substr(0, key_end).rfind('=');
+			if (pos == std::string_view::npos or pos == 0)
+			{
+				/// @throw Exception The line is not a valid configuration line.
+				throw Exception("failed to parse line #" + std::to_string(line_number) + " in " + cfg_filename.string(), DNG_LOC);
+			}
+			key_end = pos;
+		}
+
+		// the value is everything after the "=" up to an optional trailing comment
+		std::string_view val = line.substr(pos + 1);
+		val = strip_view(val.substr(0, val.find('#')));
+
+		// make sure we at least have a section before we attempt to add a new key-value pair
+
+		if (sections.empty())
+		{
+			/// @throw Exception The configuration should not begin before a section name.
+			throw Exception("config cannot have values prior to \"[...]\" section name at line " + std::to_string(line_number), DNG_LOC);
+		}
+
+		const std::string_view key = line.substr(0, key_end);
+
+		// add this key-pair to the *most recent* section that we created
+		Section & section = sections.back();
+		const Option * option = section.find(key);
+		if (option != nullptr)
+		{
+			/// @throw Exception A section should not contain duplicate keys.
+			throw Exception("[" + section.name + "] already contains " + key_name(option->key) + "=" + option->value + ", but duplicate key found on line #" + std::to_string(line_number), DNG_LOC);
+		}
+		section.add(key, val);
+	}
+
+	if (empty())
+	{
+		/// @throw Exception The configuration file appears to be empty.
+		throw Exception("configuration file is empty: \"" + cfg_filename.string() + "\"", DNG_LOC);
+	}
+
+	if (layer_type_from_string(sections[0].name) != ELayerType::kNetwork)
+	{
+		/// @throw Exception The configuration file should start with [net] or [network].
+		throw Exception("configuration file must start with [net] or [network] section: " + cfg_filename.string() + "\"", DNG_LOC);
+	}
+
+	return *this;
+}
+
+
+Darknet_ng::Config & Darknet_ng::Config::read_reference(const std::filesystem::path & cfg_filename)
+{
+	clear();
+
+	auto v = read_text_file(cfg_filename);
+
 	const std::regex rx(
 		"^[#;]"						// comment lines we need to ignore
 		"|"
@@ -308,8 +698,6 @@ Darknet_ng::Config & Darknet_ng::Config::read(const std::filesystem::path & cfg_
 		"([^#]*)"					// group #3:  optional value
 	);
 
-	std::string most_recent_section_name;
-
 	size_t line_number = 0;
 	for (auto & line : v)
 	{
@@ -346,22 +734,20 @@ Darknet_ng::Config & Darknet_ng::Config::read(const std::filesystem::path & cfg_
 			continue;
 		}
 
-		// we have a key-value pair...but make sure we at least have a section before we attempt to add a new key-value pair
-
 		if (sections.empty())
 		{
 			/// @throw Exception The configuration should not begin before a section name.
 			throw Exception("config cannot have values prior to \"[...]\" section name at line " + std::to_string(line_number), DNG_LOC);
 		}
 
-		// add this key-pair to the *most recent* section that we created
 		Section & section = *sections.rbegin();
-		if (section.kv_pairs.count(key) > 0)
+		const Option * option = section.find(key);
+		if (option != nullptr)
 		{
 			/// @throw Exception A section should not contain duplicate keys.
-			throw Exception("[" + section.name + "] already contains " + key + "=" + section.kv_pairs[key] + ", but duplicate key found on line #" + std::to_string(line_number), DNG_LOC);
+			throw Exception("[" + section.name + "] already contains " + key + "=" + option->value + ", but duplicate key found on line #" + std::to_string(line_number), DNG_LOC);
 		}
-		section.kv_pairs[key] = val;
+		section.add(key, val);
 	}
 
 	if (empty())
@@ -459,11 +845,11 @@ std::ostream & Darknet_ng::operator<<(std::ostream & os, const Darknet_ng::Secti
 	}
 
 	os	<< std::endl
-		<< "# keys: " << section.kv_pairs.size() << std::endl;
+		<< "# keys: " << section.options.size() << std::endl;
 
-	for (const auto & [key, val] : section.kv_pairs)
+	for (const auto & option : section.options)
 	{
-		std::cout << key << "=" << val << std::endl;
+		os << key_name(option.key) << "=" << option.value << std::endl;
 	}
 
 	return os;
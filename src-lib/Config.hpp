@@ -8,6 +8,60 @@
 
 namespace Darknet_ng
 {
+	/** Section keys are interned.  Each unique (lowercase) key name seen while parsing a configuration file is assigned
+	 * a small integer, so sections can store and compare keys without any string compares.
+	 *
+	 * @see @ref intern_key()
+	 * @see @ref find_key()
+	 * @see @ref key_name()
+	 *
+	 * @since 2026-10-17
+	 */
+	using KeyId = uint32_t;
+
+	/** Get the ID for the given key name.  If this key has never been seen before, a new ID is assigned.  The key name
+	 * is converted to lowercase.  This is only called while parsing configuration files.
+	 */
+	KeyId intern_key(std::string_view key);
+
+	/** Look up the ID of a key which has already been interned.  Comparison is case-insensitive, and this never allocates
+	 * memory.  Returns @p false if the key has never been seen, in which case no section can possibly contain that key.
+	 */
+	bool find_key(std::string_view key, KeyId & id);
+
+	/// Get the lowercase name of an interned key.
+	const std::string & key_name(const KeyId id);
+
+	/** Every key-value pair within a @ref Section is stored as an option.  The value is parsed once when the option is
+	 * created, so the @p Section accessors don't need to convert the text every time they are called.  Since a value
+	 * can be interpreted in several ways -- for example, @p "1" is a valid integer, float, bool, and list of integers --
+	 * each interpretation is stored along with a flag indicating whether that conversion was possible.
+	 *
+	 * @since 2026-10-17
+	 */
+	struct Option final
+	{
+		/// Create a new option and pre-parse the value.
+		Option(const KeyId k, std::string_view v);
+
+		/// Compare the key and the original value.  The parsed values are derived from those two fields.
+		bool operator==(const Option & rhs) const { return key == rhs.key and value == rhs.value; }
+
+		KeyId		key;			///< The interned key name.  @see @ref key_name()
+		std::string	value;			///< The original text value.
+		bool		is_int;			///< @p true if @ref int_value is valid.
+		bool		is_float;		///< @p true if @ref float_value is valid.
+		bool		is_bool;		///< @p true if @ref bool_value is valid.
+		bool		is_int_list;	///< @p true if @ref int_list is valid.
+		bool		is_float_list;	///< @p true if @ref float_list is valid.
+		int			int_value;
+		float		float_value;
+		bool		bool_value;
+		VI			int_list;
+		VF			float_list;
+	};
+	using Options = std::vector<Option>;
+
 	/** A "section" is the [...] name and all key-value pairs that follow that name.  Note that sections are not unique.
 	 * For example, a configuration file might have multiple @p [yolo] sections, so don't store these in a set or a map.
 	 *
@@ -25,8 +79,9 @@ namespace Darknet_ng
 	 * @li key = @p size and val = @p 2
 	 * @li key = @p stride and val = @p 2
 	 *
-	 * @warning Keys are stored alphabetically in @ref kv_pairs, not in the order in which they have been added to the section.
-	 * This means if you parse a configuration file and then output the sections, the results may not necessarily match.
+	 * @warning Options are sorted by their interned key ID in @ref options, not in the order in which they have been added
+	 * to the section.  This means if you parse a configuration file and then output the sections, the results may not
+	 * necessarily match.
 	 *
 	 * @see @ref Darknet_ng::Config
 	 *
@@ -45,7 +100,7 @@ namespace Darknet_ng
 			/// Constructor.
 			Section(const std::string & n, const size_t line);
 
-			/** This return @p true only when @p kv_pairs is empty.  As soon as the section has a key-value pair then we
+			/** This return @p true only when @p options is empty.  As soon as the section has a key-value pair then we
 			 * consider it as non-empty.
 			 */
 			bool empty() const;
@@ -56,34 +111,42 @@ namespace Darknet_ng
 			/// Compare two @p Section objects.
 			bool operator==(const Section & rhs) const;
 
+			/** Add a new key-value pair to this section.  The key must not already exist in this section, otherwise an
+			 * exception is thrown.
+			 */
+			Section & add(std::string_view key, std::string_view value);
+
+			/// Find the option with the given key.  Returns @p nullptr if the key does not exist in this section.
+			const Option * find(std::string_view key) const;
+
 			/** Get the value for a specific key.  The key-value pair must exist, or this will throw an exception.
 			 * This is an alias for @ref s().
 			 */
-			const std::string & operator[](const std::string & key) const;
+			const std::string & operator[](std::string_view key) const;
 
 			/// Get the value corresponding to a key, and convert it to an @b integer.  The key must exist, and must be numeric.
-			int i(const std::string & key) const;
+			int i(std::string_view key) const;
 
 			/// Get the value corresponding to a key, and convert it to an @b integer.  If the key does not exist, use the provided default value.
-			int i(const std::string & key, const int default_value) const;
+			int i(std::string_view key, const int default_value) const;
 
 			/// Get the value corresponding to a key, and convert it to a @b float.  The key must exist, and must be numeric.
-			float f(const std::string & key) const;
+			float f(std::string_view key) const;
 
 			/// Get the value corresponding to a key, and convert it to a @b float.  If the key does not exist, use the provided default value.
-			float f(const std::string & key, const float default_value) const;
+			float f(std::string_view key, const float default_value) const;
 
 			/// Get the value corresponding to a key, and convert it to a @b bool.  The key must exist, and must be @p 0, @p 1, @p true, or @p false.
-			bool b(const std::string & key) const;
+			bool b(std::string_view key) const;
 
 			/// Get the value corresponding to a key, and convert it to a @b bool.  If the key does not exist, use the provided default value.
-			bool b(const std::string & key, const bool default_value) const;
+			bool b(std::string_view key, const bool default_value) const;
 
 			/// Get the value corresponding to a key.  The key must exist.
-			const std::string & s(const std::string & key) const;
+			const std::string & s(std::string_view key) const;
 
 			/// Get the value corresponding to a key.  If the key does not exist, use the provided default value.
-			std::string s(const std::string & key, const std::string & default_value) const;
+			std::string s(std::string_view key, const std::string & default_value) const;
 
 			/** Interpret the given key as a vector of @b integers.  The vector may be empty if the key does not exist or does not
 			 * contain any values.
@@ -94,7 +157,7 @@ namespace Darknet_ng
 			 * steps=-1,100,20000,30000
 			 * ~~~~
 			 */
-			VI vi(const std::string & key) const;
+			const VI & vi(std::string_view key) const;
 
 			/** Interpret the given key as a vector of @b floats.  The vector may be empty if the key does not exist or does not
 			 * contain any values.
@@ -105,7 +168,7 @@ namespace Darknet_ng
 			 * scales=.1,.1
 			 * ~~~~
 			 */
-			VF vf(const std::string & key) const;
+			const VF & vf(std::string_view key) const;
 
 			/// The section names are enclosed in square brackets, such as @p "[net]".
 			std::string name;
@@ -115,8 +178,10 @@ namespace Darknet_ng
 
 			/** Every section is composed of zero or more key-value pairs, such as @p "classes = 12" where the key would be
 			 * @p classes and the value would be @p 12.  The exact same key name cannot appear multiple times within a section.
+			 * This is kept sorted by @ref Option::key so lookups can use a binary search.  Use @ref add() to insert new
+			 * options.
 			 */
-			MStr kv_pairs;
+			Options options;
 	};
 	using Sections = std::vector<Section>;
 
@@ -185,6 +250,14 @@ namespace Darknet_ng
 			 */
 			Config & read(const std::filesystem::path & cfg_filename);
 
+			/** The original regular expression parser that @ref read() replaced, kept to test and benchmark @ref read()
+			 * against.  Lines containing only whitespace fail to parse, and any whitespace between a value and an inline
+			 * @p "#" comment is kept as part of the value.
+			 *
+			 * @since 2026-10-17
+			 */
+			Config & read_reference(const std::filesystem::path & cfg_filename);
+
 			/// Count the number of sections with the given name.
 			size_t count(const std::string & name) const;
 
@@ -213,13 +286,13 @@ namespace Darknet_ng
 	};
 
 	/** Convenience function to stream a @ref Section as plain text.  This is mostly for debug purposes.  Remember that
-	 * the keys in a section are stored alphabetically, so the order produced by calling this may not be exactly the same
+	 * the keys in a section are sorted by their interned ID, so the order produced by calling this may not be exactly the same
 	 * as the original configuration file.
 	 */
 	std::ostream & operator<<(std::ostream & os, const Section & section);
 
 	/** Convenience function to stream a configuration as plain text.  This is mostly for debug purposes.  Remember that
-	 * @ref Sections store keys alphabetically, so the order produced by calling this may not be exactly the same as the
+	 * @ref Sections sort keys by their interned ID, so the order produced by calling this may not be exactly the same as the
 	 * original configuration file that was parsed by @ref Config::read().
 	 */
 	std::ostream & operator<<(std::ostream & os, const Config & cfg);
@@ -0,0 +1,107 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::InferenceContext::~InferenceContext()
+{
+	// the antialiasing layers are the only ones which were copied, everything else still belongs to the network
+	for (auto & layer : layers)
+	{
+		delete layer.input_layer;
+	}
+
+	return;
+}
+
+
+Darknet_ng::InferenceContext::InferenceContext(const Darknet_ng::Network & net, const size_t batch) :
+	network(net),
+	max_batch(batch),
+	workspace(nullptr)
+{
+	if (network.empty())
+	{
+		/// @throw Exception The network must be loaded before it can be used.
+		throw Exception("cannot create an inference context since the network has not been loaded", DNG_LOC);
+	}
+
+	if (network.settings.train)
+	{
+		/// @throw Exception Training needs every output of the network, which are not planned like the inference outputs.
+		throw Exception("cannot create an inference context for a network which is being trained", DNG_LOC);
+	}
+
+	if (max_batch < 1 or max_batch > static_cast<size_t>(network.settings.batch))
+	{
+		/// @throw Exception The layers and the workspace were sized for the batch in the configuration.
+		throw Exception("cannot create an inference context for a batch of " + std::to_string(max_batch) + " since the network was loaded with batch=" + std::to_string(network.settings.batch), DNG_LOC);
+	}
+
+	// predict() may have changed the batch of the layers of the network, so the batch of the copies is set again
+	layers = network.layers;
+	for (auto & layer : layers)
+	{
+		layer.batch = max_batch;
+		if (layer.input_layer)
+		{
+			layer.input_layer = new Layer(*layer.input_layer);
+			layer.input_layer->batch = max_batch;
+		}
+	}
+
+	// the 1st pass finds the size of the arena, and the 2nd pass carves out the buffers
+	const auto & plan = network.activation_plan;
+	for (int pass = 0; pass < 2; pass ++)
+	{
+		// the outputs share slabs exactly like those of the network, see Network::allocate_layers()
+		std::vector<float *> slabs;
+		for (const size_t size : plan.slab_size)
+		{
+			// the slabs of the network hold the outputs of the full batch
+			slabs.push_back(arena.carve<float>(size / network.settings.batch * max_batch));
+		}
+
+		for (size_t idx = 0; idx < layers.size(); idx ++)
+		{
+			Layer & layer = layers[idx];
+
+			const int slab = plan.slab[idx];
+			layer.output = (slab < 0 ? nullptr : slabs[slab]);
+
+			if (layer.type == ELayerType::kConvolutional)
+			{
+				carve_convolutional_scratch(arena, layer);
+			}
+
+			if (layer.input_layer)
+			{
+				carve_convolutional_scratch(arena, *layer.input_layer);
+				layer.input_layer->output = arena.carve<float>(layer.batch * layer.steps * layer.input_layer->outputs);
+			}
+		}
+
+		// the workspace of a layer depends on how its items are split across the threads, so it is not made smaller
+		workspace = static_cast<float*>(arena.carve_bytes(network.workspace_size));
+
+		if (pass == 0)
+		{
+			arena.commit();
+		}
+	}
+
+	return;
+}
+
+
+const float * Darknet_ng::InferenceContext::predict(const float * input, const size_t batch)
+{
+	if (batch > max_batch)
+	{
+		/// @throw Exception The buffers are sized for the batch given to the constructor.
+		throw Exception("cannot run inference on a batch of " + std::to_string(batch) + " since the context was created with batch=" + std::to_string(max_batch), DNG_LOC);
+	}
+
+	return network.predict(layers, workspace, input, batch);
+}
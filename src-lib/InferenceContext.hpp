@@ -0,0 +1,81 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#pragma once
+
+#include "darknet-ng.hpp"
+
+
+namespace Darknet_ng
+{
+	/** Everything a single inference needs which cannot be shared with the other inferences running at the same time:
+	 * the layer outputs, the scratch buffers of the XNOR layers, the workspace, and the batch.  The weights -- including
+	 * the packed, Winograd, and blocked copies -- belong to the @ref Network and are only read during inference, so
+	 * several threads can run inference on the same network at once with one context each.  Each context only costs the
+	 * memory of the activations and of the workspace.
+	 *
+	 * ~~~~
+	 * Darknet_ng::Network network("yolov4-tiny.cfg");
+	 * network.fuse_layers();
+	 *
+	 * #pragma omp parallel num_threads(4)
+	 * {
+	 *     Darknet_ng::InferenceContext context(network);
+	 *     const float * output = context.predict(image);
+	 * }
+	 * ~~~~
+	 *
+	 * The layers are copied when the context is created, so it must be created after the network has been fused,
+	 * autotuned, or switched to the blocked layout.  The network must outlive all of its contexts.
+	 *
+	 * @since 2026-10-17
+	 */
+	class InferenceContext final
+	{
+		public:
+
+			/// Destructor.
+			~InferenceContext();
+
+			/** Constructor.  The buffers are sized for @p max_batch images, which cannot be larger than the batch the
+			 * network was loaded with.  The network must already be loaded, and cannot be in training mode.
+			 */
+			InferenceContext(const Network & net, const size_t max_batch = 1);
+
+			/// @{ Contexts own their buffers and cannot be copied.
+			InferenceContext(const InferenceContext &) = delete;
+			InferenceContext & operator=(const InferenceContext &) = delete;
+			/// @}
+
+			/** Same as @ref Network::predict(), but using the buffers of this context.  @p batch cannot be larger than
+			 * the batch given to the constructor.  The pointer returned remains valid until the next call to
+			 * @ref predict() on this context.
+			 */
+			const float * predict(const float * input, const size_t batch = 1);
+
+			/// Get the workspace of this context, which is the same size as the workspace of the network.
+			float * get_workspace() const { return workspace; }
+
+			/// The number of bytes used by the buffers of this context, including the workspace.
+			size_t size() const { return arena.size(); }
+
+			/// The network which owns the weights.
+			const Network & network;
+
+			/** Copies of the layers of the network.  These point to the same weights, but each of them has an output
+			 * and scratch buffers of its own.
+			 */
+			Layers layers;
+
+		private:
+
+			/// The largest batch which fits in the buffers.
+			size_t max_batch;
+
+			/// The layer outputs, the scratch buffers, and the workspace.
+			Arena arena;
+
+			/// The workspace used while running the layers, aligned to @ref kArenaAlignment.
+			float * workspace;
+	};
+}
@@ -114,6 +114,21 @@ std::string Darknet_ng::to_string(const Darknet_ng::ELayerType & layer_type)
 }
 
 
+std::string Darknet_ng::to_string(const Darknet_ng::EConvAlgorithm & algorithm)
+{
+	switch (algorithm)
+	{
+		case EConvAlgorithm::kIm2col:		return "im2col";
+		case EConvAlgorithm::kImplicitGEMM:	return "implicit_gemm";
+		case EConvAlgorithm::kWinograd:		return "winograd";
+		case EConvAlgorithm::kGrouped:		return "grouped";
+	}
+
+	/// @throw Exception The given algorithm enum is unknown.
+	throw Exception("unknown convolution algorithm: " + std::to_string(static_cast<int>(algorithm)), DNG_LOC);
+}
+
+
 size_t Darknet_ng::get_workspace_size32(const Darknet_ng::Layer & layer)
 {
 	#ifdef CUDNN
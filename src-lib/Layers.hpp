@@ -79,290 +79,97 @@ namespace Darknet_ng
 	/// Convert the layer type to a text string.  These are the section names in the config file.
 	std::string to_string(const ELayerType & layer_type);
 
-
-	struct Layer /// was: layer
+	/** The different ways a convolutional layer can be computed on the CPU.
+	 * @see @ref choose_convolutional_algorithm()
+	 *
+	 * @since 2026-10-17
+	 */
+	enum class EConvAlgorithm
 	{
-		ELayerType		type;
-		EActivation		activation;
-		EActivation		lstm_activation;
-		ECostType		cost_type;
+		kIm2col			,	///< im2col into the workspace followed by a GEMM, which is what the original code did
+		kImplicitGEMM	,	///< GEMM which gathers the input pixels while packing, so no workspace is needed
+		kWinograd		,	///< Winograd F(4x4,3x3) with pre-transformed filters, for 3x3 layers with a stride of 1
+		kGrouped		,	///< direct convolution on the input planes, for depthwise layers and layers with many small groups
+	};
 
-		void(*forward)   (struct layer, struct network_state);
-		void(*backward)  (struct layer, struct network_state);
-		void(*update)    (struct layer, int, float, float, float);
-		void(*forward_gpu)   (struct layer, struct network_state);
-		void(*backward_gpu)  (struct layer, struct network_state);
-		void(*update_gpu)    (struct layer, int, float, float, float, float);
-		Layer *share_layer;
-		int train;
-		int avgpool;
-		int batch_normalize;
-		int shortcut;
-		int batch;
-		int dynamic_minibatch;
-		int forced;
-		int flipped;
-		int inputs;
-		int outputs;
-		float mean_alpha;
-		int nweights;
-		int nbiases;
-		int extra;
-		int truths;
-		int h;
-		int w;
-		int c;
-		int out_h;
-		int out_w;
-		int out_c;
-		int n;
-		int max_boxes;
-		int truth_size;
-		int groups;
-		int group_id;
-		int size;
-		int side;
-		int stride;
-		int stride_x;
-		int stride_y;
-		int dilation;
-		int antialiasing;
-		int maxpool_depth;
-		int maxpool_zero_nonmax;
-		int out_channels;
-		float reverse;
-		int coordconv;
-		int flatten;
-		int spatial;
-		int pad;
-		int sqrt;
-		int flip;
-		int index;
-		int scale_wh;
-		int binary;
-		int xnor; // boolean flag?
-		int peephole;
-		int use_bin_output;
-		int keep_delta_gpu;
-		int optimized_memory;
-		int steps;
-		int history_size;
-		int bottleneck;
-		float time_normalizer;
-		int state_constrain;
-		int hidden;
-		int truth;
-		float smooth;
-		float dot;
-		int deform;
-		int grad_centr;
-		int sway;
-		int rotate;
-		int stretch;
-		int stretch_sway;
-		float angle;
-		float jitter;
-		float resize;
-		float saturation;
-		float exposure;
-		float shift;
-		float ratio;
-		float learning_rate_scale;
-		float clip;
-		int focal_loss;
-		float *classes_multipliers;
-		float label_smooth_eps;
-		int noloss;
-		int softmax;
-		int classes;
-		int detection;
-		int embedding_layer_id;
-		float *embedding_output;
-		int embedding_size;
-		float sim_thresh;
-		int track_history_size;
-		int dets_for_track;
-		int dets_for_show;
-		float track_ciou_norm;
-		int coords;
-		int background;
-		int rescore;
-		int objectness;
-		int does_cost;
-		int joint;
-		int noadjust;
-		int reorg;
-		int log;
-		int tanh;
-		int *mask;
-		int total;
-		float bflops;
+	/// Get the name of the algorithm, such as @p "winograd".  These names are used in the autotuning cache.
+	std::string to_string(const EConvAlgorithm & algorithm);
 
-		int adam;
+
+	struct Layer;
+
+	/** Everything a layer needs for training, such as the deltas, the weight updates, and the Adam state.  This is only
+	 * allocated when the network is being trained.  @see @ref Layer::training
+	 *
+	 * @since 2026-10-17
+	 */
+	struct LayerTraining final
+	{
+		float learning_rate_scale;
 		float B1;
 		float B2;
 		float eps;
-
 		int t;
-
-		float alpha;
-		float beta;
-		float kappa;
-
-		float coord_scale;
-		float object_scale;
-		float noobject_scale;
-		float mask_scale;
-		float class_scale;
-		int bias_match;
-		float random;
-		float ignore_thresh;
-		float truth_thresh;
-		float iou_thresh;
-		float thresh;
-		float focus;
-		int classfix;
-		int absolute;
-		int assisted_excitation;
-
 		int onlyforward;
 		int stopbackward;
 		int train_only_bn;
 		int dont_update;
 		int burnin_update;
-		int dontload;
-		int dontsave;
-		int dontloadscales;
-		int numload;
-
-		float temperature;
-		float probability;
-		float dropblock_size_rel;
-		int dropblock_size_abs;
-		int dropblock;
-		float scale;
-
-		int receptive_w;
-		int receptive_h;
-		int receptive_w_scale;
-		int receptive_h_scale;
-
-		char  * cweights;
-		int   * indexes;
-		int   * input_layers;
-		int   * input_sizes;
-		float **layers_output;
 		float **layers_delta;
-		EWeightsType weights_type; // WEIGHTS_TYPE_T
-		EWeightsNormalization weights_normalization; // WEIGHTS_NORMALIZATION_T
-		int   * map;
-		int   * counts;
-		float ** sums;
-		float * rand;
 		float * cost;
-		int *labels;
-		int *class_ids;
-		int contrastive_neg_max;
-		float *cos_sim;
-		float *exp_cos_sim;
-		float *p_constrastive;
-		ContrastiveParams *contrast_p_gpu;
-		float * state;
-		float * prev_state;
-		float * forgot_state;
-		float * forgot_delta;
-		float * state_delta;
-		float * combine_cpu;
-		float * combine_delta_cpu;
-
-		float *concat;
-		float *concat_delta;
-
-		float *binary_weights;
-
-		float *biases;
 		float *bias_updates;
-
-		float *scales;
 		float *scale_updates;
-
 		float *weights_ema;
 		float *biases_ema;
 		float *scales_ema;
-
-		float *weights;
 		float *weight_updates;
-
-		float scale_x_y;
-		int objectness_smooth;
-		int new_coords;
-		int show_details;
-		float max_delta;
-		float uc_normalizer;
-		float iou_normalizer;
-		float obj_normalizer;
-		float cls_normalizer;
-		float delta_normalizer;
-		EIOULoss iou_loss;
-		EIOULoss iou_thresh_kind;
-		ENMSKind nms_kind;
-		float beta_nms;
-		EYOLOPoint yolo_point;
-
-		char *align_bit_weights_gpu;
-		float *mean_arr_gpu;
-		float *align_workspace_gpu;
-		float *transposed_align_workspace_gpu;
-		int align_workspace_size;
-
-		char *align_bit_weights;
-		float *mean_arr;
-		int align_bit_weights_size;
-		int lda_align;
-		int new_lda;
-		int bit_align;
-
-		float *col_image;
 		float * delta;
-		float * output;
-		float * activation_input;
-		int delta_pinned;
-		int output_pinned;
 		float * loss;
-		float * squared;
-		float * norms;
-
-		float * spatial_mean;
 		float * mean;
 		float * variance;
-
 		float * mean_delta;
 		float * variance_delta;
-
-		float * rolling_mean;
-		float * rolling_variance;
-
 		float * x;
 		float * x_norm;
-
 		float * m;
 		float * v;
-
 		float * bias_m;
 		float * bias_v;
 		float * scale_m;
 		float * scale_v;
+	};
 
+	/** State used only by recurrent layers such as RNN, GRU, LSTM, and conv-LSTM, including their sub-layers.
+	 * @see @ref Layer::recurrent
+	 *
+	 * @since 2026-10-17
+	 */
+	struct LayerRecurrent final
+	{
+		EActivation		lstm_activation;
+		int peephole;
+		int history_size;
+		int bottleneck;
+		float time_normalizer;
+		int state_constrain;
+		int hidden;
+		float * state;
+		float * prev_state;
+		float * forgot_state;
+		float * forgot_delta;
+		float * state_delta;
+		float * combine_cpu;
+		float * combine_delta_cpu;
+		float *concat;
+		float *concat_delta;
 		float *z_cpu;
 		float *r_cpu;
 		float *h_cpu;
 		float *stored_h_cpu;
 		float * prev_state_cpu;
-
 		float *temp_cpu;
 		float *temp2_cpu;
 		float *temp3_cpu;
-
 		float *dh_cpu;
 		float *hh_cpu;
 		float *prev_cell_cpu;
@@ -374,35 +181,23 @@ namespace Darknet_ng
 		float *c_cpu;
 		float *stored_c_cpu;
 		float *dc_cpu;
-
-		float *binary_input;
-		uint32_t *bin_re_packed_input;
-		char *t_bit_input;
-
-		Layer *input_layer;
 		Layer *self_layer;
 		Layer *output_layer;
-
 		Layer *reset_layer;
 		Layer *update_layer;
 		Layer *state_layer;
-
 		Layer *input_gate_layer;
 		Layer *state_gate_layer;
 		Layer *input_save_layer;
 		Layer *state_save_layer;
 		Layer *input_state_layer;
 		Layer *state_state_layer;
-
 		Layer *input_z_layer;
 		Layer *state_z_layer;
-
 		Layer *input_r_layer;
 		Layer *state_r_layer;
-
 		Layer *input_h_layer;
 		Layer *state_h_layer;
-
 		Layer *wz;
 		Layer *uz;
 		Layer *wr;
@@ -420,17 +215,27 @@ namespace Darknet_ng
 		Layer *vi;
 		Layer *ug;
 		Layer *wg;
+	};
 
-		Tree *softmax_tree;
-
-		size_t workspace_size;
-
-		//#ifdef GPU
+	/** GPU buffers and cuDNN descriptors.  This is only allocated when a GPU is used.  @see @ref Layer::gpu
+	 *
+	 * @since 2026-10-17
+	 */
+	struct LayerGPU final
+	{
+		void(*forward_gpu)   (struct layer, struct network_state);
+		void(*backward_gpu)  (struct layer, struct network_state);
+		void(*update_gpu)    (struct layer, int, float, float, float, float);
+		int keep_delta_gpu;
+		ContrastiveParams *contrast_p_gpu;
+		char *align_bit_weights_gpu;
+		float *mean_arr_gpu;
+		float *align_workspace_gpu;
+		float *transposed_align_workspace_gpu;
+		int delta_pinned;
+		int output_pinned;
 		int *indexes_gpu;
 
-		int stream;
-		int wait_stream_id;
-
 		float *z_gpu;
 		float *r_gpu;
 		float *h_gpu;
@@ -561,12 +366,281 @@ namespace Darknet_ng
 		UNUSED_ENUM_TYPE bf_algo, bf_algo16;
 		void* poolingDesc;
 		#endif  // CUDNN
-		//#endif  // GPU
+	};
+
+	/** A single layer in the neural network.  The fields are ordered so everything needed to run inference is at the
+	 * start of the structure, followed by the parameters specific to some layer types.  Training, recurrent, and GPU state
+	 * is kept in side objects which are only allocated when needed, so inference does not drag any of it through the cache.
+	 * Copies of a layer share the same buffers and side objects.  @see @ref InferenceContext
+	 */
+	struct Layer /// was: layer
+	{
+		// ---- hot:  everything needed to run inference ----
+		ELayerType		type;
+		EActivation		activation;
+		ActivationKernel activation_kernel;	///< adds the bias and applies @ref activation, set when the layer is made, or @p nullptr if the activation is not elementwise
+		int train;
+		int index;
+
+		int batch;
+		int steps;
+		int h;
+		int w;
+		int c;
+		int out_h;
+		int out_w;
+		int out_c;
+		int inputs;
+		int outputs;
+
+		int n;
+		int groups;
+		int group_id;
+		int size;
+		int stride;
+		int stride_x;
+		int stride_y;
+		int dilation;
+		int pad;
+		int nweights;
+
+		int batch_normalize;
+		int binary;
+		int xnor; // boolean flag?
+		int use_bin_output;
+		int antialiasing;
+		int assisted_excitation;
+		bool fused;		///< batchnorm folded into the weights, and bias + activation applied by the GEMM epilogue @see @ref Network::fuse_layers()
+		EConvAlgorithm	conv_algorithm;	///< @see @ref choose_convolutional_algorithm()
+		int parallel_items;	///< batch and group items computed at the same time, each on a single thread @see @ref choose_convolutional_parallel_items()
+		bool weights_packed;	///< @ref packed_weights matches @ref weights, and must be reset if the weights change @see @ref pack_convolutional_weights()
+		bool blocked;	///< the output uses the NCHWc layout instead of NCHW @see @ref Network::use_blocked_layout()
+		size_t workspace_size;
+
+		float *weights;
+		float *biases;
+		float *scales;
+		float * rolling_mean;
+		float * rolling_variance;
+		float * output;
+		float * activation_input;
+		float * packed_weights;	///< copy of the weights in the layout used by @ref gemm_prepacked(), only allocated for inference
+		float * winograd_weights;	///< weights transformed by @ref winograd_transform_filters(), allocated instead of @ref packed_weights for Winograd layers
+		float * blocked_weights;	///< weights reordered for the NCHWc layout, which re-uses @ref packed_weights or @ref winograd_weights @see @ref Network::use_blocked_layout()
+
+		int   * input_layers;
+		Layer *share_layer;
+		Layer *input_layer;
+
+		// ---- optional side objects ----
+		std::shared_ptr<LayerTraining>	training;	///< only allocated when training
+		std::shared_ptr<LayerRecurrent>	recurrent;	///< only allocated for recurrent layers
+		std::shared_ptr<LayerGPU>		gpu;		///< only allocated when using a GPU
+
+		// ---- cold:  parameters used by specific layer types ----
+		ECostType		cost_type;
+
+		int avgpool;
+		int shortcut;
+		int dynamic_minibatch;
+		int forced;
+		int flipped;
+		float mean_alpha;
+		int nbiases;
+		int extra;
+		int truths;
+		int max_boxes;
+		int truth_size;
+		int side;
+		int maxpool_depth;
+		int maxpool_zero_nonmax;
+		int out_channels;
+		float reverse;
+		int coordconv;
+		int flatten;
+		int spatial;
+		int sqrt;
+		int flip;
+		int scale_wh;
+		int optimized_memory;
+		int truth;
+		float smooth;
+		float dot;
+		int deform;
+		int grad_centr;
+		int sway;
+		int rotate;
+		int stretch;
+		int stretch_sway;
+		float angle;
+		float jitter;
+		float resize;
+		float saturation;
+		float exposure;
+		float shift;
+		float ratio;
+		float clip;
+		int focal_loss;
+		float *classes_multipliers;
+		float label_smooth_eps;
+		int noloss;
+		int softmax;
+		int classes;
+		int detection;
+		int embedding_layer_id;
+		float *embedding_output;
+		int embedding_size;
+		float sim_thresh;
+		int track_history_size;
+		int dets_for_track;
+		int dets_for_show;
+		float track_ciou_norm;
+		int coords;
+		int background;
+		int rescore;
+		int objectness;
+		int does_cost;
+		int joint;
+		int noadjust;
+		int reorg;
+		int log;
+		int tanh;
+		int *mask;
+		int total;
+		float bflops;
+
+		int adam;
+
+		float alpha;
+		float beta;
+		float kappa;
+
+		float coord_scale;
+		float object_scale;
+		float noobject_scale;
+		float mask_scale;
+		float class_scale;
+		int bias_match;
+		float random;
+		float ignore_thresh;
+		float truth_thresh;
+		float iou_thresh;
+		float thresh;
+		float focus;
+		int classfix;
+		int absolute;
+
+		int dontload;
+		int dontsave;
+		int dontloadscales;
+		int numload;
+
+		float temperature;
+		float probability;
+		float dropblock_size_rel;
+		int dropblock_size_abs;
+		int dropblock;
+		float scale;
+
+		int receptive_w;
+		int receptive_h;
+		int receptive_w_scale;
+		int receptive_h_scale;
+
+		char  * cweights;
+		int   * indexes;
+		int   * input_sizes;
+		float **layers_output;
+		EWeightsType weights_type; // WEIGHTS_TYPE_T
+		EWeightsNormalization weights_normalization; // WEIGHTS_NORMALIZATION_T
+		int   * map;
+		int   * counts;
+		float ** sums;
+		float * rand;
+		int *labels;
+		int *class_ids;
+		int contrastive_neg_max;
+		float *cos_sim;
+		float *exp_cos_sim;
+		float *p_constrastive;
+
+		float *binary_weights;
+
+		float scale_x_y;
+		int objectness_smooth;
+		int new_coords;
+		int show_details;
+		float max_delta;
+		float uc_normalizer;
+		float iou_normalizer;
+		float obj_normalizer;
+		float cls_normalizer;
+		float delta_normalizer;
+		EIOULoss iou_loss;
+		EIOULoss iou_thresh_kind;
+		ENMSKind nms_kind;
+		float beta_nms;
+		EYOLOPoint yolo_point;
+
+		int align_workspace_size;
+
+		char *align_bit_weights;
+		float *mean_arr;
+		int align_bit_weights_size;
+		int lda_align;
+		int new_lda;
+		int bit_align;
+
+		float *col_image;
+		float * squared;
+		float * norms;
+
+		float * spatial_mean;
+
+		float *binary_input;
+		uint32_t *bin_re_packed_input;
+		char *t_bit_input;
+
+		Tree *softmax_tree;
+		int stream;
+		int wait_stream_id;
 	};
 	using Layers = std::vector<Layer>;
 
-	Layer make_convolutional_layer(Layer & layer, int batch, int steps, int h, int w, int c, int n, int groups, int size, int stride_x, int stride_y, int dilation, int padding, EActivation activation, int batch_normalize, int binary, int xnor, int adam, int use_bin_output, int index, int antialiasing, Layer *share_layer, int assisted_excitation, int deform, int train);
+	/** Set the shape and the parameters of a convolutional layer.  This does not allocate any buffers.  Those are carved
+	 * out of the network arena by @ref carve_convolutional_layer() and initialized by @ref init_convolutional_layer().
+	 */
+	Layer & make_convolutional_layer(Layer & layer, int batch, int steps, int h, int w, int c, int n, int groups, int size, int stride_x, int stride_y, int dilation, int padding, EActivation activation, int batch_normalize, int binary, int xnor, int adam, int use_bin_output, int index, int antialiasing, Layer *share_layer, int assisted_excitation, int deform, int train);
+
+	/// Carve all of the buffers needed by a convolutional layer out of the arena.  @see @ref Arena
+	void carve_convolutional_layer(Arena & arena, Layer & layer);
+
+	/** Carve the buffers other than the output which a convolutional layer writes to during inference.  Only the XNOR
+	 * layers have any.  This is called by @ref carve_convolutional_layer(), and by @ref InferenceContext so each context
+	 * has buffers of its own.
+	 */
+	void carve_convolutional_scratch(Arena & arena, Layer & layer);
+
+	/** Set the initial weights and scales, and point shared layers at the buffers they share.  Must be called after the
+	 * arena has been committed, and after the shared layer has been initialized.
+	 */
+	void init_convolutional_layer(Layer & layer);
 
 	size_t get_workspace_size32(const Darknet_ng::Layer & layer);
 	size_t get_workspace_size16(const Darknet_ng::Layer & layer);
+
+	/** Every CPU forward kernel has this signature.  Both the layer and the network state are passed by reference, so
+	 * unlike the original @p l.forward(l, state) nothing is copied when a layer runs.
+	 *
+	 * @see @ref get_forward_kernel()
+	 * @see @ref Network::forward()
+	 *
+	 * @since 2026-10-17
+	 */
+	using LayerKernel = void(*)(Layer & layer, NetworkState & state);
+
+	/** Get the forward kernel for the given type of layer.  This replaces the @p forward function pointer which used to
+	 * be stored in every layer.  Throws if that type of layer has not yet been ported.
+	 */
+	LayerKernel get_forward_kernel(const ELayerType layer_type);
 }
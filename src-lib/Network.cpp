@@ -8,6 +8,8 @@
 
 Darknet_ng::Network::~Network()
 {
+	clear();
+
 	return;
 }
 
@@ -40,7 +42,27 @@ Darknet_ng::Network & Darknet_ng::Network::clear()
 	steps		.clear();
 	scales		.clear();
 	seq_scales	.clear();
+
+	// the few things which are not in the arena are the small tables which are allocated as each layer is parsed
+	for (auto & layer : layers)
+	{
+		free(layer.input_layers);
+		free(layer.mask);
+		delete layer.input_layer;
+	}
 	layers		.clear();
+	arena		.clear();
+	winograd_arena.clear();
+
+	activation_plan = {};
+
+	workspace_size = 0;
+	workspace = nullptr;
+	workspace_arena.clear();
+
+	fused_passes_saved = 0;
+	conversion_offset = 0;
+	channel_block = 0;
 
 	return *this;
 }
@@ -61,6 +83,11 @@ bool Darknet_ng::Network::empty() const
 
 Darknet_ng::Network & Darknet_ng::Network::load(const std::filesystem::path & cfg_filename)
 {
+	if (is_plan_file(cfg_filename))
+	{
+		return load_plan(cfg_filename);
+	}
+
 	clear();
 
 	Config cfg(cfg_filename);
@@ -116,39 +143,38 @@ Darknet_ng::Network & Darknet_ng::Network::parse_layers(const Config & cfg)
 	// allocate the network layers -- the first section [net] is ignored, so we need 1 less than what is in the .cfg file
 	layers.resize(cfg.sections.size() - 1);
 
-	size_t layer_index = 0;
+	size_t section_index = 0;
 	for (const auto & section : cfg.sections)
 	{
 		const ELayerType layer_type = layer_type_from_string(section.name);
 
-		if (layer_index == 0 and layer_type != ELayerType::kNetwork)
+		if (section_index == 0 and layer_type != ELayerType::kNetwork)
 		{
 			// something is wrong -- the first section should be [net] or [network]
 
 			/// @throw Exception The first layer should be [net] or [network].
 			throw Exception("first section should be [net] or [network] but found [" + section.name + "] at line #" + std::to_string(section.line_number), DNG_LOC);
 		}
-		else if (layer_index > 0 and layer_type == ELayerType::kNetwork)
+		else if (section_index > 0 and layer_type == ELayerType::kNetwork)
 		{
 			// the [net] or [network] should only appear once and be the first section we process
 
 			/// @throw Exception The [net] or [network] layer should only appear once.
-			throw Exception("unexpected [net] or [network] at index #" + std::to_string(layer_index + 1) + " at line #" + std::to_string(section.line_number), DNG_LOC);
+			throw Exception("unexpected [net] or [network] at index #" + std::to_string(section_index + 1) + " at line #" + std::to_string(section.line_number), DNG_LOC);
 		}
 
+		// [net] does not have a layer, so the layer index is always 1 less than the section index
+		const size_t layer_index = section_index - 1;
+
 		switch (layer_type)
 		{
 			case ELayerType::kNetwork:			parse_net			(section);				break;
 			case ELayerType::kConvolutional:	parse_convolutional	(section, layer_index);	break;
-			case ELayerType::kRoute:
-			case ELayerType::kMaxPool:
-			case ELayerType::kYOLO:
-			case ELayerType::kUpsample:
-			{
-				/// @todo need to handle parsing of layer types ELayerType::kRoute, ELayerType::kMaxPool, ELayerType::kYOLO, and ELayerType::kUpsample
-				std::cout << "placeholder to parse section \"" << section.name << "\" at line #" << section.line_number << std::endl;
-				break;
-			}
+			case ELayerType::kRoute:			parse_route			(section, layer_index);	break;
+			case ELayerType::kMaxPool:			parse_maxpool		(section, layer_index);	break;
+			case ELayerType::kYOLO:				parse_yolo			(section, layer_index);	break;
+			case ELayerType::kUpsample:			parse_upsample		(section, layer_index);	break;
+			case ELayerType::kShortcut:			parse_shortcut		(section, layer_index);	break;
 			/// @todo Handle all of the other layer types and get rid of the @p default case
 			default:
 			{
@@ -157,13 +183,167 @@ Darknet_ng::Network & Darknet_ng::Network::parse_layers(const Config & cfg)
 			}
 		}
 
-		// we've processed a new layer, move to the next index
-		layer_index ++;
+		// we've processed a new section, move to the next index
+		section_index ++;
 	}
 
+	allocate_layers();
+
 	return *this;
 }
 
+
+Darknet_ng::Network & Darknet_ng::Network::allocate_layers()
+{
+	arena.clear();
+	winograd_arena.clear();
+
+	if (not settings.train)
+	{
+		plan_activations();
+	}
+
+	// all the layers run one at a time, so they can all share the same workspace
+	workspace_size = 0;
+	for (const auto & layer : layers)
+	{
+		workspace_size = std::max(workspace_size, layer.workspace_size);
+		if (layer.input_layer)
+		{
+			workspace_size = std::max(workspace_size, layer.input_layer->workspace_size);
+		}
+	}
+	allocate_workspace();
+
+	// the 1st pass finds the size of the arena, and the 2nd pass carves out the buffers
+	for (int pass = 0; pass < 2; pass ++)
+	{
+		for (auto & layer : layers)
+		{
+			if (layer.type == ELayerType::kConvolutional)
+			{
+				carve_convolutional_layer(arena, layer);
+			}
+			else if (settings.train and layer.type == ELayerType::kShortcut and (layer.activation == EActivation::kSWISH or layer.activation == EActivation::kMISH))
+			{
+				// only the backward pass needs the values before the activation
+				layer.activation_input = arena.carve<float>(layer.batch * layer.outputs);
+			}
+		}
+
+		if (settings.train)
+		{
+			// training needs every output to remain valid for the backward pass
+			for (auto & layer : layers)
+			{
+				layer.output = arena.carve<float>(layer.batch * layer.outputs);
+			}
+		}
+		else
+		{
+			// inference only needs each output until the last layer which reads it, so outputs can share slabs
+			std::vector<float *> slabs;
+			for (const size_t size : activation_plan.slab_size)
+			{
+				slabs.push_back(arena.carve<float>(size));
+			}
+
+			for (size_t idx = 0; idx < layers.size(); idx ++)
+			{
+				const int slab = activation_plan.slab[idx];
+				layers[idx].output = (slab < 0 ? nullptr : slabs[slab]);
+			}
+		}
+
+		if (pass == 0)
+		{
+			arena.commit();
+		}
+	}
+
+	// now that the memory exists we can set the initial values (layers can only share with previous layers)
+	for (auto & layer : layers)
+	{
+		if (layer.type == ELayerType::kConvolutional)
+		{
+			init_convolutional_layer(layer);
+		}
+	}
+
+	if (not settings.train)
+	{
+		fprintf(stderr, "Activations use %d slabs = %1.2f MB (%1.2f MB without sharing)\n",
+				static_cast<int>(activation_plan.slab_size.size()),
+				activation_plan.planned_size	* sizeof(float) / 1000000.0f,
+				activation_plan.naive_size		* sizeof(float) / 1000000.0f);
+	}
+	fprintf(stderr, "Allocated network arena = %1.2f MB\n", arena.size() / 1000000.0f);
+
+	return *this;
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::allocate_workspace()
+{
+	// the contents don't need to be preserved since the workspace is only scratch memory used while a layer is running
+	workspace_arena.clear();
+
+	for (int pass = 0; pass < 2; pass ++)
+	{
+		workspace = static_cast<float*>(workspace_arena.carve_bytes(workspace_size));
+
+		if (pass == 0)
+		{
+			workspace_arena.commit();
+		}
+	}
+
+	return *this;
+}
+
+
+void Darknet_ng::Network::get_input_dimensions(const size_t layer_index, int & h, int & w, int & c) const
+{
+	if (layer_index == 0)
+	{
+		// the very first layer gets the network input
+		h = settings.h;
+		w = settings.w;
+		c = settings.c;
+	}
+	else
+	{
+		const Layer & previous_layer = layers.at(layer_index - 1);
+		h = previous_layer.out_h;
+		w = previous_layer.out_w;
+		c = previous_layer.out_c;
+	}
+
+	if (h < 1 or w < 1 or c < 1)
+	{
+		/// @throw Exception The previous layer does not output an image.
+		throw Exception("layer #" + std::to_string(layer_index) + " does not have a valid input (" + std::to_string(w) + " x " + std::to_string(h) + " x " + std::to_string(c) + ")", DNG_LOC);
+	}
+
+	return;
+}
+
+
+int Darknet_ng::Network::get_layer_index(const Section & section, const size_t layer_index, const int index) const
+{
+	// negative indexes such as "layers=-1,-4" are relative to the current layer
+	const int absolute_index = (index < 0 ? static_cast<int>(layer_index) + index : index);
+
+	if (absolute_index < 0 or absolute_index >= static_cast<int>(layer_index))
+	{
+		/// @throw Exception The layer index must refer to one of the previous layers.
+		throw Exception("[" + section.name + "] at line #" + std::to_string(section.line_number) + " references an invalid layer index " + std::to_string(index), DNG_LOC);
+	}
+
+	return absolute_index;
+}
+
+
 #if 0
 Darknet_ng::Network *Darknet_ng::load_network_custom(char *cfg, char *weights, int clear, int batch)
 {
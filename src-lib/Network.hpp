@@ -36,20 +36,154 @@ namespace Darknet_ng
 
 			/** Load the given network.  This is automatically called by the constructor when a filename has been provided,
 			 * or it can be manually called with a specific filename to trigger the network to load.
+			 *
+			 * The filename can either be a @p .cfg file, or a plan previously created with @ref save_plan().  Plans are
+			 * detected automatically and passed to @ref load_plan().
+			 *
+			 * The layers are left exactly as described by the configuration.  To run inference, load the weights and then
+			 * call @ref fuse_layers().
 			 */
 			Network & load(const std::filesystem::path & cfg_filename);
 
+			/** Save the current network as a compiled "model plan".  This contains the resolved settings, the shape of
+			 * every layer, and the workspace sizes.  Plans can be loaded much faster than @p .cfg files since there is
+			 * nothing to parse.
+			 * @see @ref PlanHeader
+			 */
+			const Network & save_plan(const std::filesystem::path & plan_filename) const;
+
+			/** Load a plan that was previously created with @ref save_plan().  The file is memory-mapped, and none of the
+			 * text parsing from @ref Config is used.  This is automatically called by @ref load() when needed.
+			 */
+			Network & load_plan(const std::filesystem::path & plan_filename);
+
 			/// @todo
 			Network & make_network(const Config & cfg);
 
 			/// @todo
 			Network & parse_layers(const Config & cfg);
 
+			/** Carve all of the layer buffers out of a single @ref arena and set their initial values.  This is called
+			 * once all of the layers have been created by @ref parse_layers() or @ref load_plan(), since that is the
+			 * only time the total size is known.
+			 */
+			Network & allocate_layers();
+
+			/** Decide which layer outputs can share memory during inference.  The results are stored in
+			 * @ref activation_plan and used by @ref allocate_layers() when the network is not being trained.
+			 */
+			Network & plan_activations();
+
+			/** Graph optimization pass run once the weights have been loaded for inference.  Batch normalization is folded
+			 * into the weights and biases of each convolutional layer, and the layer is marked as @p fused so the bias
+			 * and activation are applied to each block of the GEMM output while it is still in cache, instead of making
+			 * separate passes over the entire output.  The number of passes saved is stored in @ref fused_passes_saved.
+			 *
+			 * This modifies the weights, so it must be called after the weights have been loaded, and the network can
+			 * no longer be trained.  It is never called automatically by @ref load().  The weights are also packed for
+			 * the GEMM and Winograd kernels, and Winograd layers whose results are too far from the direct convolution
+			 * fall back to @ref EConvAlgorithm::kImplicitGEMM.  Layers which are already fused are skipped, so the
+			 * weights cannot be changed once this has been called.
+			 */
+			Network & fuse_layers();
+
+			/** Graph optimization pass which switches the layers to the blocked NCHWc layout, where the channels are
+			 * stored in blocks of @ref get_channel_block() channels for every pixel.  This lets the convolutional,
+			 * maxpool, and upsample kernels work on an entire block of channels at once with SIMD instructions.  Layers
+			 * which cannot use this layout -- such as YOLO layers, or layers where the number of channels is not a
+			 * multiple of the block -- are left as NCHW, and @ref forward() converts the data wherever the layout
+			 * changes.  Route and shortcut layers must use the same layout as all of their inputs.
+			 *
+			 * This must be called after @ref fuse_layers(), since only fused convolutional layers can be blocked.  The
+			 * outputs of blocked layers are no longer NCHW, see @ref Layer::blocked.  Call with @p false to go back to
+			 * plain NCHW.
+			 */
+			Network & use_blocked_layout(const bool enable = true);
+
+			/** Time every algorithm which can compute each convolutional layer and keep the fastest one, similar to the
+			 * algorithm search done by cuDNN.  The heuristics in @ref choose_convolutional_algorithm() are a good guess,
+			 * but the fastest algorithm depends on the CPU, the number of threads, and the exact shape of the layer.
+			 * Layers using the XNOR or blocked kernels are left alone.  Every 3x3 layer with a stride of 1 is also timed
+			 * with Winograd, and is given its own transformed filters if Winograd wins.
+			 *
+			 * The layers are timed with @p batch images, which should be the batch later given to @ref predict().  The
+			 * buffers remain sized for the batch in the configuration.
+			 *
+			 * The winners are stored in @p cache_filename, keyed by the CPU model, the number of threads, and the shape
+			 * of the layer including the batch, so the next time a network with the same layers is loaded on this
+			 * computer the choices are read from the cache instead of being timed again.  Pass an empty path to always
+			 * time the layers without a cache.
+			 *
+			 * This must be called after @ref fuse_layers(), since the transformed Winograd filters are only used by the
+			 * fused layers, and layers whose weights are too large for Winograd are only known once the weights are fused.
+			 */
+			Network & autotune(const std::filesystem::path & cache_filename, const size_t batch = 1);
+
+			/// Get the index of every layer whose output is read by the given layer.
+			VI get_layer_inputs(const size_t layer_index) const;
+
+			/** Re-create the @ref workspace using the current @ref workspace_size.  This is called whenever the size of
+			 * the workspace changes, such as when the layers are allocated or when the algorithm of a layer changes.
+			 */
+			Network & allocate_workspace();
+
+			/** Get the workspace shared by all of the layers.  The workspace is scratch memory used by layers such as
+			 * convolutional layers for im2col.  @see @ref allocate_workspace()
+			 */
+			float * get_workspace() const { return workspace; }
+
+			/** Run the network forward on @p state.input, one layer at a time.  Each layer is dispatched through
+			 * @ref get_forward_kernel() and reads the output of the previous layer.  If @p state.workspace has not been set,
+			 * the network @ref workspace is used.  This replaces @p forward_network() from the original code.
+			 */
+			Network & forward(NetworkState & state);
+
+			/** Same as @ref forward(), but runs @p run_layers instead of @ref layers.  These are copies of the layers of
+			 * this network which have buffers of their own, such as the layers of an @ref InferenceContext.
+			 */
+			const Network & forward(Layers & run_layers, NetworkState & state) const;
+
+			/** Run inference on @p batch images stored one after the other in @p input.  Each image must be
+			 * @p settings.w * @p settings.h * @p settings.c floats, and @p batch cannot be larger than the @p [net]
+			 * batch the network was loaded with.  The layers are run one at a time, each of them using OpenMP to split
+			 * the work across threads.
+			 *
+			 * The buffers are allocated once when the network is loaded and are re-used by every call.  The pointer
+			 * returned is the output of the last layer, and remains valid until the next call to @ref predict() or
+			 * @ref forward().  It contains @p batch * @p layers.back().outputs floats.  The input and the output are
+			 * always NCHW, even when @ref use_blocked_layout() has been called.
+			 *
+			 * @warning Only one inference can run at a time on the layers of a given network.  The layer outputs and the
+			 * workspace are shared by every call, and the batch of each layer is changed to match @p batch.  To run
+			 * inference from several threads at once, give each thread its own @ref InferenceContext.
+			 */
+			const float * predict(const float * input, const size_t batch = 1);
+
+			/** Same as @ref predict(), but runs @p run_layers with @p run_workspace instead of the layers and the
+			 * workspace of this network.  @see @ref InferenceContext::predict()
+			 */
+			const float * predict(Layers & run_layers, float * run_workspace, const float * input, const size_t batch) const;
+
 			/// @{ Parse the given section from the configuration.  This is automatically called by @ref load().
 			Network & parse_net				(const Section & section);
 			Network & parse_convolutional	(const Section & section, const size_t layer_index);
+			Network & parse_maxpool			(const Section & section, const size_t layer_index);
+			Network & parse_route			(const Section & section, const size_t layer_index);
+			Network & parse_shortcut		(const Section & section, const size_t layer_index);
+			Network & parse_upsample		(const Section & section, const size_t layer_index);
+			Network & parse_yolo			(const Section & section, const size_t layer_index);
 			/// @}
 
+			/** Get the dimensions of the input to the given layer.  This is the output of the previous layer, or the
+			 * network input for the very first layer.  Throws if the previous layer does not output an image.
+			 */
+			void get_input_dimensions(const size_t layer_index, int & h, int & w, int & c) const;
+
+			/** Convert an index such as @p "layers=-1,-4" or @p "from=-3" to an absolute layer index.  Negative values
+			 * are relative to @p layer_index.  Throws if the result does not refer to one of the previous layers.
+			 */
+			int get_layer_index(const Section & section, const size_t layer_index, const int index) const;
+
 			/** All of the fields in this structure must be POD ("plain old data") since they're reset in bulk via the use of
 			 * @p std::memset() in @ref Network::clear().  Anything more complex than POD such as vectors and maps are defined
 			 * outside of this structure and need to be manually handled in @ref Network::clear().
@@ -155,6 +289,48 @@ namespace Darknet_ng
 			/// Network layers.  @see @ref load()
 			Layers layers;
 
+			/// All of the buffers used by the @ref layers.  @see @ref allocate_layers()
+			Arena arena;
+
+			/** The layer outputs which can share memory during inference.  All sizes are in number of @p float.
+			 * @see @ref plan_activations()
+			 *
+			 * @since 2026-10-17
+			 */
+			struct ActivationPlan final
+			{
+				VI last_use;					///< index of the last layer to read each output, or the number of layers for network outputs
+				VI slab;						///< the slab used by each layer, or @p -1 if the layer has no output
+				std::vector<size_t> slab_size;	///< size of each slab
+				size_t naive_size;				///< total size if every layer had its own output buffer
+				size_t planned_size;			///< total size of all the slabs
+			};
+			/// @see @ref plan_activations()
+			ActivationPlan activation_plan;
+
+			/// The size in bytes of the largest workspace needed by any layer.  @see @ref allocate_layers()
+			size_t workspace_size;
+
+			/** Transformed Winograd filters for the layers which did not get them from @ref allocate_layers() since their
+			 * shape did not pick Winograd, but which @ref autotune() found to be faster with Winograd.
+			 */
+			Arena winograd_arena;
+
+			/// Memory for the @ref workspace.  This is kept apart from @ref arena so it can be resized.
+			Arena workspace_arena;
+
+			/// The workspace shared by all of the layers, aligned to @ref kArenaAlignment.  @see @ref get_workspace()
+			float * workspace;
+
+			/// The number of passes over the layer outputs saved by each inference.  @see @ref fuse_layers()
+			size_t fused_passes_saved;
+
+			/// Offset in bytes within the workspace of the buffer used to convert between NCHW and NCHWc.  @see @ref use_blocked_layout()
+			size_t conversion_offset;
+
+			/// Channels per block when using the NCHWc layout, or zero for NCHW.  @see @ref use_blocked_layout()
+			int channel_block;
+
 
 #ifdef WORK_IN_PROGRESS /// @todo
 			int n;	// the number of layers in the network (sections - 1, since [net] doesn't count)
@@ -223,16 +399,95 @@ namespace Darknet_ng
 	int convolutional_out_width(const Layer & layer);
 	int convolutional_out_height(const Layer & layer);
 	size_t get_convolutional_workspace_size(const Layer & layer);
-	void forward_convolutional_layer(Layer & layer, NetworkState & state);
+
+	/** The number of threads @ref winograd_conv() may use for a single item of a Winograd layer.  This is 1 when the items
+	 * run side-by-side, otherwise it is the number of threads the workspace of the layer was sized for, but never more
+	 * than @p omp_get_max_threads().  @see @ref get_convolutional_workspace_size()
+	 */
+	int get_convolutional_winograd_threads(const Layer & layer);
+
+	/** Decide how the given convolutional layer should be computed based on its shape.  Layers which need the im2col
+	 * matrix -- training, binary, and XNOR layers -- use @ref EConvAlgorithm::kIm2col, as do 1x1 layers with a stride
+	 * of 1 since their input can be used as-is.  Depthwise layers and layers with very small groups use
+	 * @ref EConvAlgorithm::kGrouped.  3x3 layers with a stride of 1 and enough channels and output tiles use
+	 * @ref EConvAlgorithm::kWinograd, which needs a workspace for the transformed tiles.  All other layers use
+	 * @ref EConvAlgorithm::kImplicitGEMM so the workspace is not needed.
+	 */
+	EConvAlgorithm choose_convolutional_algorithm(const Layer & layer);
+
+	/** Use the given algorithm for a convolutional layer, and size the workspace of the layer to match.  The workspace of
+	 * the network must be resized afterwards if it has grown.  @see @ref Network::autotune()
+	 */
+	void set_convolutional_algorithm(Layer & layer, const EConvAlgorithm algorithm);
+
+	/** Decide how many of the batch and group items of a convolutional layer are computed at the same time.  When this
+	 * is 1, the items are done one after the other and each GEMM uses all the OpenMP threads.  Otherwise the items are
+	 * spread across the threads, each item runs on a single thread, and each thread uses its own slice of the workspace.
+	 * That is faster when the GEMM of a single item is too small to keep all the threads busy, such as in the last
+	 * layers of a network at a batch size larger than 1.  Must be called after @ref choose_convolutional_algorithm().
+	 */
+	int choose_convolutional_parallel_items(const Layer & layer);
+
+	/// Describe the input image of a convolutional layer for @ref gemm_conv().  @p im is the start of a single group.
+	GemmConvInput get_convolutional_gemm_input(const Layer & layer, const float * im);
+
+	/// Largest relative error allowed before a layer stops using Winograd.  @see @ref get_winograd_error()
+	constexpr float kWinogradTolerance = 1.0e-3f;
+
+	/** Compare the Winograd results of a convolutional layer against the implicit GEMM on a small test image, and return
+	 * the largest difference relative to the largest output.  @see @ref Network::fuse_layers()
+	 */
+	float get_winograd_error(const Layer & layer);
+
+	/// The number of channels per block used by the NCHWc layout on this CPU, 8 or 16.  @see @ref Network::use_blocked_layout()
+	int get_channel_block();
+
+	/// The name of the kernels used by the blocked convolutions, such as @p "avx512 NCHW16c".  This is chosen at runtime.
+	std::string blocked_kernel_name();
+
+	/// @{ Forward kernels for each type of layer.  @see @ref get_forward_kernel()
+	void forward_convolutional_layer	(Layer & layer, NetworkState & state);
+	void forward_fused_convolutional_layer(Layer & layer, NetworkState & state);
+	void forward_blocked_convolutional_layer(Layer & layer, NetworkState & state);
+	void forward_blocked_maxpool_layer	(Layer & layer, NetworkState & state);
+	void forward_blocked_upsample_layer	(Layer & layer, NetworkState & state);
+	void forward_maxpool_layer			(Layer & layer, NetworkState & state);
+	void forward_route_layer			(Layer & layer, NetworkState & state);
+	void forward_shortcut_layer			(Layer & layer, NetworkState & state);
+	void forward_upsample_layer			(Layer & layer, NetworkState & state);
+	void forward_yolo_layer				(Layer & layer, NetworkState & state);
+	/// @}
+
+	/** Pack the weights of a convolutional layer into @p layer.packed_weights so every inference can skip packing them
+	 * again.  This must be called once the weights are final (loaded and batchnorm folded), and anything which changes the
+	 * weights afterwards must reset @p layer.weights_packed.  @see @ref gemm_pack_a()
+	 */
+	void pack_convolutional_weights(Layer & layer);
+
 	void binarize_weights(float *weights, const int n, const int size, float *binary);
 	void swap_binary(Layer & l);
-	void binarize_cpu(float *input, int n, float *binary);
+	void binarize_cpu(const float *input, int n, float *binary);
 	size_t binary_transpose_align_input(int k, int n, float * b, char ** t_bit_input, size_t ldb_align, int bit_align);
-	void add_bias(float * output, float * biases, int batch, int n, int size);
+	void add_bias(float * output, const float * biases, const int batch, const int n, const int size);
+	void scale_bias(float * output, const float * scales, const int batch, const int n, const int size);
+
+	/// Batch normalization as used by convolutional layers with @p batch_normalize=1.
+	void forward_batchnorm_layer(Layer & layer, NetworkState & state);
 
-	/// https://github.com/BVLC/caffe/blob/master/src/caffe/util/im2col.cpp
+	/** Write out the im2col matrix of a single group, with one row per channel and kernel position, and one column per
+	 * output pixel.  The bounds are checked once per row instead of once per pixel, and the rows are split across the
+	 * OpenMP threads.  Gives the same results as @ref im2col_cpu_ext_reference().
+	 */
 	void im2col_cpu_ext(
 			const float * data_im, const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
 			const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int dilation_h, const int dilation_w,
 			float* data_col);
+
+	/** The original im2col loop which checks every pixel, kept to test @ref im2col_cpu_ext() against.
+	 * https://github.com/BVLC/caffe/blob/master/src/caffe/util/im2col.cpp
+	 */
+	void im2col_cpu_ext_reference(
+			const float * data_im, const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
+			const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int dilation_h, const int dilation_w,
+			float* data_col);
 }
@@ -0,0 +1,117 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#pragma once
+
+#include "darknet-ng.hpp"
+
+
+namespace Darknet_ng
+{
+	/** A "model plan" is a compiled version of a @p .cfg file.  It contains the resolved @ref Network::Settings, the
+	 * shape of every layer, and the workspace sizes.  Loading a plan skips all of the text parsing done by @ref Config
+	 * and the many key lookups done by the various @p Network::parse_...() methods.
+	 *
+	 * The file is a sequence of fixed-size records, so it can be memory-mapped and read in place:
+	 *
+	 * @li a single @ref PlanHeader
+	 * @li the raw @ref Network::Settings structure (@ref PlanHeader::settings_size bytes)
+	 * @li @p steps, @p scales, and @p seq_scales
+	 * @li one @ref PlanLayer per layer
+	 * @li a table of @p int32_t used by layers which reference a variable number of values, such as the route input layers
+	 *
+	 * Because the settings are stored exactly as they are in memory, a plan is only valid for the same version of
+	 * Darknet-NG on the same platform.  This is verified by the version and the record sizes stored in the header.
+	 *
+	 * @see @ref Network::save_plan()
+	 * @see @ref Network::load_plan()
+	 *
+	 * @since 2026-10-17
+	 */
+	struct PlanHeader final
+	{
+		char		magic[8];			///< always @ref kPlanMagic
+		uint32_t	version;			///< always @ref kPlanVersion
+		uint32_t	header_size;		///< @p sizeof(PlanHeader)
+		uint32_t	settings_size;		///< @p sizeof(Network::Settings)
+		uint32_t	layer_size;			///< @p sizeof(PlanLayer)
+		uint32_t	layer_count;		///< number of @ref PlanLayer records
+		uint32_t	steps_count;		///< number of @p int32_t in @p steps
+		uint32_t	scales_count;		///< number of @p float in @p scales
+		uint32_t	seq_scales_count;	///< number of @p float in @p seq_scales
+		uint32_t	index_count;		///< number of @p int32_t in the table that follows the layers
+		uint32_t	reserved;			///< unused, always zero
+		uint64_t	workspace_size;		///< largest workspace needed by any of the layers
+	};
+
+	/** Every layer in a plan is stored as one of these records.  Not all fields apply to every type of layer.
+	 * Fields which reference a variable number of values -- such as @p input_layers in a route -- are stored as
+	 * an offset and count into the index table stored at the end of the plan.
+	 *
+	 * @since 2026-10-17
+	 */
+	struct PlanLayer final
+	{
+		int32_t type;					///< @ref ELayerType
+		int32_t activation;				///< @ref EActivation
+		int32_t batch;
+		int32_t h;
+		int32_t w;
+		int32_t c;
+		int32_t out_h;
+		int32_t out_w;
+		int32_t out_c;
+		int32_t inputs;
+		int32_t outputs;
+		int32_t index;
+		int32_t n;
+		int32_t groups;
+		int32_t group_id;
+		int32_t size;
+		int32_t stride;
+		int32_t stride_x;
+		int32_t stride_y;
+		int32_t dilation;
+		int32_t pad;
+		int32_t batch_normalize;
+		int32_t binary;
+		int32_t xnor;
+		int32_t use_bin_output;
+		int32_t antialiasing;
+		int32_t assisted_excitation;
+		int32_t deform;
+		int32_t share_index;			///< index of the shared layer, or @p -1
+		int32_t sway;
+		int32_t rotate;
+		int32_t stretch;
+		int32_t stretch_sway;
+		int32_t flipped;
+		int32_t grad_centr;
+		int32_t coordconv;
+		int32_t stream;
+		int32_t wait_stream_id;
+		int32_t maxpool_depth;
+		int32_t out_channels;
+		int32_t maxpool_zero_nonmax;
+		int32_t classes;
+		int32_t total;
+		int32_t new_coords;
+		int32_t index_offset;			///< first entry used by this layer in the index table
+		int32_t index_count;			///< number of entries used by this layer in the index table
+		float dot;
+		float angle;
+		float reverse;
+		float scale;
+		float scale_x_y;
+		uint64_t workspace_size;
+	};
+
+	/// The first 8 bytes of every plan file.
+	constexpr char kPlanMagic[8] = {'D', 'N', 'G', 'P', 'L', 'A', 'N', '\0'};
+
+	/// Increment this every time @ref PlanHeader, @ref PlanLayer, or @ref Network::Settings changes.
+	constexpr uint32_t kPlanVersion = 2;
+
+	/// Returns @p true if the given file starts with @ref kPlanMagic.
+	bool is_plan_file(const std::filesystem::path & filename);
+}
@@ -0,0 +1,169 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <array>
+#include <utility>
+#include "darknet-ng.hpp"
+
+
+/* Array versions of the activations.
+ *
+ * There is one kernel per activation, instantiated from the bias_activate<A>() template, so the activation is known at
+ * compile time and each kernel is a simple loop which the compiler vectorizes using the polynomial approximations from
+ * Activation.hpp, such as exp_approx().  The kernels are looked up once per layer -- see get_activation_kernel() -- so
+ * nothing switches on the activation while the values are processed.
+ *
+ * The same templates are compiled 3 times:  for the baseline instruction set, for AVX2, and for AVX-512.  The loops are
+ * inlined into functions with a target attribute, so the vectorizer uses the registers of that instruction set.  See
+ * get_kernels().  Conditions use blend() rather than the ternary operator, otherwise the compiler won't vectorize the
+ * loop.
+ */
+
+
+#ifdef __GNUC__
+/// The loops must be inlined into each of the kernels below, otherwise they would only be compiled for the baseline.
+#define DNG_ALWAYS_INLINE __attribute__((always_inline)) inline
+#else
+#define DNG_ALWAYS_INLINE inline
+#endif
+
+
+namespace
+{
+	using namespace Darknet_ng;
+
+	/// The activation of a single value, as used by the array kernels.  Only the elementwise activations are defined.
+	template <EActivation A> float activation_approx(const float x);
+
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kLinear	>(const float x) { return linear_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kLogistic	>(const float x) { return logistic_approx(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kLOGGY	>(const float x) { return 2.0f * logistic_approx(x) - 1.0f; }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kRELU		>(const float x) { return relu_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kRELU6	>(const float x) { return relu6_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kRELIE	>(const float x) { return relie_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kRamp		>(const float x) { return ramp_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kTANH		>(const float x) { return tanh_approx(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kPLSE		>(const float x) { return plse_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kRevLeaky	>(const float x) { return leaky_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kLeaky	>(const float x) { return leaky_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kELU		>(const float x) { return blend(x >= 0.0f, x, exp_approx(x) - 1.0f); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kStair	>(const float x) { return stair_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kHardTAN	>(const float x) { return hardtan_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kLHTAN	>(const float x) { return lhtan_activate(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kSELU		>(const float x) { return blend(x >= 0.0f, 1.0507f * x, 1.0507f * 1.6732f * (exp_approx(x) - 1.0f)); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kGELU		>(const float x) { return 0.5f * x * (1.0f + tanh_approx(0.797885f * x + 0.035677f * x * x * x)); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kSWISH	>(const float x) { return x * logistic_approx(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kMISH		>(const float x) { return mish_approx(x); }
+	template <> DNG_ALWAYS_INLINE float activation_approx<EActivation::kHardMISH	>(const float x) { return hard_mish_yashas(x); }
+
+
+	template <EActivation A>
+	DNG_ALWAYS_INLINE void bias_activate(float * x, const int n, const float bias)
+	{
+		if constexpr (A == EActivation::kLinear)
+		{
+			if (bias == 0.0f)
+			{
+				return;
+			}
+		}
+
+		#pragma omp simd
+		for (int i = 0; i < n; ++i)
+		{
+			x[i] = activation_approx<A>(x[i] + bias);
+		}
+
+		return;
+	}
+
+
+	/// @{ The kernels for each instruction set.  Their addresses are stored in the tables built by @ref make_activation_kernels().
+	struct Portable final
+	{
+		template <EActivation A>
+		static void kernel(float * x, const int n, const float bias)
+		{
+			bias_activate<A>(x, n, bias);
+		}
+	};
+
+	#if DNG_X86
+	struct AVX2 final
+	{
+		template <EActivation A>
+		__attribute__((target("avx2,fma")))
+		static void kernel(float * x, const int n, const float bias)
+		{
+			bias_activate<A>(x, n, bias);
+		}
+	};
+
+	struct AVX512 final
+	{
+		template <EActivation A>
+		__attribute__((target("avx512f,prefer-vector-width=512")))
+		static void kernel(float * x, const int n, const float bias)
+		{
+			bias_activate<A>(x, n, bias);
+		}
+	};
+	#endif
+	/// @}
+
+
+	/// The activations which need to see all of the channels at once have no kernel.
+	template <typename ISA, EActivation A>
+	constexpr ActivationKernel get_kernel()
+	{
+		if constexpr (is_elementwise(A))
+		{
+			return ISA::template kernel<A>;
+		}
+		else
+		{
+			return nullptr;
+		}
+	}
+
+
+	using ActivationKernels = std::array<ActivationKernel, static_cast<size_t>(EActivation::kMax)>;
+
+	/// Build the table of kernels indexed by @ref EActivation, with one template instantiation per activation.
+	template <typename ISA, size_t... I>
+	constexpr ActivationKernels make_activation_kernels(std::index_sequence<I...>)
+	{
+		return ActivationKernels{ get_kernel<ISA, static_cast<EActivation>(I)>()... };
+	}
+
+
+	template <typename ISA>
+	ActivationKernel lookup(const EActivation a)
+	{
+		static constexpr ActivationKernels kernels = make_activation_kernels<ISA>(std::make_index_sequence<static_cast<size_t>(EActivation::kMax)>());
+
+		const size_t idx = static_cast<size_t>(a);
+
+		return (idx < kernels.size() ? kernels[idx] : nullptr);
+	}
+}
+
+
+Darknet_ng::ActivationKernel Darknet_ng::portable::get_activation_kernel(const Darknet_ng::EActivation a)
+{
+	return lookup<Portable>(a);
+}
+
+
+#if DNG_X86
+Darknet_ng::ActivationKernel Darknet_ng::avx2::get_activation_kernel(const Darknet_ng::EActivation a)
+{
+	return lookup<AVX2>(a);
+}
+
+
+Darknet_ng::ActivationKernel Darknet_ng::avx512::get_activation_kernel(const Darknet_ng::EActivation a)
+{
+	return lookup<AVX512>(a);
+}
+#endif
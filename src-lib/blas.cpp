@@ -21,3 +21,111 @@ void Darknet_ng::fill_cpu(const int n, float const alpha, float * ptr, const int
 	return;
 }
 
+
+
+void Darknet_ng::mean_cpu(const float * x, const int batch, const int filters, const int spatial, float * mean)
+{
+	const float scale = 1.0f / (batch * spatial);
+
+	for (int i = 0; i < filters; ++i)
+	{
+		mean[i] = 0.0f;
+		for (int j = 0; j < batch; ++j)
+		{
+			for (int k = 0; k < spatial; ++k)
+			{
+				const int index = j * filters * spatial + i * spatial + k;
+				mean[i] += x[index];
+			}
+		}
+		mean[i] *= scale;
+	}
+
+	return;
+}
+
+
+void Darknet_ng::variance_cpu(const float * x, const float * mean, const int batch, const int filters, const int spatial, float * variance)
+{
+	const float scale = 1.0f / (batch * spatial - 1);
+
+	for (int i = 0; i < filters; ++i)
+	{
+		variance[i] = 0.0f;
+		for (int j = 0; j < batch; ++j)
+		{
+			for (int k = 0; k < spatial; ++k)
+			{
+				const int index = j * filters * spatial + i * spatial + k;
+				variance[i] += std::pow((x[index] - mean[i]), 2);
+			}
+		}
+		variance[i] *= scale;
+	}
+
+	return;
+}
+
+
+void Darknet_ng::normalize_cpu(float * x, const float * mean, const float * variance, const int batch, const int filters, const int spatial)
+{
+	#pragma omp parallel for
+	for (int bf = 0; bf < batch * filters; ++bf)
+	{
+		const int f = bf % filters;
+		const float divisor = std::sqrt(variance[f] + 0.00001f);
+
+		float * ptr = x + bf * spatial;
+		for (int i = 0; i < spatial; ++i)
+		{
+			ptr[i] = (ptr[i] - mean[f]) / divisor;
+		}
+	}
+
+	return;
+}
+
+
+void Darknet_ng::nchw_to_nchwc(const float * src, float * dst, const int batch, const int channels, const int spatial, const int block)
+{
+	const int blocks = channels / block;
+
+	#pragma omp parallel for
+	for (int bb = 0; bb < batch * blocks; ++bb)
+	{
+		// each block of the output comes from "block" consecutive channels of the input
+		const float * in	= src + static_cast<size_t>(bb) * block * spatial;
+		float * out			= dst + static_cast<size_t>(bb) * block * spatial;
+		for (int i = 0; i < spatial; ++i)
+		{
+			for (int c = 0; c < block; ++c)
+			{
+				out[i * block + c] = in[c * spatial + i];
+			}
+		}
+	}
+
+	return;
+}
+
+
+void Darknet_ng::nchwc_to_nchw(const float * src, float * dst, const int batch, const int channels, const int spatial, const int block)
+{
+	const int blocks = channels / block;
+
+	#pragma omp parallel for
+	for (int bb = 0; bb < batch * blocks; ++bb)
+	{
+		const float * in	= src + static_cast<size_t>(bb) * block * spatial;
+		float * out			= dst + static_cast<size_t>(bb) * block * spatial;
+		for (int c = 0; c < block; ++c)
+		{
+			for (int i = 0; i < spatial; ++i)
+			{
+				out[c * spatial + i] = in[i * block + c];
+			}
+		}
+	}
+
+	return;
+}
@@ -9,4 +9,18 @@
 namespace Darknet_ng
 {
 	void fill_cpu(const int n, float const alpha, float * ptr, const int incx);
+
+	/// @{ Per-channel statistics used by batch normalization.  The data is laid out as @p [batch][filters][spatial].
+	void mean_cpu		(const float * x, const int batch, const int filters, const int spatial, float * mean);
+	void variance_cpu	(const float * x, const float * mean, const int batch, const int filters, const int spatial, float * variance);
+	void normalize_cpu	(float * x, const float * mean, const float * variance, const int batch, const int filters, const int spatial);
+	/// @}
+
+	/** @{ Convert @p batch images between the plain NCHW layout and the blocked NCHWc layout, where each group of
+	 * @p block channels is stored together for every pixel as @p [batch][channels/block][spatial][block].
+	 * @p channels must be a multiple of @p block.  @see @ref Network::use_blocked_layout()
+	 */
+	void nchw_to_nchwc(const float * src, float * dst, const int batch, const int channels, const int spatial, const int block);
+	void nchwc_to_nchw(const float * src, float * dst, const int batch, const int channels, const int spatial, const int block);
+	/// @}
 }
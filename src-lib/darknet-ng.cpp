@@ -91,6 +91,29 @@ Darknet_ng::VStr Darknet_ng::read_text_file(const std::filesystem::path & filena
 }
 
 
+std::string Darknet_ng::read_entire_file(const std::filesystem::path & filename)
+{
+	if (not std::filesystem::exists(filename))
+	{
+		/// @throw Exception The file does not exist.
+		throw Exception("file does not exist: \"" + filename.string() + "\"", DNG_LOC);
+	}
+
+	std::ifstream ifs(filename, std::ios::binary);
+	if (not ifs.good())
+	{
+		/// @throw Exception The file cannot be read.  (Permission issue?)
+		throw Exception("failed to read file: \"" + filename.string() + "\"", DNG_LOC);
+	}
+
+	std::string text(std::filesystem::file_size(filename), '\0');
+	ifs.read(text.data(), text.size());
+	text.resize(ifs.gcount());
+
+	return text;
+}
+
+
 std::default_random_engine & get_engine()
 {
 	static std::default_random_engine engine(
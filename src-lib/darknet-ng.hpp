@@ -5,8 +5,11 @@
 
 #include <exception>
 #include <filesystem>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <opencv2/opencv.hpp>
 
@@ -41,6 +44,9 @@ namespace Darknet_ng
 	/// Read the given text file line-by-line and store in a vector.  File must exist.
 	VStr read_text_file(const std::filesystem::path & filename);
 
+	/// Read the entire file into a single string with one read.  File must exist.
+	std::string read_entire_file(const std::filesystem::path & filename);
+
 	/// Generate a random float.
 	float rand_uniform(float low, float high);
 }
@@ -51,8 +57,12 @@ namespace Darknet_ng
 #include "gemm.hpp"
 #include "enums.hpp"
 #include "structs.hpp"
+#include "Arena.hpp"
 #include "Activation.hpp"
+#include "dispatch.hpp"
 #include "LearningRatePolicy.hpp"
 #include "Layers.hpp"
 #include "Config.hpp"
 #include "Network.hpp"
+#include "InferenceContext.hpp"
+#include "Plan.hpp"
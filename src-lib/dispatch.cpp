@@ -0,0 +1,250 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+#if DNG_X86
+#include <cpuid.h>
+#endif
+
+
+/* Runtime dispatch.
+ *
+ * The CPU is queried once for the instruction set extensions it supports, and the fastest implementation of each kernel
+ * is chosen from those.  The x86 kernels are compiled with the target attribute instead of -mavx2 or -march=native, so a
+ * single binary contains all of them and still runs on a CPU which only has the baseline instructions.
+ */
+
+
+const Darknet_ng::CpuFeatures & Darknet_ng::get_cpu_features()
+{
+	static const CpuFeatures features = []() -> CpuFeatures
+	{
+		CpuFeatures result;
+		std::memset(&result, '\0', sizeof(result));
+
+#if DNG_X86
+		__builtin_cpu_init();
+		result.sse42			= __builtin_cpu_supports("sse4.2");
+		result.popcnt			= __builtin_cpu_supports("popcnt");
+		result.avx				= __builtin_cpu_supports("avx");
+		result.avx2				= __builtin_cpu_supports("avx2");
+		result.fma				= __builtin_cpu_supports("fma");
+		result.avx512f			= __builtin_cpu_supports("avx512f");
+		result.avx512bw			= __builtin_cpu_supports("avx512bw");
+		result.avx512vnni		= __builtin_cpu_supports("avx512vnni");
+		result.avx512vpopcntdq	= __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+
+		return result;
+	}();
+
+	return features;
+}
+
+
+std::string Darknet_ng::to_string(const Darknet_ng::CpuFeatures & features)
+{
+	const std::vector<std::pair<bool, std::string>> names =
+	{
+		{features.sse42				, "sse4.2"			},
+		{features.popcnt			, "popcnt"			},
+		{features.avx				, "avx"				},
+		{features.avx2				, "avx2"			},
+		{features.fma				, "fma"				},
+		{features.avx512f			, "avx512f"			},
+		{features.avx512bw			, "avx512bw"		},
+		{features.avx512vnni		, "avx512vnni"		},
+		{features.avx512vpopcntdq	, "avx512vpopcntdq"	},
+	};
+
+	std::string text;
+	for (const auto & [supported, name] : names)
+	{
+		if (supported)
+		{
+			if (not text.empty())
+			{
+				text += " ";
+			}
+			text += name;
+		}
+	}
+
+	if (text.empty())
+	{
+		text = "none";
+	}
+
+	return text;
+}
+
+
+const std::string & Darknet_ng::get_cpu_model()
+{
+	static const std::string model = []() -> std::string
+	{
+		std::string result;
+
+#if DNG_X86
+		unsigned int eax = 0;
+		unsigned int ebx = 0;
+		unsigned int ecx = 0;
+		unsigned int edx = 0;
+		if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) and eax >= 0x80000004)
+		{
+			// the brand string is 48 characters returned 16 at a time by the 3 extended leaves
+			char brand[49];
+			std::memset(brand, '\0', sizeof(brand));
+			for (unsigned int leaf = 0; leaf < 3; leaf ++)
+			{
+				unsigned int regs[4];
+				__get_cpuid(0x80000002 + leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+				std::memcpy(brand + 16 * leaf, regs, sizeof(regs));
+			}
+			result = brand;
+		}
+#endif
+
+		// the brand string is padded with spaces
+		const size_t first	= result.find_first_not_of(" ");
+		const size_t last	= result.find_last_not_of(" ");
+		result = (first == std::string::npos ? "unknown" : result.substr(first, last - first + 1));
+
+		return result;
+	}();
+
+	return model;
+}
+
+
+const Darknet_ng::KernelRegistry & Darknet_ng::get_kernels()
+{
+	static const KernelRegistry kernels = []() -> KernelRegistry
+	{
+		KernelRegistry result
+		{
+			"portable",
+			"portable",
+			"portable",
+			portable::get_activation_kernel,
+			portable::float_to_bit,
+			portable::im2col_cpu_custom,
+			portable::im2col_cpu_custom_bin,
+			portable::gemm_nn_custom_bin_mean_transposed,
+		};
+
+		#if DNG_X86
+		const CpuFeatures & features = get_cpu_features();
+		if (features.avx2 and features.fma)
+		{
+			result = KernelRegistry
+			{
+				"avx2",
+				"avx2",
+				"avx2",
+				avx2::get_activation_kernel,
+				avx2::float_to_bit,
+				avx2::im2col_cpu_custom,
+				avx2::im2col_cpu_custom_bin,
+				avx2::gemm_nn_custom_bin_mean_transposed,
+			};
+		}
+
+		if (features.avx512f)
+		{
+			// the activations and the XNOR GEMM are the only kernels which also have an AVX-512 version
+			result.activation_name			= "avx512";
+			result.get_activation_kernel	= avx512::get_activation_kernel;
+		}
+
+		if (features.avx512f and features.avx512vpopcntdq)
+		{
+			result.xnor_gemm_name						= "avx512";
+			result.gemm_nn_custom_bin_mean_transposed	= avx512::gemm_nn_custom_bin_mean_transposed;
+		}
+		#endif
+
+		return result;
+	}();
+
+	return kernels;
+}
+
+
+Darknet_ng::MStr Darknet_ng::get_kernel_implementations()
+{
+	const std::string & name = get_kernels().name;
+
+	MStr implementations;
+	implementations["activations"						] = get_kernels().activation_name;
+	implementations["float_to_bit"						] = name;
+	implementations["im2col_cpu_custom"					] = name;
+	implementations["im2col_cpu_custom_bin"				] = name;
+	implementations["gemm_nn_custom_bin_mean_transposed"] = get_kernels().xnor_gemm_name;
+	implementations["gemm"								] = gemm_kernel_name();
+	implementations["blocked convolution"				] = blocked_kernel_name();
+
+	return implementations;
+}
+
+
+Darknet_ng::ActivationKernel Darknet_ng::get_activation_kernel(const Darknet_ng::EActivation a)
+{
+	const ActivationKernel kernel = get_kernels().get_activation_kernel(a);
+	if (kernel == nullptr)
+	{
+		/// @throw Exception The activation cannot be applied to each value on its own.
+		throw Exception("activation \"" + to_string(a) + "\" does not have an elementwise kernel", DNG_LOC);
+	}
+
+	return kernel;
+}
+
+
+void Darknet_ng::activate_array_cpu_custom(float * x, const int n, const Darknet_ng::EActivation a)
+{
+	get_activation_kernel(a)(x, n, 0.0f);
+
+	return;
+}
+
+
+void Darknet_ng::bias_activate_array(float * x, const int n, const float bias, const Darknet_ng::EActivation a)
+{
+	get_activation_kernel(a)(x, n, bias);
+
+	return;
+}
+
+
+void Darknet_ng::float_to_bit(const float * src, unsigned char * dst, const size_t size)
+{
+	get_kernels().float_to_bit(src, dst, size);
+
+	return;
+}
+
+
+void Darknet_ng::im2col_cpu_custom(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col)
+{
+	get_kernels().im2col_cpu_custom(data_im, channels, height, width, ksize, stride, pad, data_col);
+
+	return;
+}
+
+
+void Darknet_ng::im2col_cpu_custom_bin(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align)
+{
+	get_kernels().im2col_cpu_custom_bin(data_im, channels, height, width, ksize, stride, pad, data_col, bit_align);
+
+	return;
+}
+
+
+void Darknet_ng::gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr)
+{
+	get_kernels().gemm_nn_custom_bin_mean_transposed(M, N, K, ALPHA_UNUSED, A, lda, B, ldb, C, ldc, mean_arr);
+
+	return;
+}
@@ -0,0 +1,99 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#pragma once
+
+#include "darknet-ng.hpp"
+
+
+namespace Darknet_ng
+{
+	/** The instruction set extensions supported by this CPU.  These are detected once the first time
+	 * @ref get_cpu_features() is called, and are used to choose the kernels in @ref get_kernels().
+	 *
+	 * @since 2026-10-17
+	 */
+	struct CpuFeatures final
+	{
+		bool sse42;
+		bool popcnt;
+		bool avx;
+		bool avx2;
+		bool fma;
+		bool avx512f;
+		bool avx512bw;
+		bool avx512vnni;
+		bool avx512vpopcntdq;
+	};
+
+	/// Get the features supported by this CPU.  Always returns the same object.
+	const CpuFeatures & get_cpu_features();
+
+	/// Get the names of the supported features, such as @p "sse4.2 popcnt avx avx2 fma".
+	std::string to_string(const CpuFeatures & features);
+
+	/** Get the brand name of this CPU, such as @p "Intel(R) Xeon(R) CPU @ 2.20GHz", or @p "unknown" when the CPU does
+	 * not report it.  Always returns the same object.  @see @ref Network::autotune()
+	 */
+	const std::string & get_cpu_model();
+
+	/** The kernels which have more than one implementation.  The fastest implementation supported by the CPU is chosen
+	 * once by @ref get_kernels(), so the same binary runs on every generation of CPU.  The functions of the same name in
+	 * the @p Darknet_ng namespace call through these pointers, so this is rarely needed directly.
+	 *
+	 * @since 2026-10-17
+	 */
+	struct KernelRegistry final
+	{
+		std::string name;				///< the implementation chosen for the kernels below, such as @p "avx2"
+		std::string activation_name;	///< the activations can also use AVX-512, so they may use a different implementation
+		std::string xnor_gemm_name;		///< same for @ref gemm_nn_custom_bin_mean_transposed(), which uses AVX-512 VPOPCNTDQ
+
+		ActivationKernel (*get_activation_kernel)	(const EActivation a);
+		void (*float_to_bit)						(const float * src, unsigned char * dst, const size_t size);
+		void (*im2col_cpu_custom)					(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
+		void (*im2col_cpu_custom_bin)				(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align);
+		void (*gemm_nn_custom_bin_mean_transposed)	(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
+	};
+
+	/// Get the kernels chosen for this CPU.  Always returns the same object.
+	const KernelRegistry & get_kernels();
+
+	/** Get the implementation chosen for every kernel which is picked at runtime, including the GEMM microkernel and the
+	 * blocked convolution kernels.  The key is the name of the kernel, and the value is the implementation.
+	 */
+	MStr get_kernel_implementations();
+
+	/// @{ The implementations used by @ref get_kernels().  Call the functions of the same name in @p Darknet_ng instead.
+	namespace portable
+	{
+		ActivationKernel get_activation_kernel(const EActivation a);
+		void float_to_bit(const float * src, unsigned char * dst, const size_t size);
+		void im2col_cpu_custom(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
+		void im2col_cpu_custom_bin(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align);
+		void gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
+	}
+
+	#if DNG_X86
+	namespace avx2
+	{
+		ActivationKernel get_activation_kernel(const EActivation a);
+		void float_to_bit(const float * src, unsigned char * dst, const size_t size);
+		void im2col_cpu_custom(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
+		void im2col_cpu_custom_bin(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align);
+		void gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
+
+		/** The original AVX2 XNOR GEMM, which works on 2 x 2 tiles and adds up the counts after every 256 bits.  This is
+		 * only kept so @p benchmark-xnor-gemm can compare against it.  Only an even number of rows of C are written.
+		 */
+		void gemm_nn_custom_bin_mean_transposed_reference(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
+	}
+
+	namespace avx512
+	{
+		ActivationKernel get_activation_kernel(const EActivation a);
+		void gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
+	}
+	#endif
+	/// @}
+}
@@ -4,143 +4,180 @@
 #include "darknet-ng.hpp"
 
 
-// 32 channels -> 1 channel (with 32 floats)
-// 256 channels -> 8 channels (with 32 floats)
-void Darknet_ng::repack_input(float * input, float * re_packed_input, int w, int h, int c)
+void Darknet_ng::gemm_reference(int TA, int TB, int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float BETA, float * C, int ldc)
 {
-	const int items_per_channel = w * h;
+	// was:  void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, float *A, int lda, float *B, int ldb, float BETA, float *C, int ldc)
 
-	for (int chan = 0; chan < c; chan += 32)
+	if (BETA != 1.0f)
 	{
-		for (int i = 0; i < items_per_channel; ++i)
+		for (int i = 0; i < M; ++i)
 		{
-			for (int c_pack = 0; c_pack < 32; ++c_pack)
+			for (int j = 0; j < N; ++j)
 			{
-				float src = input[(chan + c_pack) * items_per_channel + i];
-				re_packed_input[chan * items_per_channel + i * 32 + c_pack] = src;
+				C[i * ldc + j] *= BETA;
 			}
 		}
 	}
 
+	// each thread works on a different row of C
+	#pragma omp parallel for
+	for (int t = 0; t < M; ++t)
+	{
+		if (not TA and not TB)
+		{
+			gemm_nn(1, N, K, ALPHA, A + t * lda, lda, B, ldb, C + t * ldc, ldc);
+		}
+		else if (TA and not TB)
+		{
+			gemm_tn(1, N, K, ALPHA, A + t, lda, B, ldb, C + t * ldc, ldc);
+		}
+		else if (not TA and TB)
+		{
+			gemm_nt(1, N, K, ALPHA, A + t * lda, lda, B, ldb, C + t * ldc, ldc);
+		}
+		else
+		{
+			gemm_tt(1, N, K, ALPHA, A + t, lda, B, ldb, C + t * ldc, ldc);
+		}
+	}
+
 	return;
 }
 
 
-void Darknet_ng::float_to_bit(float *src, unsigned char *dst, const size_t size)
+void Darknet_ng::gemm_nn(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc)
 {
-	size_t dst_size = size / 8 + 1;
-	memset(dst, 0, dst_size);
-
-	//__m256i all256_sing1 = _mm256_set_epi32(0x80000000, 0x80000000, 0x80000000, 0x80000000, 0x80000000, 0x80000000, 0x80000000, 0x80000000);
-	__m256 float_zero256 = _mm256_set1_ps(0.0);
-
-	for (size_t i = 0; i < size; i += 8)
+	for (int i = 0; i < M; ++i)
 	{
-		//__m256i src256 = _mm256_loadu_si256((__m256i *)(&src[i]));
-		//__m256i result256 = _mm256_and_si256(src256, all256_sing1); // check sign in 8 x 32-bit floats
-		//uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(result256)); // (val >= 0) ? 0 : 1
-		////mask = ~mask;   // inverse mask,  (val >= 0) ? 1 : 0
-
-		__m256 src256 = _mm256_loadu_ps((float *)(&src[i]));
-		__m256 result256 = _mm256_cmp_ps(src256, float_zero256, _CMP_GT_OS);
-		uint32_t mask = _mm256_movemask_ps(result256); // (val > 0) ? 0 : 1
-
-		dst[i / 8] = mask;
+		for (int k = 0; k < K; ++k)
+		{
+			const float A_PART = ALPHA * A[i * lda + k];
+			for (int j = 0; j < N; ++j)
+			{
+				C[i * ldc + j] += A_PART * B[k * ldb + j];
+			}
+		}
 	}
 
 	return;
 }
 
 
-void im2col_cpu_custom(float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col)
+void Darknet_ng::gemm_nt(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc)
 {
-	int c;
-	const int height_col = (height + 2 * pad - ksize) / stride + 1;
-	const int width_col = (width + 2 * pad - ksize) / stride + 1;
-	const int channels_col = channels * ksize * ksize;
-
-	// optimized version
-	if (height_col == height && width_col == width && stride == 1 && pad == 1 && is_fma_avx2())
+	for (int i = 0; i < M; ++i)
 	{
-		#pragma omp parallel for
-		for (c = 0; c < channels_col; ++c) {
-			int h, w;
-			int w_offset = c % ksize;
-			int h_offset = (c / ksize) % ksize;
-			int c_im = c / ksize / ksize;
-			for (h = pad; h < height_col-pad; ++h)
+		for (int j = 0; j < N; ++j)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < K; ++k)
 			{
-				for (w = pad; w < width_col-pad-8; w += 8)
-				{
-					int im_row = h_offset + h - pad;
-					int im_col = w_offset + w - pad;
-					int col_index = (c * height_col + h) * width_col + w;
-
-					//data_col[col_index] = data_im[im_col + width*(im_row + height*c_im)];
-					__m256 src256 = _mm256_loadu_ps((float *)(&data_im[im_col + width*(im_row + height*c_im)]));
-					_mm256_storeu_ps(&data_col[col_index], src256);
-				}
-
-				for (; w < width_col - pad; ++w)
-				{
-					int im_row = h_offset + h - pad;
-					int im_col = w_offset + w - pad;
-					int col_index = (c * height_col + h) * width_col + w;
-
-					data_col[col_index] = data_im[im_col + width*(im_row + height*c_im)];
-				}
+				sum += ALPHA * A[i * lda + k] * B[j * ldb + k];
 			}
+			C[i * ldc + j] += sum;
+		}
+	}
 
-			{
-				w = 0;
-				for (h = 0; h < height_col; ++h)
-				{
-					int im_row = h_offset + h;
-					int im_col = w_offset + w;
-					int col_index = (c * height_col + h) * width_col + w;
-					data_col[col_index] = im2col_get_pixel(data_im, height, width, channels, im_row, im_col, c_im, pad);
-				}
-			}
+	return;
+}
 
-			{
-				w = width_col-1;
-				for (h = 0; h < height_col; ++h)
-				{
-					int im_row = h_offset + h;
-					int im_col = w_offset + w;
-					int col_index = (c * height_col + h) * width_col + w;
-					data_col[col_index] = im2col_get_pixel(data_im, height, width, channels, im_row, im_col, c_im, pad);
-				}
-			}
 
+void Darknet_ng::gemm_tn(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc)
+{
+	for (int i = 0; i < M; ++i)
+	{
+		for (int k = 0; k < K; ++k)
+		{
+			const float A_PART = ALPHA * A[k * lda + i];
+			for (int j = 0; j < N; ++j)
 			{
-				h = 0;
-				for (w = 0; w < width_col; ++w)
-				{
-					int im_row = h_offset + h;
-					int im_col = w_offset + w;
-					int col_index = (c * height_col + h) * width_col + w;
-					data_col[col_index] = im2col_get_pixel(data_im, height, width, channels, im_row, im_col, c_im, pad);
-				}
+				C[i * ldc + j] += A_PART * B[k * ldb + j];
 			}
+		}
+	}
+
+	return;
+}
 
+
+void Darknet_ng::gemm_tt(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc)
+{
+	for (int i = 0; i < M; ++i)
+	{
+		for (int j = 0; j < N; ++j)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < K; ++k)
 			{
-				h = height_col-1;
-				for (w = 0; w < width_col; ++w)
-				{
-					int im_row = h_offset + h;
-					int im_col = w_offset + w;
-					int col_index = (c * height_col + h) * width_col + w;
-					data_col[col_index] = im2col_get_pixel(data_im, height, width, channels, im_row, im_col, c_im, pad);
-				}
+				sum += ALPHA * A[i + k * lda] * B[k + j * ldb];
 			}
+			C[i * ldc + j] += sum;
 		}
+	}
+
+	return;
+}
+
+
+bool Darknet_ng::is_avx()
+{
+	return get_cpu_features().avx;
+}
+
+
+bool Darknet_ng::is_fma_avx2()
+{
+	const CpuFeatures & features = get_cpu_features();
+
+	return features.fma and features.avx2;
+}
 
+
+bool Darknet_ng::is_avx512()
+{
+	return get_cpu_features().avx512f;
+}
+
+
+float Darknet_ng::im2col_get_pixel(const float * im, int height, int width, int channels, int row, int col, int channel, int pad)
+{
+	row -= pad;
+	col -= pad;
+
+	if (row < 0 or col < 0 or row >= height or col >= width)
+	{
+		return 0.0f;
 	}
-	else
+
+	return im[col + width * (row + height * channel)];
+}
+
+
+void Darknet_ng::im2col_cpu(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col)
+{
+	// the rows and columns are in the same order as im2col_cpu_ext(), which skips the bounds checks on most pixels
+	im2col_cpu_ext(data_im, channels, height, width, ksize, ksize, pad, pad, stride, stride, 1, 1, data_col);
+
+	return;
+}
+
+
+// 32 channels -> 1 channel (with 32 floats)
+// 256 channels -> 8 channels (with 32 floats)
+void Darknet_ng::repack_input(const float * input, float * re_packed_input, int w, int h, int c)
+{
+	const int items_per_channel = w * h;
+
+	for (int chan = 0; chan < c; chan += 32)
 	{
-		//printf("\n Error: is no non-optimized version \n");
-		im2col_cpu(data_im, channels, height, width, ksize, stride, pad, data_col);
+		for (int i = 0; i < items_per_channel; ++i)
+		{
+			for (int c_pack = 0; c_pack < 32; ++c_pack)
+			{
+				float src = input[(chan + c_pack) * items_per_channel + i];
+				re_packed_input[chan * items_per_channel + i * 32 + c_pack] = src;
+			}
+		}
 	}
 
 	return;
@@ -163,110 +200,90 @@ void Darknet_ng::transpose_uint32(uint32_t * src, uint32_t * dst, int src_h, int
 }
 
 
-void Darknet_ng::gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr)
+namespace
 {
-	#if defined(_OPENMP)
-	static int max_num_threads = 0;
-	if (max_num_threads == 0) {
-		max_num_threads = omp_get_max_threads();
-		//omp_set_num_threads(max_num_threads / 2);
+	inline uint8_t reverse_8_bit(const uint8_t a)
+	{
+		return ((a * 0x0802LU & 0x22110LU) | (a * 0x8020LU & 0x88440LU)) * 0x10101LU >> 16;
 	}
-	#endif
 
-	//#pragma omp parallel for
-	//for (i = 0; i < M; ++i)
-	#pragma omp parallel for
-	for (int i = 0; i < (M/2)*2; i += 2)
-	{   // l.n - filters [16 - 55 - 1024]
-		float mean_val_0 = mean_arr[i + 0];
-		float mean_val_1 = mean_arr[i + 1];
-		//__m256i all_1 = _mm256_set1_epi8(255);
-
-		//for (j = 0; j < N; ++j)
-		for (int j = 0; j < (N/2)*2; j += 2)
-		{ // out_h*out_w - one channel output size [169 - 173056]
-			//int count = 0;
-			const int bit_step = 256;
-			__m256i count_sum_0 = _mm256_set1_epi8(0);
-			__m256i count_sum_1 = _mm256_set1_epi8(0);
-			__m256i count_sum_2 = _mm256_set1_epi8(0);
-			__m256i count_sum_3 = _mm256_set1_epi8(0);
-
-			for (int k = 0; k < K; k += bit_step)
-			{   // l.size*l.size*l.c - one filter size [27 - 9216]
-				__m256i a_bit256_0 = _mm256_loadu_si256((__m256i *)(A + ((i + 0)*lda + k) / 8));
-				__m256i b_bit256_0 = _mm256_loadu_si256((__m256i *)(B + ((j + 0)*ldb + k) / 8));
-
-				__m256i a_bit256_1 = _mm256_loadu_si256((__m256i *)(A + ((i + 1)*lda + k) / 8));
-				__m256i b_bit256_1 = _mm256_loadu_si256((__m256i *)(B + ((j + 1)*ldb + k) / 8));
-
-
-				xnor_avx2_popcnt(a_bit256_0, b_bit256_0, &count_sum_0);
-				xnor_avx2_popcnt(a_bit256_0, b_bit256_1, &count_sum_1);
-
-				xnor_avx2_popcnt(a_bit256_1, b_bit256_0, &count_sum_2);
-				xnor_avx2_popcnt(a_bit256_1, b_bit256_1, &count_sum_3);
-
-				//count += popcnt256(c_bit256);
-				//binary_int64_printf(c_bit64);
-				//printf(", count = %d \n\n", tmp_count);
+
+	inline uint32_t reverse_32_bit(const uint32_t a)
+	{
+		return
+			(reverse_8_bit(a >> 24) << 0	) |
+			(reverse_8_bit(a >> 16) << 8	) |
+			(reverse_8_bit(a >> 8	) << 16	) |
+			(reverse_8_bit(a >> 0	) << 24	);
+	}
+
+
+	void transpose32_optimized(uint32_t A[32])
+	{
+		const auto swap = [](uint32_t & a0, uint32_t & a1, const int j, const uint32_t m)
+		{
+			const uint32_t t = (a0 ^ (a1 >> j)) & m;
+			a0 = a0 ^ t;
+			a1 = a1 ^ (t << j);
+		};
+
+		uint32_t m = 0x0000FFFF;
+		for (int j = 16; j != 0; j = j >> 1, m = m ^ (m << j))
+		{
+			for (int k = 0; k < 32; k = (k + j + 1) & ~j)
+			{
+				swap(A[k], A[k + j], j, m);
 			}
+		}
 
-			int count_0 = get_count_mula(count_sum_0);
-			int count_1 = get_count_mula(count_sum_1);
-			int count_2 = get_count_mula(count_sum_2);
-			int count_3 = get_count_mula(count_sum_3);
-
-			const int f1 = (K % bit_step == 0) ? 0 : (bit_step - (K % bit_step));
-			count_0 = count_0 - f1;    // remove extra bits (from empty space for align only)
-			count_1 = count_1 - f1;
-			count_2 = count_2 - f1;
-			count_3 = count_3 - f1;
-			C[i*ldc + (j + 0)] = (2 * count_0 - K) * mean_val_0;
-			C[i*ldc + (j + 1)] = (2 * count_1 - K) * mean_val_0;
-			C[(i + 1)*ldc + (j + 0)] = (2 * count_2 - K) * mean_val_1;
-			C[(i + 1)*ldc + (j + 1)] = (2 * count_3 - K) * mean_val_1;
+		// reverse Y
+		for (int j = 0; j < 16; ++j)
+		{
+			const uint32_t tmp = A[j];
+			A[j] = reverse_32_bit(A[31 - j]);
+			A[31 - j] = reverse_32_bit(tmp);
 		}
 
-		for (int i_d = 0; i_d < 2; ++i_d)
+		return;
+	}
+
+
+	void transpose_32x32_bits_reversed_diagonale(uint32_t * A, uint32_t * B, const int m, const int n)
+	{
+		uint32_t A_tmp[32];
+		for (int i = 0; i < 32; ++i)
 		{
-			float mean_val = mean_arr[i + i_d];
-			for (j = (N / 2) * 2; j < N; j += 1)
-			{ // out_h*out_w - one channel output size [169 - 173056]
-				const int bit_step = 256;
-				__m256i count_sum = _mm256_set1_epi8(0);
-
-				for (k = 0; k < K; k += bit_step) {   // l.size*l.size*l.c - one filter size [27 - 9216]
-					__m256i a_bit256_0 = _mm256_loadu_si256((__m256i *)(A + ((i + i_d + 0)*lda + k) / 8));
-					__m256i b_bit256_0 = _mm256_loadu_si256((__m256i *)(B + ((j + 0)*ldb + k) / 8));
-					xnor_avx2_popcnt(a_bit256_0, b_bit256_0, &count_sum);
-				}
-				int count = get_count_mula(count_sum);
-				const int f1 = (K % bit_step == 0) ? 0 : (bit_step - (K % bit_step));
-				count = count - f1;    // remove extra bits (from empty space for align only)
-				C[(i + i_d)*ldc + j] = (2 * count - K) * mean_val;
-			}
+			A_tmp[i] = A[i * m];
 		}
+		transpose32_optimized(A_tmp);
+		for (int i = 0; i < 32; ++i)
+		{
+			B[i * n] = A_tmp[i];
+		}
+
+		return;
 	}
+}
 
-	for (int i = (M / 2) * 2; i < M; i += 1)
+
+void Darknet_ng::transpose_bin(uint32_t * A, uint32_t * B, const int n, const int m, const int lda, const int ldb, const int block_size)
+{
+	#pragma omp parallel for
+	for (int i = 0; i < n; i += 32)
 	{
-		float mean_val = mean_arr[i];
-		int j, k;
-		for (j = 0; j < N; j += 1)
-		{ // out_h*out_w - one channel output size [169 - 173056]
-			const int bit_step = 256;
-			__m256i count_sum = _mm256_set1_epi8(0);
-
-			for (k = 0; k < K; k += bit_step) {   // l.size*l.size*l.c - one filter size [27 - 9216]
-				__m256i a_bit256_0 = _mm256_loadu_si256((__m256i *)(A + ((i + 0)*lda + k) / 8));
-				__m256i b_bit256_0 = _mm256_loadu_si256((__m256i *)(B + ((j + 0)*ldb + k) / 8));
-				xnor_avx2_popcnt(a_bit256_0, b_bit256_0, &count_sum);
+		int j = 0;
+		for (; j < m; j += 32)
+		{
+			const int a_index = i * lda + j;
+			const int b_index = j * ldb + i;
+			transpose_32x32_bits_reversed_diagonale(&A[a_index / 32], &B[b_index / 32], lda / 32, ldb / 32);
+		}
+		for (; j < m; ++j)
+		{
+			if (get_bit((const unsigned char *)A, i * lda + j))
+			{
+				set_bit((unsigned char *)B, j * ldb + i);
 			}
-			int count = get_count_mula(count_sum);
-			const int f1 = (K % bit_step == 0) ? 0 : (bit_step - (K % bit_step));
-			count = count - f1;    // remove extra bits (from empty space for align only)
-			C[i*ldc + j] = (2 * count - K) * mean_val;
 		}
 	}
 
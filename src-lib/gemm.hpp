@@ -6,21 +6,174 @@
 #include "darknet-ng.hpp"
 
 
+/** Defined when building for x86 with GCC or Clang.  The AVX2 and AVX-512 kernels are then compiled with the @p target
+ * attribute so every build contains them, and the fastest kernels supported by the CPU are chosen at runtime.  There is
+ * no need to build with @p -mavx2 or @p -mfma.  (This replaces the @p AVX define used by the original Makefile.)
+ * @see @ref get_cpu_features()
+ */
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#define DNG_X86 1
+#endif
+
+
 namespace Darknet_ng
 {
-	void repack_input(float * input, float * re_packed_input, int w, int h, int c);
-	void float_to_bit(float * src, unsigned char * dst, const size_t size);
+	/** Optional callback used by @ref gemm() on each block of @p C as soon as the block is complete, while it is still in
+	 * cache.  @p C points to the first value of the block, which starts at @p row and @p col and is @p rows x @p cols.
+	 * The blocks never overlap, but several may be processed at the same time by different OpenMP threads.
+	 */
+	using GemmEpilogue = std::function<void(float * C, const int ldc, const int row, const int col, const int rows, const int cols)>;
+
+	/** General matrix multiplication:  @p C = @p ALPHA * @p A * @p B + @p BETA * @p C, where @p A and @p B may be
+	 * transposed with @p TA and @p TB.  When @p BETA is zero the previous content of @p C is ignored.
+	 *
+	 * The matrices are packed into panels and multiplied in blocks sized for the caches by the fastest microkernel
+	 * supported by the CPU.  The blocks of @p C are distributed across the OpenMP threads.  @see @ref gemm_kernel_name()
+	 */
+	void gemm(int TA, int TB, int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float BETA, float * C, int ldc, const GemmEpilogue & epilogue = GemmEpilogue());
+
+	/// The number of @p float needed by @ref gemm_pack_a() to pack an @p M x @p K matrix.
+	size_t gemm_packed_a_size(const int M, const int K);
+
+	/** Pack all of @p A (scaled by @p ALPHA) into the panels used by the microkernel, so the same matrix can be given to
+	 * @ref gemm_prepacked() many times without being packed again.  The layout depends on the microkernel chosen at
+	 * runtime, so the results must never be saved to disk.  @p packed must have room for @ref gemm_packed_a_size().
+	 */
+	void gemm_pack_a(int TA, int M, int K, float ALPHA, const float * A, int lda, float * packed);
+
+	/// Same as @ref gemm(), but @p A has already been packed by @ref gemm_pack_a().
+	void gemm_prepacked(int TB, int M, int N, int K, const float * packed_a, const float * B, int ldb, float BETA, float * C, int ldc, const GemmEpilogue & epilogue = GemmEpilogue());
+
+	/** Describes how to read B directly from an image when the GEMM is used for a convolution.  B is the matrix which
+	 * @ref im2col_cpu_ext() would have written out, with one row per channel and kernel position, and one column per
+	 * output pixel.  The values are gathered while B is packed, so the matrix itself never exists in memory.
+	 *
+	 * @since 2026-10-17
+	 */
+	struct GemmConvInput final
+	{
+		const float * image;	///< @p channels x @p height x @p width
+		int channels;
+		int height;
+		int width;
+		int kernel_h;
+		int kernel_w;
+		int pad_h;
+		int pad_w;
+		int stride_h;
+		int stride_w;
+		int dilation_h;
+		int dilation_w;
+		int out_h;
+		int out_w;
+	};
+
+	/** Implicit GEMM convolution.  Same as @ref gemm() without any transpose, except B is read from @p input as described
+	 * in @ref GemmConvInput.  @p N must be @p out_h * @p out_w and @p K must be @p channels * @p kernel_h * @p kernel_w.
+	 * When @p packed_a is not @p nullptr it must have been packed by @ref gemm_pack_a(), and @p ALPHA, @p A, and @p lda
+	 * are ignored.
+	 */
+	void gemm_conv(int M, int N, int K, float ALPHA, const float * A, int lda, const float * packed_a, const GemmConvInput & input, float BETA, float * C, int ldc, const GemmEpilogue & epilogue = GemmEpilogue());
+
+	/// Returns @p true if @ref winograd_conv() can be used for this convolution, meaning a 3x3 kernel with a stride of 1.
+	bool winograd_supported(const GemmConvInput & input);
+
+	/// The number of @p float needed by @ref winograd_transform_filters() for @p M filters with @p C channels.
+	size_t winograd_filters_size(const int M, const int C);
+
+	/** Transform @p M 3x3 filters with @p C channels each into the layout used by @ref winograd_conv().  Like
+	 * @ref gemm_pack_a() the layout depends on the microkernel chosen at runtime, so it must never be saved to disk.
+	 * @p transformed must have room for @ref winograd_filters_size().
+	 */
+	void winograd_transform_filters(const int M, const int C, const float * weights, float * transformed);
+
+	/** The number of bytes of workspace needed by @ref winograd_conv() for @p M filters when the tiles are split across
+	 * @p threads threads.  Each thread has its own aligned slice for the transformed input tiles and the results of the
+	 * 36 GEMMs.
+	 */
+	size_t winograd_workspace_size(const int M, const GemmConvInput & input, const int threads);
+
+	/** Winograd F(4x4,3x3) convolution.  Gives the same results as @ref gemm_conv() with @p ALPHA = 1 and @p BETA = 0
+	 * for @p M filters which have been transformed by @ref winograd_transform_filters(), but with a quarter of the
+	 * multiplications.  The results are not exact, since the transforms add some rounding errors.  The epilogue is
+	 * called for each filter on a block of complete output rows.  @see @ref winograd_supported()
+	 *
+	 * The tiles are split across @p threads threads, which is usually 1 when called from within a parallel region.
+	 * @p workspace must have room for @ref winograd_workspace_size() with the same number of threads.
+	 */
+	void winograd_conv(const int M, const float * transformed, const GemmConvInput & input, float * workspace, const int threads, float * C, const int ldc, const GemmEpilogue & epilogue = GemmEpilogue());
+
+	/** Direct convolution for depthwise and grouped layers, where the GEMM of each group would be too small to be
+	 * efficient.  @p input describes a single group, but @p image points to the first channel of the first group and the
+	 * groups follow each other.  Each of the @p groups has @p M filters, and the filters are stored one after the other
+	 * in @p weights just like @ref Layer::weights.  Filter @p f is written to @p C + @p f * @p ldc, overwriting what was
+	 * there.  The epilogue is called once for each filter with @p row set to @p f, and is given the complete output.
+	 */
+	void grouped_conv(const int groups, const int M, const float * weights, const GemmConvInput & input, float * C, const int ldc, const GemmEpilogue & epilogue = GemmEpilogue());
+
+	/** Simple version of @ref gemm() which only splits the rows of @p C across the OpenMP threads.  This is what the
+	 * original code used, and can be used to verify the results of @ref gemm().
+	 */
+	void gemm_reference(int TA, int TB, int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float BETA, float * C, int ldc);
+
+	/** The number of blocks of @p C which @ref gemm() can give to different OpenMP threads at the same time for an
+	 * @p M x @p N result.  When this is smaller than the number of threads, some of them have nothing to do.
+	 */
+	int gemm_parallel_blocks(const int M, const int N);
+
+	/// The name of the microkernel used by @ref gemm(), such as @p "avx2 6x16".  This is chosen at runtime via CPUID.
+	std::string gemm_kernel_name();
+
+	/// @{ The individual GEMM kernels called by @ref gemm_reference().  These add to @p C.
+	void gemm_nn(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc);
+	void gemm_nt(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc);
+	void gemm_tn(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc);
+	void gemm_tt(int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float * C, int ldc);
+	/// @}
+
+	/// Returns @p true if the CPU supports AVX.  @see @ref get_cpu_features()
+	bool is_avx();
+
+	/// Returns @p true if the CPU supports both FMA and AVX2.
+	bool is_fma_avx2();
+
+	/// Returns @p true if the CPU supports the AVX-512 foundation instructions.
+	bool is_avx512();
+
+	/// Get a single pixel from the image, or zero if the coordinates are in the padding.
+	float im2col_get_pixel(const float * im, int height, int width, int channels, int row, int col, int channel, int pad);
 
 	/// From Berkeley Vision's Caffe!  https://github.com/BVLC/caffe/blob/master/LICENSE
-	void im2col_cpu_custom(float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
+	void im2col_cpu(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
+
+	void repack_input(const float * input, float * re_packed_input, int w, int h, int c);
+	void float_to_bit(const float * src, unsigned char * dst, const size_t size);
+
+	/// From Berkeley Vision's Caffe!  https://github.com/BVLC/caffe/blob/master/LICENSE
+	void im2col_cpu_custom(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col);
 
 	void transpose_uint32(uint32_t * src, uint32_t * dst, int src_h, int src_w, int src_align, int dst_align);
 
-	/** 5x times faster than gemm()-float32.
+	/// Transpose a bit matrix 32 bits at a time.
+	void transpose_bin(uint32_t * A, uint32_t * B, const int n, const int m, const int lda, const int ldb, const int block_size);
+
+	/** The XNOR GEMM of the binary layers:  each value of C is the number of matching bits in a row of @p A and a row of
+	 * the transposed @p B, scaled by the mean of the filter.  @p lda and @p ldb are in bits, and the rows are padded with
+	 * zeros to a multiple of 256 bits.  Uses AVX-512 VPOPCNTDQ or AVX2 when the CPU has them, see @ref get_kernels().
 	 * @todo Further optimizations: do mean-mult only for the last layer
 	 */
 	void gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr);
 
 	/// Two versions of this function exists -- CPU and GPU.
-	void im2col_cpu_custom_bin(float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align);
+	void im2col_cpu_custom_bin(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align);
+
+	static inline void set_bit(unsigned char * const dst, const size_t index)
+	{
+		dst[index / 8] |= 1 << (index % 8);
+	}
+
+	static inline unsigned char get_bit(const unsigned char * const src, const size_t index)
+	{
+		return (src[index / 8] & (1 << (index % 8))) > 0;
+	}
 }
@@ -0,0 +1,313 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include "darknet-ng.hpp"
+
+
+/* The XNOR GEMM used by the binary convolutional layers.  See gemm_nn_custom_bin_mean_transposed().
+ *
+ * Each row of A holds the bits of one filter, and each row of B -- which is already transposed -- holds the bits of one
+ * output pixel.  Both are padded with zeros to a multiple of 256 bits.  XNOR counts the bits which are the same, but
+ * here the bits which differ are counted instead, since the padding is the same in A and B and so never adds to that
+ * count.  With D differences out of K bits, the result is (2 * (K - D) - K) * mean = (K - 2 * D) * mean, which is the
+ * same number as the original kernel.
+ *
+ * The microkernels compute a tile of MR rows of A by NR rows of B, so every row loaded into a register is used MR or NR
+ * times.  Only the microkernels are compiled for AVX2 or AVX-512, and they are called once per tile, which costs little
+ * next to the loop over K.  The tiles are grouped into blocks of kBinBlockN rows of B, which stay in L2 while the rows
+ * of A go past them, and the blocks are split across the threads together with the tiles of M.
+ */
+
+
+#if DNG_X86
+
+#include <immintrin.h>
+
+
+namespace
+{
+	/// Rows of B in each block.  With the largest filters of yolov3-tiny_xnor -- 4608 bits -- a block is 36 KiB.
+	constexpr int kBinBlockN = 64;
+
+	/// Multiplications smaller than this many bit operations are done on a single thread, since waking up the other threads costs more.
+	constexpr size_t kBinMinParallelSize = 1024 * 1024;
+
+
+	/** PSHUFB popcount (Mula):  each nibble is looked up in a table of 16 bytes.  The counts are kept per byte and only
+	 * added up into 64-bit counters once in a while, since a byte can take 31 chunks of 8 bits before it overflows.
+	 * The loops over the tile are unrolled so the counters stay in registers.
+	 */
+	struct AVX2 final
+	{
+		static constexpr int MR = 4;
+		static constexpr int NR = 2;
+
+		/// Number of 256-bit chunks after which the byte counters must be added up.
+		static constexpr int kFlush = 31;
+
+		template <int TILE_M, int TILE_N>
+		__attribute__((target("avx2")))
+		static void tile(const unsigned char * A, const size_t lda, const unsigned char * B, const size_t ldb, const int K, int64_t (&differences)[TILE_M][TILE_N])
+		{
+			const __m256i lookup	= _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+			const __m256i low_mask	= _mm256_set1_epi8(0x0f);
+			const __m256i zero		= _mm256_setzero_si256();
+
+			__m256i total[TILE_M * TILE_N];
+			#pragma GCC unroll 16
+			for (int t = 0; t < TILE_M * TILE_N; t ++)
+			{
+				total[t] = zero;
+			}
+
+			// the rows are padded to a multiple of 256 bits, so the last chunk can be read whole
+			const int chunks = (K + 255) / 256;
+			for (int start = 0; start < chunks; start += kFlush)
+			{
+				const int end = std::min(chunks, start + kFlush);
+
+				__m256i count[TILE_M * TILE_N];
+				#pragma GCC unroll 16
+				for (int t = 0; t < TILE_M * TILE_N; t ++)
+				{
+					count[t] = zero;
+				}
+
+				for (int chunk = start; chunk < end; chunk ++)
+				{
+					__m256i b[TILE_N];
+					#pragma GCC unroll 4
+					for (int c = 0; c < TILE_N; c ++)
+					{
+						b[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(B + c * ldb + chunk * 32));
+					}
+
+					#pragma GCC unroll 4
+					for (int r = 0; r < TILE_M; r ++)
+					{
+						const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(A + r * lda + chunk * 32));
+
+						#pragma GCC unroll 4
+						for (int c = 0; c < TILE_N; c ++)
+						{
+							const __m256i x		= _mm256_xor_si256(a, b[c]);
+							const __m256i lo	= _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+							const __m256i hi	= _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+							count[r * TILE_N + c] = _mm256_add_epi8(count[r * TILE_N + c], _mm256_add_epi8(lo, hi));
+						}
+					}
+				}
+
+				#pragma GCC unroll 16
+				for (int t = 0; t < TILE_M * TILE_N; t ++)
+				{
+					total[t] = _mm256_add_epi64(total[t], _mm256_sad_epu8(count[t], zero));
+				}
+			}
+
+			int64_t * out = &differences[0][0];
+			int t = 0;
+			#pragma GCC unroll 4
+			for (; t + 4 <= TILE_M * TILE_N; t += 4)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + t), reduce4(total + t));
+			}
+			#pragma GCC unroll 4
+			for (; t < TILE_M * TILE_N; t ++)
+			{
+				alignas(32) int64_t lanes[4];
+				_mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total[t]);
+				out[t] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+			}
+
+			return;
+		}
+
+		/// Add up the lanes of 4 counters at once.  Lane @p i of the result is the sum of @p v[i].
+		__attribute__((target("avx2"), always_inline))
+		static inline __m256i reduce4(const __m256i * v)
+		{
+			// each 128-bit half holds the sum of that half of v[0] and v[1], or of v[2] and v[3]
+			const __m256i t0 = _mm256_add_epi64(_mm256_unpacklo_epi64(v[0], v[1]), _mm256_unpackhi_epi64(v[0], v[1]));
+			const __m256i t1 = _mm256_add_epi64(_mm256_unpacklo_epi64(v[2], v[3]), _mm256_unpackhi_epi64(v[2], v[3]));
+
+			return _mm256_add_epi64(_mm256_permute2x128_si256(t0, t1, 0x20), _mm256_permute2x128_si256(t0, t1, 0x31));
+		}
+	};
+
+
+	/** VPOPCNTDQ counts the bits of each 64-bit lane in a single instruction.  The rows are only padded to a multiple of
+	 * 256 bits, so the last chunk of 512 bits may need a masked load.
+	 */
+	struct AVX512 final
+	{
+		static constexpr int MR = 4;
+		static constexpr int NR = 4;
+
+		template <int TILE_M, int TILE_N>
+		__attribute__((target("avx512f,avx512vpopcntdq")))
+		static void tile(const unsigned char * A, const size_t lda, const unsigned char * B, const size_t ldb, const int K, int64_t (&differences)[TILE_M][TILE_N])
+		{
+			__m512i total[TILE_M * TILE_N];
+			#pragma GCC unroll 16
+			for (int t = 0; t < TILE_M * TILE_N; t ++)
+			{
+				total[t] = _mm512_setzero_si512();
+			}
+
+			const int words = (K + 63) / 64;
+			for (int word = 0; word < words; word += 8)
+			{
+				const __mmask8 mask = (words - word >= 8 ? 0xff : (1u << (words - word)) - 1);
+
+				__m512i b[TILE_N];
+				#pragma GCC unroll 4
+				for (int c = 0; c < TILE_N; c ++)
+				{
+					b[c] = _mm512_maskz_loadu_epi64(mask, B + c * ldb + word * 8);
+				}
+
+				#pragma GCC unroll 4
+				for (int r = 0; r < TILE_M; r ++)
+				{
+					const __m512i a = _mm512_maskz_loadu_epi64(mask, A + r * lda + word * 8);
+
+					#pragma GCC unroll 4
+					for (int c = 0; c < TILE_N; c ++)
+					{
+						total[r * TILE_N + c] = _mm512_add_epi64(total[r * TILE_N + c], _mm512_popcnt_epi64(_mm512_xor_si512(a, b[c])));
+					}
+				}
+			}
+
+			int64_t * out = &differences[0][0];
+			int t = 0;
+			#pragma GCC unroll 2
+			for (; t + 8 <= TILE_M * TILE_N; t += 8)
+			{
+				_mm512_storeu_si512(out + t, reduce8(total + t));
+			}
+			#pragma GCC unroll 4
+			for (; t < TILE_M * TILE_N; t ++)
+			{
+				// same as _mm512_reduce_add_epi64(), which makes GCC 12 warn about an uninitialized variable
+				alignas(64) int64_t lanes[8];
+				_mm512_store_si512(lanes, total[t]);
+				out[t] = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+			}
+
+			return;
+		}
+
+		/// Add up the lanes of 8 counters at once.  Lane @p i of the result is the sum of @p v[i].
+		__attribute__((target("avx512f"), always_inline))
+		static inline __m512i reduce8(const __m512i * v)
+		{
+			/* The masked versions of the shuffles are used with every lane selected, since the plain ones start from an
+			 * undefined register which makes GCC 12 warn about an uninitialized variable.  Same for the reduction above.
+			 */
+			constexpr __mmask8 all = 0xff;
+
+			// each 128-bit lane holds the sum of that lane of a pair of counters
+			const __m512i t0 = _mm512_add_epi64(_mm512_maskz_unpacklo_epi64(all, v[0], v[1]), _mm512_maskz_unpackhi_epi64(all, v[0], v[1]));
+			const __m512i t1 = _mm512_add_epi64(_mm512_maskz_unpacklo_epi64(all, v[2], v[3]), _mm512_maskz_unpackhi_epi64(all, v[2], v[3]));
+			const __m512i t2 = _mm512_add_epi64(_mm512_maskz_unpacklo_epi64(all, v[4], v[5]), _mm512_maskz_unpackhi_epi64(all, v[4], v[5]));
+			const __m512i t3 = _mm512_add_epi64(_mm512_maskz_unpacklo_epi64(all, v[6], v[7]), _mm512_maskz_unpackhi_epi64(all, v[6], v[7]));
+
+			// then add the even 128-bit lanes to the odd ones, twice
+			const __m512i u0 = _mm512_add_epi64(_mm512_maskz_shuffle_i64x2(all, t0, t1, 0x88), _mm512_maskz_shuffle_i64x2(all, t0, t1, 0xdd));
+			const __m512i u1 = _mm512_add_epi64(_mm512_maskz_shuffle_i64x2(all, t2, t3, 0x88), _mm512_maskz_shuffle_i64x2(all, t2, t3, 0xdd));
+
+			return _mm512_add_epi64(_mm512_maskz_shuffle_i64x2(all, u0, u1, 0x88), _mm512_maskz_shuffle_i64x2(all, u0, u1, 0xdd));
+		}
+	};
+
+
+	/// Compute one tile of C and scale each row by its mean.
+	template <typename ISA, int TILE_M, int TILE_N>
+	inline void store_tile(const int i, const int j, const int K, const unsigned char * A, const size_t lda, const unsigned char * B, const size_t ldb, float * C, const int ldc, const float * mean_arr)
+	{
+		int64_t differences[TILE_M][TILE_N];
+		ISA::template tile<TILE_M, TILE_N>(A + i * lda, lda, B + j * ldb, ldb, K, differences);
+
+		for (int r = 0; r < TILE_M; r ++)
+		{
+			for (int c = 0; c < TILE_N; c ++)
+			{
+				C[(i + r) * ldc + j + c] = (K - 2 * static_cast<int>(differences[r][c])) * mean_arr[i + r];
+			}
+		}
+
+		return;
+	}
+
+
+	/// Split C into tiles of @p ISA::MR by @p ISA::NR values.  The rows and columns left over are done one value at a time.
+	template <typename ISA>
+	void gemm_bin(const int M, const int N, const int K, const unsigned char * A, const int lda, const unsigned char * B, const int ldb, float * C, const int ldc, const float * mean_arr)
+	{
+		constexpr int MR = ISA::MR;
+		constexpr int NR = ISA::NR;
+
+		// lda and ldb are in bits
+		const size_t lda_bytes	= lda / 8;
+		const size_t ldb_bytes	= ldb / 8;
+		const int m_tiles		= (M + MR - 1) / MR;
+		const int n_blocks		= (N + kBinBlockN - 1) / kBinBlockN;
+
+		#pragma omp parallel for collapse(2) schedule(static) if (static_cast<size_t>(M) * N * K >= kBinMinParallelSize)
+		for (int block = 0; block < n_blocks; block ++)
+		{
+			for (int m_tile = 0; m_tile < m_tiles; m_tile ++)
+			{
+				const int i			= m_tile * MR;
+				const int j_start	= block * kBinBlockN;
+				const int j_end		= std::min(N, j_start + kBinBlockN);
+
+				if (i + MR <= M)
+				{
+					int j = j_start;
+					for (; j + NR <= j_end; j += NR)
+					{
+						store_tile<ISA, MR, NR>(i, j, K, A, lda_bytes, B, ldb_bytes, C, ldc, mean_arr);
+					}
+					for (; j < j_end; j ++)
+					{
+						store_tile<ISA, MR, 1>(i, j, K, A, lda_bytes, B, ldb_bytes, C, ldc, mean_arr);
+					}
+				}
+				else
+				{
+					for (int row = i; row < M; row ++)
+					{
+						for (int j = j_start; j < j_end; j ++)
+						{
+							store_tile<ISA, 1, 1>(row, j, K, A, lda_bytes, B, ldb_bytes, C, ldc, mean_arr);
+						}
+					}
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+
+void Darknet_ng::avx2::gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr)
+{
+	gemm_bin<AVX2>(M, N, K, A, lda, B, ldb, C, ldc, mean_arr);
+
+	return;
+}
+
+
+void Darknet_ng::avx512::gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr)
+{
+	gemm_bin<AVX512>(M, N, K, A, lda, B, ldb, C, ldc, mean_arr);
+
+	return;
+}
+
+#endif
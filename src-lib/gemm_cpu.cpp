@@ -3,12 +3,12 @@
 
 #include "darknet-ng.hpp"
 
-#ifndef GPU /// @todo where to set GPU so we only include one of CPU or GPU?
+// these are the portable versions of the functions in gemm_avx.cpp, see get_kernels()
 
 
 //From Berkeley Vision's Caffe!
 //https://github.com/BVLC/caffe/blob/master/LICENSE
-void Darknet_ng::im2col_cpu_custom_bin(float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align)
+void Darknet_ng::portable::im2col_cpu_custom_bin(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col, int bit_align)
 {
 	int c;
 	const int height_col = (height + 2 * pad - ksize) / stride + 1;
@@ -116,27 +116,63 @@ void Darknet_ng::im2col_cpu_custom_bin(float * data_im, int channels, int height
 }
 
 
-void Darknet_ng::activate_array_cpu_custom(float * x, const int n, const Darknet_ng::EActivation a)
+void Darknet_ng::portable::float_to_bit(const float * src, unsigned char * dst, const size_t size)
 {
-	if (a == EActivation::kLinear)
-	{
-	}
-	else if (a == EActivation::kLeaky)
+	const size_t dst_size = size / 8 + 1;
+	memset(dst, 0, dst_size);
+
+	for (size_t i = 0; i < size; ++i)
 	{
-		for (int i = 0; i < n; ++i)
+		if (src[i] > 0.0f)
 		{
-			x[i] = (x[i]>0) ? x[i] : .1*x[i];
+			set_bit(dst, i);
 		}
 	}
-	else
-	{
-		for (int i = 0; i < n; ++i)
-		{
-			x[i] = activate(x[i], a);
+
+	return;
+}
+
+
+void Darknet_ng::portable::im2col_cpu_custom(const float * data_im, int channels, int height, int width, int ksize, int stride, int pad, float * data_col)
+{
+	// the original code also had an "optimized" version here, but it returned early and always called im2col_cpu()
+	im2col_cpu(data_im, channels, height, width, ksize, stride, pad, data_col);
+
+	return;
+}
+
+
+void Darknet_ng::portable::gemm_nn_custom_bin_mean_transposed(int M, int N, int K, float ALPHA_UNUSED, unsigned char * A, int lda, unsigned char * B, int ldb, float * C, int ldc, float * mean_arr)
+{
+	#pragma omp parallel for
+	for (int i = 0; i < M; ++i)
+	{   // l.n - filters [16 - 55 - 1024]
+		const float mean_val = mean_arr[i];
+
+		for (int j = 0; j < N; ++j)
+		{ // out_h*out_w - one channel output size [169 - 173056]
+			int count = 0;
+
+			for (int k = 0; k < K; k += 64)
+			{   // l.size*l.size*l.c - one filter size [27 - 9216]
+				uint64_t a_bit64;
+				uint64_t b_bit64;
+				memcpy(&a_bit64, A + (i * lda + k) / 8, sizeof(a_bit64));
+				memcpy(&b_bit64, B + (j * ldb + k) / 8, sizeof(b_bit64));
+				const uint64_t c_bit64 = ~(a_bit64 ^ b_bit64); // xnor
+
+				int tmp_count = __builtin_popcountll(c_bit64);
+
+				if (K - k < 64)
+				{
+					tmp_count = tmp_count - (64 - (K - k));    // remove extra bits
+				}
+				count += tmp_count;
+			}
+
+			C[i * ldc + j] = (2 * count - K) * mean_val;
 		}
 	}
 
 	return;
 }
-
-#endif
@@ -0,0 +1,145 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include "darknet-ng.hpp"
+
+
+/* Direct convolution for depthwise and grouped layers.
+ *
+ * When a layer has many groups each group only has a few channels and a few filters, so the GEMM for each group is
+ * tiny:  a depthwise layer has a single filter and a single channel per group, which is a GEMM with M=1 and K=9.  The
+ * packing and the microkernel are then all overhead.  Instead, each output row is computed by sliding every tap of the
+ * filter over the matching input row, so the innermost loop is a contiguous multiply-add the compiler turns into SIMD
+ * instructions, and the output row stays in L1 while all the taps are added to it.
+ */
+
+
+namespace
+{
+	/** Add one row of the filter to the output row @p out, where @p in is the matching row of the input and @p weights
+	 * are the @p input.kernel_w taps.  The pixels where every tap falls inside the image are done with a single pass
+	 * which keeps the sum in registers, and only the few pixels near the left and right edges check for the padding.
+	 */
+	template <int KW>
+	inline void accumulate_row(const Darknet_ng::GemmConvInput & input, float * out, const float * in, const float * weights)
+	{
+		const int kernel_w	= (KW > 0 ? KW : input.kernel_w);
+		const int stride	= input.stride_w;
+		const int dilation	= input.dilation_w;
+		const int pad		= input.pad_w;
+
+		// the output pixels for which all the taps are inside the image
+		const int x_start	= std::min(input.out_w, (pad + stride - 1) / stride);
+		const int x_end		= std::max(x_start, std::min(input.out_w, (input.width + pad - (kernel_w - 1) * dilation + stride - 1) / stride));
+
+		const auto edge = [&](const int x)
+		{
+			float sum = 0.0f;
+			for (int kx = 0; kx < kernel_w; ++kx)
+			{
+				const int ix = x * stride - pad + kx * dilation;
+				if (ix >= 0 and ix < input.width)
+				{
+					sum += weights[kx] * in[ix];
+				}
+			}
+			out[x] += sum;
+		};
+
+		for (int x = 0; x < x_start; ++x)
+		{
+			edge(x);
+		}
+
+		if (stride == 1 and dilation == 1)
+		{
+			const float * const base = in - pad;
+			#pragma omp simd
+			for (int x = x_start; x < x_end; ++x)
+			{
+				float sum = 0.0f;
+				for (int kx = 0; kx < kernel_w; ++kx)
+				{
+					sum += weights[kx] * base[x + kx];
+				}
+				out[x] += sum;
+			}
+		}
+		else
+		{
+			#pragma omp simd
+			for (int x = x_start; x < x_end; ++x)
+			{
+				const int ix = x * stride - pad;
+				float sum = 0.0f;
+				for (int kx = 0; kx < kernel_w; ++kx)
+				{
+					sum += weights[kx] * in[ix + kx * dilation];
+				}
+				out[x] += sum;
+			}
+		}
+
+		for (int x = x_end; x < input.out_w; ++x)
+		{
+			edge(x);
+		}
+
+		return;
+	}
+}
+
+
+void Darknet_ng::grouped_conv(const int groups, const int M, const float * weights, const Darknet_ng::GemmConvInput & input, float * C, const int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+{
+	const int channels		= input.channels;
+	const int taps			= input.kernel_h * input.kernel_w;
+	const int filters		= groups * M;
+	const size_t plane_size	= static_cast<size_t>(input.height) * input.width;
+	const int out_size		= input.out_h * input.out_w;
+
+	// the common kernel widths are unrolled so the sum of the taps becomes a few multiply-adds per SIMD register
+	auto accumulate = accumulate_row<0>;
+	if		(input.kernel_w == 3) accumulate = accumulate_row<3>;
+	else if	(input.kernel_w == 5) accumulate = accumulate_row<5>;
+	else if	(input.kernel_w == 7) accumulate = accumulate_row<7>;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int f = 0; f < filters; ++f)
+	{
+		const int group = f / M;
+		const float * const filter	= weights + static_cast<size_t>(f) * channels * taps;
+		const float * const image	= input.image + static_cast<size_t>(group) * channels * plane_size;
+		float * const output		= C + static_cast<size_t>(f) * ldc;
+
+		for (int y = 0; y < input.out_h; ++y)
+		{
+			float * const out = output + static_cast<size_t>(y) * input.out_w;
+			std::fill(out, out + input.out_w, 0.0f);
+
+			for (int ky = 0; ky < input.kernel_h; ++ky)
+			{
+				const int iy = y * input.stride_h - input.pad_h + ky * input.dilation_h;
+				if (iy < 0 or iy >= input.height)
+				{
+					continue;
+				}
+
+				for (int c = 0; c < channels; ++c)
+				{
+					const float * in = image + c * plane_size + static_cast<size_t>(iy) * input.width;
+					accumulate(input, out, in, filter + (c * input.kernel_h + ky) * input.kernel_w);
+				}
+			}
+		}
+
+		if (epilogue)
+		{
+			// the whole filter is complete and still in cache
+			epilogue(output, ldc, f, 0, 1, out_size);
+		}
+	}
+
+	return;
+}
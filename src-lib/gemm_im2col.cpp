@@ -0,0 +1,166 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include <cstring>
+#include "darknet-ng.hpp"
+
+
+/* im2col for the convolutional layers which still write out the im2col matrix.
+ *
+ * The original Caffe loop checks the bounds of every single pixel.  Instead, each row of the im2col matrix is made of
+ * one row of the input for each output row, so the bounds are worked out once per row:  rows which fall on the top or
+ * bottom padding are cleared, and the other rows are split into the left padding, the pixels which are inside the
+ * image, and the right padding.  With a stride of 1 the inside pixels are contiguous and are copied with memcpy(), and
+ * with other strides they are gathered by a loop the compiler turns into SIMD instructions.  The rows of the im2col
+ * matrix are independent, so they are split across the threads.
+ */
+
+
+namespace
+{
+	/// Matrices smaller than this many floats are done on a single thread, since waking up the other threads costs more.
+	constexpr size_t kIm2colMinParallelSize = 64 * 1024;
+
+	/** Write one row of the im2col matrix for a single output row.  @p in is the input row, and @p offset is the input
+	 * column read by output column 0, which is negative when there is padding on the left.
+	 */
+	template <int STRIDE>
+	inline void im2col_row(const float * in, const int width, const int offset, const int stride_w, const int output_w, float * out)
+	{
+		const int stride = (STRIDE > 0 ? STRIDE : stride_w);
+
+		// output columns [x_start, x_end) read from inside the input row
+		const int x_start	= std::min(output_w, (offset >= 0 ? 0 : (stride - 1 - offset) / stride));
+		const int x_end		= std::max(x_start, std::min(output_w, (width - offset + stride - 1) / stride));
+
+		std::fill(out, out + x_start, 0.0f);
+
+		if (stride == 1)
+		{
+			std::memcpy(out + x_start, in + offset + x_start, (x_end - x_start) * sizeof(float));
+		}
+		else
+		{
+			#pragma omp simd
+			for (int x = x_start; x < x_end; ++x)
+			{
+				out[x] = in[offset + x * stride];
+			}
+		}
+
+		std::fill(out + x_end, out + output_w, 0.0f);
+
+		return;
+	}
+}
+
+
+void Darknet_ng::im2col_cpu_ext(
+		const float * data_im, const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
+		const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int dilation_h, const int dilation_w,
+		float * data_col)
+{
+	const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+	const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+	const size_t channel_size	= static_cast<size_t>(height) * width;
+	const size_t col_size		= static_cast<size_t>(output_h) * output_w;
+	const int rows				= channels * kernel_h * kernel_w;
+
+	// strides of 1 and 2 are by far the most common, and knowing the stride lets the compiler vectorize the gather
+	const auto copy_row = (stride_w == 1 ? im2col_row<1> : stride_w == 2 ? im2col_row<2> : im2col_row<0>);
+
+	#pragma omp parallel for schedule(static) if (rows * col_size >= kIm2colMinParallelSize)
+	for (int row = 0; row < rows; ++row)
+	{
+		const int kernel_col	= row % kernel_w;
+		const int kernel_row	= (row / kernel_w) % kernel_h;
+		const int channel		= row / kernel_w / kernel_h;
+		const float * im		= data_im + channel * channel_size;
+		const int offset		= kernel_col * dilation_w - pad_w;
+		float * out				= data_col + row * col_size;
+
+		for (int y = 0; y < output_h; ++y)
+		{
+			const int input_row = kernel_row * dilation_h - pad_h + y * stride_h;
+			if (input_row < 0 or input_row >= height)
+			{
+				std::fill(out, out + output_w, 0.0f);
+			}
+			else
+			{
+				copy_row(im + input_row * width, width, offset, stride_w, output_w, out);
+			}
+			out += output_w;
+		}
+	}
+
+	return;
+}
+
+
+// Function uses casting from int to unsigned to compare if value of
+// parameter a is greater or equal to zero and lower than value of
+// parameter b. The b parameter is of type signed and is always positive,
+// therefore its value is always lower than 0x800... where casting
+// negative value of a parameter converts it to value higher than 0x800...
+// The casting allows to use one condition instead of two.
+inline static int is_a_ge_zero_and_a_lt_b(int a, int b)
+{
+	return (unsigned)(a) < (unsigned)(b);
+}
+
+
+void Darknet_ng::im2col_cpu_ext_reference(
+		const float * data_im, const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
+		const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int dilation_h, const int dilation_w,
+		float * data_col)
+{
+	// was: void im2col_cpu_ext(...)
+
+	const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+	const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+	const int channel_size = height * width;
+
+//	int channel, kernel_row, kernel_col, output_rows, output_col;
+
+	for (int channel = channels; channel--; data_im += channel_size)
+	{
+		for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++)
+		{
+			for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++)
+			{
+				int input_row = -pad_h + kernel_row * dilation_h;
+				for (int output_rows = output_h; output_rows; output_rows--)
+				{
+					if (!is_a_ge_zero_and_a_lt_b(input_row, height))
+					{
+						for (int output_col = output_w; output_col; output_col--)
+						{
+							*(data_col++) = 0;
+						}
+					}
+					else
+					{
+						int input_col = -pad_w + kernel_col * dilation_w;
+						for (int output_col = output_w; output_col; output_col--)
+						{
+							if (is_a_ge_zero_and_a_lt_b(input_col, width))
+							{
+								*(data_col++) = data_im[input_row * width + input_col];
+							}
+							else
+							{
+								*(data_col++) = 0;
+							}
+							input_col += stride_w;
+						}
+					}
+					input_row += stride_h;
+				}
+			}
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,559 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include "darknet-ng.hpp"
+
+#if DNG_X86
+#include <immintrin.h>
+#endif
+
+
+/* This is a BLIS-style GEMM.  The loops from the outside in are:
+ *
+ *		jc:  columns of B and C, @p nc at a time (the packed panel of B lives in L3)
+ *		pc:  the shared dimension K, @p kc at a time (A and B are packed for each block, unless A was packed ahead of time)
+ *		tile:  blocks of C which are @p mc rows by @p nt columns, distributed across the OpenMP threads
+ *		jr:  columns within the tile, @p nr at a time (the micro-panel of B lives in L1)
+ *		ir:  rows within the tile, @p mr at a time (the block of A lives in L2)
+ *
+ * The innermost step is the microkernel which multiplies a @p mr x @p kc micro-panel of A by a @p kc x @p nr micro-panel
+ * of B, keeping the entire @p mr x @p nr result in registers.
+ */
+
+
+namespace
+{
+	/// The microkernel adds (or stores when @p accumulate is @p false) the @p mr x @p nr product of the packed panels to @p c.
+	using MicroKernelFn = void(*)(const int kc, const float * a, const float * b, float * c, const int ldc, const bool accumulate);
+
+	/// Description of a microkernel and the block sizes which suit it.
+	struct MicroKernel final
+	{
+		const char *	name;
+		int				mr;		///< rows of C computed by each call
+		int				nr;		///< columns of C computed by each call
+		int				mc;		///< rows in each block of A (multiple of @p mr)
+		int				kc;		///< depth of each block
+		int				nc;		///< columns in each block of B (multiple of @p nt)
+		int				nt;		///< columns in each tile given to a thread (multiple of @p nr)
+		MicroKernelFn	fn;
+	};
+
+	/// Largest @p mr * @p nr of all the microkernels, used to size the buffer for partial tiles.
+	const int kMaxTile = 8 * 32;
+
+
+	/// Portable microkernel.  The compiler should be able to vectorize the inner loop over the columns.
+	void kernel_scalar_4x16(const int kc, const float * a, const float * b, float * c, const int ldc, const bool accumulate)
+	{
+		float acc[4][16] = {};
+
+		for (int p = 0; p < kc; ++p)
+		{
+			for (int r = 0; r < 4; ++r)
+			{
+				const float a_val = a[r];
+				for (int j = 0; j < 16; ++j)
+				{
+					acc[r][j] += a_val * b[j];
+				}
+			}
+			a += 4;
+			b += 16;
+		}
+
+		for (int r = 0; r < 4; ++r)
+		{
+			float * c_row = c + r * ldc;
+			for (int j = 0; j < 16; ++j)
+			{
+				c_row[j] = (accumulate ? c_row[j] : 0.0f) + acc[r][j];
+			}
+		}
+
+		return;
+	}
+
+
+#if DNG_X86
+	/// 6 rows by 2 x 8 columns uses 12 of the 16 ymm registers for the result.
+	__attribute__((target("avx2,fma")))
+	void kernel_avx2_6x16(const int kc, const float * a, const float * b, float * c, const int ldc, const bool accumulate)
+	{
+		__m256 acc[6][2];
+		#pragma GCC unroll 6
+		for (int r = 0; r < 6; ++r)
+		{
+			acc[r][0] = _mm256_setzero_ps();
+			acc[r][1] = _mm256_setzero_ps();
+		}
+
+		for (int p = 0; p < kc; ++p)
+		{
+			const __m256 b0 = _mm256_loadu_ps(b);
+			const __m256 b1 = _mm256_loadu_ps(b + 8);
+
+			#pragma GCC unroll 6
+			for (int r = 0; r < 6; ++r)
+			{
+				const __m256 a_val = _mm256_broadcast_ss(a + r);
+				acc[r][0] = _mm256_fmadd_ps(a_val, b0, acc[r][0]);
+				acc[r][1] = _mm256_fmadd_ps(a_val, b1, acc[r][1]);
+			}
+			a += 6;
+			b += 16;
+		}
+
+		#pragma GCC unroll 6
+		for (int r = 0; r < 6; ++r)
+		{
+			float * c_row = c + r * ldc;
+			if (accumulate)
+			{
+				acc[r][0] = _mm256_add_ps(acc[r][0], _mm256_loadu_ps(c_row));
+				acc[r][1] = _mm256_add_ps(acc[r][1], _mm256_loadu_ps(c_row + 8));
+			}
+			_mm256_storeu_ps(c_row		, acc[r][0]);
+			_mm256_storeu_ps(c_row + 8	, acc[r][1]);
+		}
+
+		return;
+	}
+
+
+	/// 8 rows by 2 x 16 columns uses 16 of the 32 zmm registers for the result.
+	__attribute__((target("avx512f")))
+	void kernel_avx512_8x32(const int kc, const float * a, const float * b, float * c, const int ldc, const bool accumulate)
+	{
+		__m512 acc[8][2];
+		#pragma GCC unroll 8
+		for (int r = 0; r < 8; ++r)
+		{
+			acc[r][0] = _mm512_setzero_ps();
+			acc[r][1] = _mm512_setzero_ps();
+		}
+
+		for (int p = 0; p < kc; ++p)
+		{
+			const __m512 b0 = _mm512_loadu_ps(b);
+			const __m512 b1 = _mm512_loadu_ps(b + 16);
+
+			#pragma GCC unroll 8
+			for (int r = 0; r < 8; ++r)
+			{
+				const __m512 a_val = _mm512_set1_ps(a[r]);
+				acc[r][0] = _mm512_fmadd_ps(a_val, b0, acc[r][0]);
+				acc[r][1] = _mm512_fmadd_ps(a_val, b1, acc[r][1]);
+			}
+			a += 8;
+			b += 32;
+		}
+
+		#pragma GCC unroll 8
+		for (int r = 0; r < 8; ++r)
+		{
+			float * c_row = c + r * ldc;
+			if (accumulate)
+			{
+				acc[r][0] = _mm512_add_ps(acc[r][0], _mm512_loadu_ps(c_row));
+				acc[r][1] = _mm512_add_ps(acc[r][1], _mm512_loadu_ps(c_row + 16));
+			}
+			_mm512_storeu_ps(c_row		, acc[r][0]);
+			_mm512_storeu_ps(c_row + 16	, acc[r][1]);
+		}
+
+		return;
+	}
+#endif
+
+
+	/// Pick the fastest microkernel supported by this CPU.  This only happens once.
+	const MicroKernel & get_microkernel()
+	{
+		static const MicroKernel kernel = []() -> MicroKernel
+		{
+			//						name			mr	nr	mc	kc	nc		nt	fn
+#if DNG_X86
+			if (Darknet_ng::is_avx512())
+			{
+				return MicroKernel {	"avx512 8x32",	8,	32,	96,	256,	4096,	256,	kernel_avx512_8x32	};
+			}
+			if (Darknet_ng::is_fma_avx2())
+			{
+				return MicroKernel {	"avx2 6x16",	6,	16,	96,	256,	4096,	256,	kernel_avx2_6x16	};
+			}
+#endif
+			return MicroKernel {		"scalar 4x16",	4,	16,	64,	256,	4096,	256,	kernel_scalar_4x16	};
+		}();
+
+		return kernel;
+	}
+
+
+	/** Copy @p mr rows of the @p kc columns of A starting at (@p row, @p col) so each column of the micro-panel is
+	 * contiguous.  Rows past the end of A are set to zero.  @p ALPHA is applied here so the microkernel doesn't need to.
+	 */
+	void pack_a(const bool TA, const float * A, const int lda, const int M, const int row, const int col, const int kc, const int mr, const float ALPHA, float * dst)
+	{
+		const int rows = std::min(mr, M - row);
+
+		for (int p = 0; p < kc; ++p)
+		{
+			int r = 0;
+			for (; r < rows; ++r)
+			{
+				const float val = TA ? A[(col + p) * lda + row + r] : A[(row + r) * lda + col + p];
+				dst[r] = ALPHA * val;
+			}
+			for (; r < mr; ++r)
+			{
+				dst[r] = 0.0f;
+			}
+			dst += mr;
+		}
+
+		return;
+	}
+
+
+	/// Copy @p kc rows of @p nr columns of B starting at (@p row, @p col) so each row of the micro-panel is contiguous.
+	void pack_b(const bool TB, const float * B, const int ldb, const int N, const int row, const int col, const int kc, const int nr, float * dst)
+	{
+		const int cols = std::min(nr, N - col);
+
+		for (int p = 0; p < kc; ++p)
+		{
+			int j = 0;
+			if (TB)
+			{
+				for (; j < cols; ++j)
+				{
+					dst[j] = B[(col + j) * ldb + row + p];
+				}
+			}
+			else
+			{
+				const float * src = B + (row + p) * ldb + col;
+				for (; j < cols; ++j)
+				{
+					dst[j] = src[j];
+				}
+			}
+			for (; j < nr; ++j)
+			{
+				dst[j] = 0.0f;
+			}
+			dst += nr;
+		}
+
+		return;
+	}
+
+
+	/** Same as @ref pack_b(), but B is the im2col matrix of the image.  Each row of B is one channel and kernel position,
+	 * and each column is one output pixel, so the values can be gathered directly from the image.
+	 */
+	void pack_b_conv(const Darknet_ng::GemmConvInput & in, const int N, const int row, const int col, const int kc, const int nr, float * dst)
+	{
+		const int cols			= std::min(nr, N - col);
+		const int kernel_size	= in.kernel_h * in.kernel_w;
+
+		// output coordinates of the first column in this panel
+		const int first_y = col / in.out_w;
+		const int first_x = col % in.out_w;
+
+		for (int p = 0; p < kc; ++p)
+		{
+			const int k			= row + p;
+			const int channel	= k / kernel_size;
+			const int ky		= (k / in.kernel_w) % in.kernel_h;
+			const int kx		= k % in.kernel_w;
+			const int y_offset	= ky * in.dilation_h - in.pad_h;
+			const int x_offset	= kx * in.dilation_w - in.pad_w;
+			const float * plane	= in.image + static_cast<size_t>(channel) * in.height * in.width;
+
+			// the columns are processed one output row at a time, since each of those reads a single row of the image
+			int out_y = first_y;
+			int out_x = first_x;
+			int j = 0;
+			while (j < cols)
+			{
+				const int count	= std::min(cols - j, in.out_w - out_x);
+				const int y		= out_y * in.stride_h + y_offset;
+				float * out		= dst + j;
+
+				if (y < 0 or y >= in.height)
+				{
+					std::fill(out, out + count, 0.0f);
+				}
+				else if (in.stride_w == 1)
+				{
+					// contiguous pixels, so only the padding on the left and right needs to be handled
+					const float * src	= plane + y * in.width;
+					const int x			= out_x + x_offset;
+					const int first		= std::clamp(-x, 0, count);
+					const int last		= std::clamp(in.width - x, first, count);
+					std::fill(out, out + first, 0.0f);
+					std::copy(src + x + first, src + x + last, out + first);
+					std::fill(out + last, out + count, 0.0f);
+				}
+				else
+				{
+					const float * src = plane + y * in.width;
+					for (int i = 0; i < count; ++i)
+					{
+						const int x = (out_x + i) * in.stride_w + x_offset;
+						out[i] = (x >= 0 and x < in.width) ? src[x] : 0.0f;
+					}
+				}
+
+				j		+= count;
+				out_x	+= count;
+				if (out_x == in.out_w)
+				{
+					out_x = 0;
+					out_y ++;
+				}
+			}
+			for (; j < nr; ++j)
+			{
+				dst[j] = 0.0f;
+			}
+			dst += nr;
+		}
+
+		return;
+	}
+
+
+	/** Everything done by @ref gemm(), @ref gemm_prepacked(), and @ref gemm_conv().  When @p prepacked is not @p nullptr
+	 * it contains all of A as packed by @ref gemm_pack_a(), and @p TA, @p A, @p lda, and @p ALPHA are ignored.  When
+	 * @p conv is not @p nullptr then B is gathered from the image, and @p TB, @p B, and @p ldb are ignored.
+	 */
+	void gemm_blocked(const int TA, const int TB, const int M, const int N, const int K, const float ALPHA, const float * A, const int lda, const float * prepacked, const float * B, const int ldb, const Darknet_ng::GemmConvInput * conv, const float BETA, float * C, const int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+	{
+		if (M < 1 or N < 1)
+		{
+			return;
+		}
+
+		if (BETA != 1.0f and BETA != 0.0f)
+		{
+			#pragma omp parallel for
+			for (int i = 0; i < M; ++i)
+			{
+				for (int j = 0; j < N; ++j)
+				{
+					C[i * ldc + j] *= BETA;
+				}
+			}
+		}
+
+		if (K < 1)
+		{
+			// nothing to multiply, but C must still be valid when BETA is zero
+			for (int i = 0; BETA == 0.0f and i < M; ++i)
+			{
+				std::fill(C + i * ldc, C + i * ldc + N, 0.0f);
+			}
+			if (epilogue)
+			{
+				epilogue(C, ldc, 0, 0, M, N);
+			}
+			return;
+		}
+
+		const MicroKernel & kernel = get_microkernel();
+		const int mr = kernel.mr;
+		const int nr = kernel.nr;
+
+		const int m_panels = (M + mr - 1) / mr;
+		const int m_tiles = (M + kernel.mc - 1) / kernel.mc;
+
+		// the packed panels belong to the calling thread, so several networks can run at the same time
+		thread_local std::vector<float> packed_a;
+		thread_local std::vector<float> packed_b;
+		if (prepacked == nullptr)
+		{
+			packed_a.resize(static_cast<size_t>(m_panels) * mr * kernel.kc);
+		}
+		packed_b.resize(static_cast<size_t>(kernel.kc) * kernel.nc);
+
+		float * const pa = packed_a.data();
+		const float * a_block = pa;
+		float * const pb = packed_b.data();
+
+		for (int jc = 0; jc < N; jc += kernel.nc)
+		{
+			const int nc = std::min(kernel.nc, N - jc);
+			const int n_panels = (nc + nr - 1) / nr;
+			const int n_tiles = (nc + kernel.nt - 1) / kernel.nt;
+
+			for (int pc = 0; pc < K; pc += kernel.kc)
+			{
+				const int kc = std::min(kernel.kc, K - pc);
+				const bool accumulate = (pc > 0 or BETA != 0.0f);
+				const bool last = (pc + kc >= K);
+				if (prepacked)
+				{
+					// all the blocks of A were packed ahead of time, one after the other
+					a_block = prepacked + static_cast<size_t>(pc) * m_panels * mr;
+				}
+
+				#pragma omp parallel
+				{
+					#pragma omp for schedule(static)
+					for (int panel = 0; panel < n_panels; ++panel)
+					{
+						if (conv)
+						{
+							pack_b_conv(*conv, N, pc, jc + panel * nr, kc, nr, pb + panel * kc * nr);
+						}
+						else
+						{
+							pack_b(TB, B, ldb, N, pc, jc + panel * nr, kc, nr, pb + panel * kc * nr);
+						}
+					}
+
+					if (prepacked == nullptr)
+					{
+						#pragma omp for schedule(static)
+						for (int panel = 0; panel < m_panels; ++panel)
+						{
+							pack_a(TA, A, lda, M, panel * mr, pc, kc, mr, ALPHA, pa + panel * kc * mr);
+						}
+					}
+
+					#pragma omp for schedule(dynamic)
+					for (int tile = 0; tile < m_tiles * n_tiles; ++tile)
+					{
+						const int ic	= (tile / n_tiles) * kernel.mc;
+						const int jt	= (tile % n_tiles) * kernel.nt;
+						const int mc	= std::min(kernel.mc, M - ic);
+						const int nt	= std::min(kernel.nt, nc - jt);
+
+						for (int jr = 0; jr < nt; jr += nr)
+						{
+							const int cols = std::min(nr, nt - jr);
+							const float * b = pb + ((jt + jr) / nr) * kc * nr;
+
+							for (int ir = 0; ir < mc; ir += mr)
+							{
+								const int rows = std::min(mr, mc - ir);
+								const float * a = a_block + ((ic + ir) / mr) * kc * mr;
+								float * c = C + (ic + ir) * ldc + jc + jt + jr;
+
+								if (rows == mr and cols == nr)
+								{
+									kernel.fn(kc, a, b, c, ldc, accumulate);
+								}
+								else
+								{
+									// partial tile at the edge of C, so compute the full tile on the side and copy what is needed
+									float tmp[kMaxTile];
+									kernel.fn(kc, a, b, tmp, nr, false);
+									for (int r = 0; r < rows; ++r)
+									{
+										for (int j = 0; j < cols; ++j)
+										{
+											c[r * ldc + j] = (accumulate ? c[r * ldc + j] : 0.0f) + tmp[r * nr + j];
+										}
+									}
+								}
+							}
+						}
+
+						if (last and epilogue)
+						{
+							epilogue(C + ic * ldc + jc + jt, ldc, ic, jc + jt, mc, nt);
+						}
+					}
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+
+std::string Darknet_ng::gemm_kernel_name()
+{
+	return get_microkernel().name;
+}
+
+
+int Darknet_ng::gemm_parallel_blocks(const int M, const int N)
+{
+	// same as the tiles of gemm_blocked(), which are given to the threads one block of nc columns at a time
+	const MicroKernel & kernel = get_microkernel();
+	const int m_tiles = (M + kernel.mc - 1) / kernel.mc;
+	const int n_tiles = (std::min(N, kernel.nc) + kernel.nt - 1) / kernel.nt;
+
+	return m_tiles * n_tiles;
+}
+
+
+size_t Darknet_ng::gemm_packed_a_size(const int M, const int K)
+{
+	const int mr = get_microkernel().mr;
+	const size_t m_panels = (M + mr - 1) / mr;
+
+	return m_panels * mr * K;
+}
+
+
+void Darknet_ng::gemm_pack_a(int TA, int M, int K, float ALPHA, const float * A, int lda, float * packed)
+{
+	const MicroKernel & kernel = get_microkernel();
+	const int mr = kernel.mr;
+	const int m_panels = (M + mr - 1) / mr;
+
+	// same layout used by gemm_blocked():  each block of kc columns is stored as m_panels micro-panels of kc x mr
+	for (int pc = 0; pc < K; pc += kernel.kc)
+	{
+		const int kc = std::min(kernel.kc, K - pc);
+		float * block = packed + static_cast<size_t>(pc) * m_panels * mr;
+
+		#pragma omp parallel for
+		for (int panel = 0; panel < m_panels; ++panel)
+		{
+			pack_a(TA, A, lda, M, panel * mr, pc, kc, mr, ALPHA, block + panel * kc * mr);
+		}
+	}
+
+	return;
+}
+
+
+void Darknet_ng::gemm(int TA, int TB, int M, int N, int K, float ALPHA, const float * A, int lda, const float * B, int ldb, float BETA, float * C, int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+{
+	// was:  void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA, float *A, int lda, float *B, int ldb, float BETA, float *C, int ldc)
+
+	gemm_blocked(TA, TB, M, N, K, ALPHA, A, lda, nullptr, B, ldb, nullptr, BETA, C, ldc, epilogue);
+
+	return;
+}
+
+
+void Darknet_ng::gemm_prepacked(int TB, int M, int N, int K, const float * packed_a, const float * B, int ldb, float BETA, float * C, int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+{
+	gemm_blocked(0, TB, M, N, K, 1.0f, nullptr, 0, packed_a, B, ldb, nullptr, BETA, C, ldc, epilogue);
+
+	return;
+}
+
+
+void Darknet_ng::gemm_conv(int M, int N, int K, float ALPHA, const float * A, int lda, const float * packed_a, const Darknet_ng::GemmConvInput & input, float BETA, float * C, int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+{
+	if (N != input.out_h * input.out_w or K != input.channels * input.kernel_h * input.kernel_w)
+	{
+		/// @throw Exception The size of B must match the convolution.
+		throw Exception("implicit GEMM convolution expected N=" + std::to_string(input.out_h * input.out_w) + " and K=" + std::to_string(input.channels * input.kernel_h * input.kernel_w) + " but got N=" + std::to_string(N) + " and K=" + std::to_string(K), DNG_LOC);
+	}
+
+	gemm_blocked(0, 0, M, N, K, ALPHA, A, lda, packed_a, nullptr, 0, &input, BETA, C, ldc, epilogue);
+
+	return;
+}
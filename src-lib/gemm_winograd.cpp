@@ -0,0 +1,439 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include <omp.h>
+#include "darknet-ng.hpp"
+
+
+/* Winograd F(4x4,3x3) convolution, see "Fast Algorithms for Convolutional Neural Networks" by Lavin and Gray (2015).
+ *
+ * Each 4x4 block of the output is computed from a 6x6 tile of the input.  The 3x3 filters and the 6x6 input tiles are
+ * both transformed into 6x6 = 36 values, after which the convolution becomes 36 independent GEMMs of filters x channels
+ * by channels x tiles.  Those GEMMs need 36 multiplications per 16 outputs instead of the 9 x 16 = 144 done by the
+ * direct convolution.  The results are then transformed back into 4x4 blocks of the output.
+ *
+ * The tiles are processed a few rows of tiles at a time so the transformed input and the GEMM results stay in cache.
+ * Each OpenMP thread works on a different block of tiles.  The transforms work on entire rows of tiles at once, so the
+ * same operation is applied to every tile in the row and the compiler can turn each loop into SIMD instructions.
+ */
+
+
+namespace
+{
+	constexpr int kInputTile	= 6;	///< the input tiles are 6x6
+	constexpr int kOutputTile	= 4;	///< the output tiles are 4x4
+	constexpr int kTileSize		= kInputTile * kInputTile;
+
+	/// Aim for this many tiles in each block so the 36 GEMMs are large enough to be efficient.
+	constexpr int kTilesPerBlock = 128;
+
+
+	/// The most rows of tiles in a single block, whatever the number of threads.  @see @ref Darknet_ng::winograd_conv()
+	inline int get_max_rows_per_block(const int tiles_x, const int tiles_y)
+	{
+		return std::min(tiles_y, std::max(1, (kTilesPerBlock + tiles_x - 1) / tiles_x));
+	}
+
+
+	/** The number of @p float in the workspace of each thread:  the transformed input tiles, the results of the 36 GEMMs,
+	 * and the rows used by the transforms.  This is rounded up so the workspace of the next thread remains aligned.
+	 */
+	inline size_t get_thread_workspace_size(const int M, const int channels, const int tiles_x, const int tiles_y)
+	{
+		const size_t tiles = static_cast<size_t>(get_max_rows_per_block(tiles_x, tiles_y)) * tiles_x;
+		const size_t size =
+				static_cast<size_t>(kTileSize) * channels * tiles +
+				static_cast<size_t>(kTileSize) * M * tiles +
+				static_cast<size_t>(kInputTile) * 10 * (tiles_x + 1);
+
+		const size_t alignment = Darknet_ng::kArenaAlignment / sizeof(float);
+
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+
+	/** Apply the 1D input transform B^T to 6 rows of @p n values at once:
+	 * @code
+	 *	4   0  -5   0   1   0
+	 *	0  -4  -4   1   1   0
+	 *	0   4  -4  -1   1   0
+	 *	0  -2  -1   2   1   0
+	 *	0   2  -1  -2   1   0
+	 *	0   4   0  -5   0   1
+	 * @endcode
+	 */
+	inline void input_transform(const float * const in[kInputTile], float * const out[kInputTile], const int n)
+	{
+		const float * const d0 = in[0];
+		const float * const d1 = in[1];
+		const float * const d2 = in[2];
+		const float * const d3 = in[3];
+		const float * const d4 = in[4];
+		const float * const d5 = in[5];
+
+		#pragma omp simd
+		for (int i = 0; i < n; ++i)
+		{
+			const float a = d4[i] - 4.0f * d2[i];
+			const float b = d3[i] - 4.0f * d1[i];
+			const float c = d4[i] - d2[i];
+			const float d = 2.0f * (d3[i] - d1[i]);
+
+			out[0][i] = 4.0f * d0[i] - 5.0f * d2[i] + d4[i];
+			out[1][i] = a + b;
+			out[2][i] = a - b;
+			out[3][i] = c + d;
+			out[4][i] = c - d;
+			out[5][i] = 4.0f * d1[i] - 5.0f * d3[i] + d5[i];
+		}
+
+		return;
+	}
+
+
+	/** Apply the 1D output transform A^T to 6 rows of @p n values at once:
+	 * @code
+	 *	1   1   1   1   1   0
+	 *	0   1  -1   2  -2   0
+	 *	0   1   1   4   4   0
+	 *	0   1  -1   8  -8   1
+	 * @endcode
+	 */
+	inline void output_transform(const float * const in[kInputTile], float * const out[kOutputTile], const int n)
+	{
+		const float * const m0 = in[0];
+		const float * const m1 = in[1];
+		const float * const m2 = in[2];
+		const float * const m3 = in[3];
+		const float * const m4 = in[4];
+		const float * const m5 = in[5];
+
+		#pragma omp simd
+		for (int i = 0; i < n; ++i)
+		{
+			const float a = m1[i] + m2[i];
+			const float b = m1[i] - m2[i];
+			const float c = m3[i] + m4[i];
+			const float d = m3[i] - m4[i];
+
+			out[0][i] = m0[i] + a + c;
+			out[1][i] = b + 2.0f * d;
+			out[2][i] = a + 4.0f * c;
+			out[3][i] = b + 8.0f * d + m5[i];
+		}
+
+		return;
+	}
+
+
+	/** Transform one channel of one row of tiles.  @p y is the first input row of the tiles (which may be in the padding)
+	 * and the results for tile @p tx go to @p dst at the offset @p tx, with @p stride floats between the 36 values.
+	 * @p scratch needs room for 60 x (@p tiles_x + 1) floats.
+	 */
+	void transform_input_row(const Darknet_ng::GemmConvInput & in, const float * image, const int y, const int tiles_x, float * scratch, float * dst, const size_t stride)
+	{
+		/* Tile tx covers the input columns 4*tx-pad to 4*tx-pad+5.  Splitting each row into 4 phases (column 4*tx+p-pad
+		 * goes to phase p) means the 6 columns of every tile are found at the same offset tx in the phases 0 to 3, and at
+		 * tx+1 in the phases 0 and 1.  The transforms can then be applied to all the tiles in the row at once.
+		 */
+		const int phase_len = tiles_x + 1;
+		float * const phases	= scratch;										// 6 rows x 4 phases
+		float * const columns	= scratch + kInputTile * 4 * phase_len;			// 6 rows x 6 values
+
+		for (int r = 0; r < kInputTile; ++r)
+		{
+			float * const row_phases = phases + r * 4 * phase_len;
+			const int iy = y + r;
+			if (iy < 0 or iy >= in.height)
+			{
+				// this row is in the padding, so the transformed values are all zero
+				for (int j = 0; j < kInputTile; ++j)
+				{
+					std::fill(columns + (r * kInputTile + j) * tiles_x, columns + (r * kInputTile + j + 1) * tiles_x, 0.0f);
+				}
+				continue;
+			}
+
+			const float * const src = image + iy * in.width;
+			for (int p = 0; p < 4; ++p)
+			{
+				float * const dst_phase = row_phases + p * phase_len;
+				for (int tx = 0; tx < phase_len; ++tx)
+				{
+					const int ix = kOutputTile * tx + p - in.pad_w;
+					dst_phase[tx] = (ix >= 0 and ix < in.width ? src[ix] : 0.0f);
+				}
+			}
+
+			const float * const d[kInputTile] =
+			{
+				row_phases,
+				row_phases + phase_len,
+				row_phases + 2 * phase_len,
+				row_phases + 3 * phase_len,
+				row_phases + 1,
+				row_phases + phase_len + 1
+			};
+			float * const out[kInputTile] =
+			{
+				columns + (r * kInputTile + 0) * tiles_x,
+				columns + (r * kInputTile + 1) * tiles_x,
+				columns + (r * kInputTile + 2) * tiles_x,
+				columns + (r * kInputTile + 3) * tiles_x,
+				columns + (r * kInputTile + 4) * tiles_x,
+				columns + (r * kInputTile + 5) * tiles_x
+			};
+			input_transform(d, out, tiles_x);
+		}
+
+		// same transform again in the other direction, which writes the 36 values of each tile where the GEMM expects them
+		for (int j = 0; j < kInputTile; ++j)
+		{
+			const float * const d[kInputTile] =
+			{
+				columns + (0 * kInputTile + j) * tiles_x,
+				columns + (1 * kInputTile + j) * tiles_x,
+				columns + (2 * kInputTile + j) * tiles_x,
+				columns + (3 * kInputTile + j) * tiles_x,
+				columns + (4 * kInputTile + j) * tiles_x,
+				columns + (5 * kInputTile + j) * tiles_x
+			};
+			float * const out[kInputTile] =
+			{
+				dst + (0 * kInputTile + j) * stride,
+				dst + (1 * kInputTile + j) * stride,
+				dst + (2 * kInputTile + j) * stride,
+				dst + (3 * kInputTile + j) * stride,
+				dst + (4 * kInputTile + j) * stride,
+				dst + (5 * kInputTile + j) * stride
+			};
+			input_transform(d, out, tiles_x);
+		}
+
+		return;
+	}
+
+
+	/** Transform the GEMM results of one filter for one row of tiles back into the output.  @p src is the first of the
+	 * 36 values for the first tile in the row, with @p stride floats between the 36 values.  @p scratch needs room for
+	 * 28 x @p tiles_x floats.
+	 */
+	void transform_output_row(const float * src, const size_t stride, const int tiles_x, const int y, const int out_h, const int out_w, float * scratch, float * dst)
+	{
+		float * const rows		= scratch;									// 4 rows x 6 values
+		float * const values	= scratch + kOutputTile * kInputTile * tiles_x;	// 4 values of a single row
+
+		for (int j = 0; j < kInputTile; ++j)
+		{
+			const float * const m[kInputTile] =
+			{
+				src + (0 * kInputTile + j) * stride,
+				src + (1 * kInputTile + j) * stride,
+				src + (2 * kInputTile + j) * stride,
+				src + (3 * kInputTile + j) * stride,
+				src + (4 * kInputTile + j) * stride,
+				src + (5 * kInputTile + j) * stride
+			};
+			float * const out[kOutputTile] =
+			{
+				rows + (0 * kInputTile + j) * tiles_x,
+				rows + (1 * kInputTile + j) * tiles_x,
+				rows + (2 * kInputTile + j) * tiles_x,
+				rows + (3 * kInputTile + j) * tiles_x
+			};
+			output_transform(m, out, tiles_x);
+		}
+
+		for (int r = 0; r < kOutputTile and y + r < out_h; ++r)
+		{
+			const float * const m[kInputTile] =
+			{
+				rows + (r * kInputTile + 0) * tiles_x,
+				rows + (r * kInputTile + 1) * tiles_x,
+				rows + (r * kInputTile + 2) * tiles_x,
+				rows + (r * kInputTile + 3) * tiles_x,
+				rows + (r * kInputTile + 4) * tiles_x,
+				rows + (r * kInputTile + 5) * tiles_x
+			};
+			float * const out[kOutputTile] =
+			{
+				values,
+				values + tiles_x,
+				values + 2 * tiles_x,
+				values + 3 * tiles_x
+			};
+			output_transform(m, out, tiles_x);
+
+			// interleave the 4 columns of each tile back into a row of the output, the last tile may be cut off
+			float * const output_row = dst + (y + r) * out_w;
+			for (int c = 0; c < kOutputTile; ++c)
+			{
+				const float * const v = values + c * tiles_x;
+				for (int tx = 0; tx < tiles_x and kOutputTile * tx + c < out_w; ++tx)
+				{
+					output_row[kOutputTile * tx + c] = v[tx];
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+
+bool Darknet_ng::winograd_supported(const Darknet_ng::GemmConvInput & input)
+{
+	return
+		input.kernel_h		== 3 and
+		input.kernel_w		== 3 and
+		input.stride_h		== 1 and
+		input.stride_w		== 1 and
+		input.dilation_h	== 1 and
+		input.dilation_w	== 1 and
+		input.out_h			== input.height + 2 * input.pad_h - 2 and
+		input.out_w			== input.width + 2 * input.pad_w - 2;
+}
+
+
+size_t Darknet_ng::winograd_filters_size(const int M, const int C)
+{
+	return kTileSize * gemm_packed_a_size(M, C);
+}
+
+
+void Darknet_ng::winograd_transform_filters(const int M, const int C, const float * weights, float * transformed)
+{
+	// G is 6x3, each filter becomes G x g x G^T
+	static const double G[kInputTile][3] =
+	{
+		{  1.0 /  4.0,	 0.0		,	 0.0		},
+		{ -1.0 /  6.0,	-1.0 /  6.0	,	-1.0 / 6.0	},
+		{ -1.0 /  6.0,	 1.0 /  6.0	,	-1.0 / 6.0	},
+		{  1.0 / 24.0,	 1.0 / 12.0	,	 1.0 / 6.0	},
+		{  1.0 / 24.0,	-1.0 / 12.0	,	 1.0 / 6.0	},
+		{  0.0		 ,	 0.0		,	 1.0		}
+	};
+
+	// one M x C matrix for each of the 36 values, which are then packed for gemm_prepacked()
+	VF matrices(static_cast<size_t>(kTileSize) * M * C);
+
+	#pragma omp parallel for
+	for (int m = 0; m < M; ++m)
+	{
+		for (int c = 0; c < C; ++c)
+		{
+			const float * const g = weights + (static_cast<size_t>(m) * C + c) * 9;
+
+			double tmp[kInputTile][3];
+			for (int i = 0; i < kInputTile; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					tmp[i][j] = G[i][0] * g[j] + G[i][1] * g[3 + j] + G[i][2] * g[6 + j];
+				}
+			}
+
+			for (int i = 0; i < kInputTile; ++i)
+			{
+				for (int j = 0; j < kInputTile; ++j)
+				{
+					const double u = tmp[i][0] * G[j][0] + tmp[i][1] * G[j][1] + tmp[i][2] * G[j][2];
+					matrices[(static_cast<size_t>(i * kInputTile + j) * M + m) * C + c] = static_cast<float>(u);
+				}
+			}
+		}
+	}
+
+	const size_t packed_size = gemm_packed_a_size(M, C);
+	for (int t = 0; t < kTileSize; ++t)
+	{
+		gemm_pack_a(0, M, C, 1.0f, matrices.data() + static_cast<size_t>(t) * M * C, C, transformed + t * packed_size);
+	}
+
+	return;
+}
+
+
+size_t Darknet_ng::winograd_workspace_size(const int M, const Darknet_ng::GemmConvInput & input, const int threads)
+{
+	const int tiles_x = (input.out_w + kOutputTile - 1) / kOutputTile;
+	const int tiles_y = (input.out_h + kOutputTile - 1) / kOutputTile;
+
+	return get_thread_workspace_size(M, input.channels, tiles_x, tiles_y) * sizeof(float) * threads;
+}
+
+
+void Darknet_ng::winograd_conv(const int M, const float * transformed, const Darknet_ng::GemmConvInput & input, float * workspace, const int threads, float * C, const int ldc, const Darknet_ng::GemmEpilogue & epilogue)
+{
+	if (not winograd_supported(input))
+	{
+		/// @throw Exception Only 3x3 convolutions with a stride of 1 and no dilation can use Winograd.
+		throw Exception("Winograd convolution does not support a " + std::to_string(input.kernel_w) + "x" + std::to_string(input.kernel_h) + " kernel with stride=" + std::to_string(input.stride_w) + " and dilation=" + std::to_string(input.dilation_w), DNG_LOC);
+	}
+
+	const int channels		= input.channels;
+	const int tiles_x		= (input.out_w + kOutputTile - 1) / kOutputTile;
+	const int tiles_y		= (input.out_h + kOutputTile - 1) / kOutputTile;
+	const size_t packed_size= gemm_packed_a_size(M, channels);
+
+	const size_t thread_size= get_thread_workspace_size(M, channels, tiles_x, tiles_y);
+	const size_t max_tiles	= static_cast<size_t>(get_max_rows_per_block(tiles_x, tiles_y)) * tiles_x;
+
+	// whole rows of tiles, but enough blocks so every thread has something to do
+	int rows_per_block		= std::max(1, (kTilesPerBlock + tiles_x - 1) / tiles_x);
+	rows_per_block			= std::min(rows_per_block, std::max(1, (tiles_y + threads - 1) / threads));
+	const int blocks		= (tiles_y + rows_per_block - 1) / rows_per_block;
+
+	#pragma omp parallel for schedule(dynamic) num_threads(threads)
+	for (int block = 0; block < blocks; ++block)
+	{
+		const int ty_start	= block * rows_per_block;
+		const int ty_end	= std::min(tiles_y, ty_start + rows_per_block);
+		const int tiles		= (ty_end - ty_start) * tiles_x;
+
+		// each thread has its own slice of the workspace, and the GEMMs below run on this thread alone
+		float * const transformed_input	= workspace + omp_get_thread_num() * thread_size;
+		float * const products			= transformed_input + static_cast<size_t>(kTileSize) * channels * max_tiles;
+		float * const scratch			= products + static_cast<size_t>(kTileSize) * M * max_tiles;
+
+		// the values are stored as 36 matrices of channels x tiles
+		const size_t input_stride = static_cast<size_t>(channels) * tiles;
+		for (int c = 0; c < channels; ++c)
+		{
+			const float * image = input.image + static_cast<size_t>(c) * input.height * input.width;
+			for (int ty = ty_start; ty < ty_end; ++ty)
+			{
+				float * dst = transformed_input + static_cast<size_t>(c) * tiles + (ty - ty_start) * tiles_x;
+				transform_input_row(input, image, kOutputTile * ty - input.pad_h, tiles_x, scratch, dst, input_stride);
+			}
+		}
+
+		// ...which are multiplied by the 36 matrices of filters x channels
+		const size_t product_stride = static_cast<size_t>(M) * tiles;
+		for (int t = 0; t < kTileSize; ++t)
+		{
+			gemm_prepacked(0, M, tiles, channels, transformed + t * packed_size, transformed_input + t * input_stride, tiles, 0.0f, products + t * product_stride, tiles);
+		}
+
+		const int y_start	= kOutputTile * ty_start;
+		const int y_end		= std::min(input.out_h, kOutputTile * ty_end);
+		for (int m = 0; m < M; ++m)
+		{
+			float * const output = C + static_cast<size_t>(m) * ldc;
+			for (int ty = ty_start; ty < ty_end; ++ty)
+			{
+				const float * src = products + static_cast<size_t>(m) * tiles + (ty - ty_start) * tiles_x;
+				transform_output_row(src, product_stride, tiles_x, kOutputTile * ty, input.out_h, input.out_w, scratch, output);
+			}
+
+			if (epilogue)
+			{
+				// the rows of this filter are complete and still in cache
+				epilogue(output + y_start * input.out_w, ldc, m, y_start * input.out_w, 1, (y_end - y_start) * input.out_w);
+			}
+		}
+	}
+
+	return;
+}
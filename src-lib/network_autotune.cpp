@@ -0,0 +1,370 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <omp.h>
+#include "darknet-ng.hpp"
+
+
+namespace
+{
+	/// Number of timed runs of each algorithm.  The fastest run is kept, since the slower ones were disturbed by something else.
+	constexpr int kAutotuneIterations = 3;
+
+	/// How much faster another algorithm must be before it replaces the default one, so timing noise is not stored in the cache.
+	constexpr double kAutotuneMinSpeedup = 1.05;
+
+	/// The algorithms which can compute the given layer.  The first one is the fallback used when nothing else is faster.
+	std::vector<Darknet_ng::EConvAlgorithm> get_candidate_algorithms(const Darknet_ng::Layer & layer)
+	{
+		using namespace Darknet_ng;
+
+		std::vector<EConvAlgorithm> candidates = { layer.conv_algorithm };
+
+		const auto add = [&](const EConvAlgorithm algorithm)
+		{
+			if (std::find(candidates.begin(), candidates.end(), algorithm) == candidates.end())
+			{
+				candidates.push_back(algorithm);
+			}
+		};
+
+		add(EConvAlgorithm::kImplicitGEMM);
+		add(EConvAlgorithm::kIm2col);
+		if (layer.groups > 1)
+		{
+			add(EConvAlgorithm::kGrouped);
+		}
+
+		// see carve_winograd_filters()
+		if (layer.winograd_weights and layer.weights_packed and get_winograd_error(layer) <= kWinogradTolerance)
+		{
+			add(EConvAlgorithm::kWinograd);
+		}
+
+		return candidates;
+	}
+
+
+	/// Returns @p true if Winograd could compute this layer, whatever its shape picked when the network was allocated.
+	bool can_use_winograd(const Darknet_ng::Layer & layer)
+	{
+		return layer.groups == 1 and Darknet_ng::winograd_supported(Darknet_ng::get_convolutional_gemm_input(layer, nullptr));
+	}
+
+
+	/// Carve out and fill in the transformed Winograd filters of the given layers, replacing any filters carved previously.
+	void carve_winograd_filters(Darknet_ng::Arena & arena, const std::vector<Darknet_ng::Layer *> & layers)
+	{
+		using namespace Darknet_ng;
+
+		arena.clear();
+		if (layers.empty())
+		{
+			return;
+		}
+
+		// the 1st pass finds the size of the arena, and the 2nd pass carves out the buffers
+		for (int pass = 0; pass < 2; pass ++)
+		{
+			for (auto layer : layers)
+			{
+				layer->winograd_weights = arena.carve<float>(winograd_filters_size(layer->n, layer->c));
+			}
+
+			if (pass == 0)
+			{
+				arena.commit();
+			}
+		}
+
+		for (auto layer : layers)
+		{
+			winograd_transform_filters(layer->n, layer->c, layer->weights, layer->winograd_weights);
+		}
+
+		return;
+	}
+
+
+	/// Describe the shape of the layer.  Layers with the same signature run at the same speed with the same algorithm.
+	std::string get_layer_signature(const Darknet_ng::Layer & layer)
+	{
+		return
+			"batch="		+ std::to_string(layer.batch)		+
+			" c="			+ std::to_string(layer.c)			+
+			" h="			+ std::to_string(layer.h)			+
+			" w="			+ std::to_string(layer.w)			+
+			" n="			+ std::to_string(layer.n)			+
+			" groups="		+ std::to_string(layer.groups)		+
+			" size="		+ std::to_string(layer.size)		+
+			" stride="		+ std::to_string(layer.stride_x)	+ "x" + std::to_string(layer.stride_y) +
+			" dilation="	+ std::to_string(layer.dilation)	+
+			" pad="			+ std::to_string(layer.pad)			+
+			" antialiasing="+ std::to_string(layer.antialiasing)+
+			" activation="	+ Darknet_ng::to_string(layer.activation);
+	}
+
+
+	/// Read the autotuning cache.  The key is the CPU model, the number of threads, and the layer signature.
+	Darknet_ng::MStr load_autotune_cache(const std::filesystem::path & cache_filename)
+	{
+		Darknet_ng::MStr cache;
+
+		std::ifstream ifs(cache_filename);
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			if (line.empty() or line[0] == '#')
+			{
+				continue;
+			}
+
+			// each line is "<cpu model> TAB <threads> TAB <layer signature> TAB <algorithm>"
+			const size_t pos = line.rfind('\t');
+			if (pos != std::string::npos)
+			{
+				cache[line.substr(0, pos)] = line.substr(pos + 1);
+			}
+		}
+
+		return cache;
+	}
+
+
+	void save_autotune_cache(const std::filesystem::path & cache_filename, const Darknet_ng::MStr & cache)
+	{
+		std::ofstream ofs(cache_filename);
+		if (not ofs.good())
+		{
+			/// @throw Exception The cache file cannot be written.
+			throw Darknet_ng::Exception("failed to save the autotuning cache to " + cache_filename.string(), DNG_LOC);
+		}
+
+		ofs << "# Darknet_ng convolution autotuning cache:  CPU model, threads, layer signature, and fastest algorithm" << std::endl;
+		for (const auto & [key, algorithm] : cache)
+		{
+			ofs << key << "\t" << algorithm << std::endl;
+		}
+
+		return;
+	}
+
+
+	/// Run the layer a few times with the given algorithm and return the fastest time in seconds.
+	double time_convolutional_layer(Darknet_ng::Layer & layer, const Darknet_ng::EConvAlgorithm algorithm, const float * input)
+	{
+		using namespace Darknet_ng;
+
+		set_convolutional_algorithm(layer, algorithm);
+
+		size_t workspace_size = layer.workspace_size;
+		if (layer.input_layer)
+		{
+			workspace_size = std::max(workspace_size, layer.input_layer->workspace_size);
+		}
+		VF workspace(workspace_size / sizeof(float) + 1);
+
+		NetworkState state;
+		std::memset(&state, '\0', sizeof(state));
+		state.input		= input;
+		state.workspace	= workspace.data();
+
+		forward_convolutional_layer(layer, state); // warm up the caches and the packing buffers
+
+		double best = std::numeric_limits<double>::max();
+		for (int i = 0; i < kAutotuneIterations; i ++)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			forward_convolutional_layer(layer, state);
+			const auto end = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration<double>(end - start).count());
+		}
+
+		return best;
+	}
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::autotune(const std::filesystem::path & cache_filename, const size_t batch)
+{
+	if (settings.train)
+	{
+		/// @throw Exception Training always uses im2col, see choose_convolutional_algorithm().
+		throw Exception("cannot autotune a network which is being trained", DNG_LOC);
+	}
+
+	if (batch < 1 or batch > static_cast<size_t>(settings.batch))
+	{
+		/// @throw Exception The buffers are sized for the batch in the configuration, so larger batches are not possible.
+		throw Exception("cannot autotune with a batch of " + std::to_string(batch) + " since the network was loaded with batch=" + std::to_string(settings.batch), DNG_LOC);
+	}
+
+	// layers which share their weights are never fused, see fuse_layers()
+	std::set<const Layer *> shared;
+	for (const auto & layer : layers)
+	{
+		if (layer.share_layer)
+		{
+			shared.insert(&layer);
+			shared.insert(layer.share_layer);
+		}
+	}
+
+	std::vector<Layer *> tunable;
+	for (auto & layer : layers)
+	{
+		if (layer.type != ELayerType::kConvolutional or layer.xnor or layer.binary or layer.blocked or shared.count(&layer))
+		{
+			continue;
+		}
+
+		if (not layer.fused)
+		{
+			/// @throw Exception Unfused layers compute Winograd with the implicit GEMM, so the timings would be wrong.
+			throw Exception("cannot autotune [convolutional] layer #" + std::to_string(layer.index) + " since the layers have not been fused", DNG_LOC);
+		}
+
+		tunable.push_back(&layer);
+	}
+
+	// layers whose shape did not pick Winograd get transformed filters for the duration of the tuning
+	std::vector<Layer *> extra_winograd;
+	for (auto layer : tunable)
+	{
+		if (layer->winograd_weights == nullptr and can_use_winograd(*layer))
+		{
+			extra_winograd.push_back(layer);
+		}
+	}
+	carve_winograd_filters(winograd_arena, extra_winograd);
+
+	MStr cache;
+	if (not cache_filename.empty() and std::filesystem::exists(cache_filename))
+	{
+		cache = load_autotune_cache(cache_filename);
+	}
+
+	const std::string prefix = get_cpu_model() + "\t" + std::to_string(omp_get_max_threads()) + "\t";
+
+	int tuned_count		= 0;
+	int cached_count	= 0;
+	int changed_count	= 0;
+	VF input;
+
+	for (auto layer_ptr : tunable)
+	{
+		Layer & layer = *layer_ptr;
+
+		// time the layer at the batch which predict() will use, but leave the buffers sized for the full batch
+		const int full_batch = layer.batch;
+		layer.batch = batch;
+		if (layer.input_layer)
+		{
+			layer.input_layer->batch = batch;
+		}
+
+		const auto candidates = get_candidate_algorithms(layer);
+		const std::string key = prefix + get_layer_signature(layer);
+
+		EConvAlgorithm best = candidates[0];
+		bool found = false;
+		if (cache.count(key))
+		{
+			// an entry for an algorithm this layer cannot use -- such as Winograd with large weights -- is timed again
+			for (const auto algorithm : candidates)
+			{
+				if (to_string(algorithm) == cache.at(key))
+				{
+					best = algorithm;
+					found = true;
+				}
+			}
+		}
+
+		if (found)
+		{
+			cached_count ++;
+		}
+		else
+		{
+			// something which looks like the output of a leaky or mish activation, mostly positive with a few small negatives
+			input.resize(static_cast<size_t>(layer.batch) * layer.inputs);
+			for (size_t i = 0; i < input.size(); i ++)
+			{
+				input[i] = std::fabs(std::sin(i * 0.618f)) * 2.0f - 0.1f;
+			}
+
+			double best_time = std::numeric_limits<double>::max();
+			for (const auto algorithm : candidates)
+			{
+				const double seconds = time_convolutional_layer(layer, algorithm, input.data());
+				if (algorithm == candidates[0] ? seconds < best_time : seconds * kAutotuneMinSpeedup < best_time)
+				{
+					best_time = seconds;
+					best = algorithm;
+				}
+			}
+
+			cache[key] = to_string(best);
+			tuned_count ++;
+
+			fprintf(stderr, "Autotuned [convolutional] layer #%d (%s): %s %.3f ms\n", layer.index, get_layer_signature(layer).c_str(), to_string(best).c_str(), best_time * 1000.0);
+		}
+
+		layer.batch = full_batch;
+		if (layer.input_layer)
+		{
+			layer.input_layer->batch = full_batch;
+		}
+
+		if (best != candidates[0])
+		{
+			changed_count ++;
+		}
+		set_convolutional_algorithm(layer, best);
+	}
+
+	// only keep the extra filters of the layers which are now using Winograd
+	std::vector<Layer *> winograd_layers;
+	for (auto layer : extra_winograd)
+	{
+		if (layer->conv_algorithm == EConvAlgorithm::kWinograd)
+		{
+			winograd_layers.push_back(layer);
+		}
+		else
+		{
+			layer->winograd_weights = nullptr;
+		}
+	}
+	carve_winograd_filters(winograd_arena, winograd_layers);
+
+	if (tuned_count > 0 and not cache_filename.empty())
+	{
+		save_autotune_cache(cache_filename, cache);
+	}
+
+	// the workspace must be large enough for the chosen algorithms, and the NCHW <-> NCHWc conversion buffer comes after it
+	size_t layer_workspace_size = 0;
+	for (const auto & layer : layers)
+	{
+		layer_workspace_size = std::max(layer_workspace_size, layer.workspace_size);
+		if (layer.input_layer)
+		{
+			layer_workspace_size = std::max(layer_workspace_size, layer.input_layer->workspace_size);
+		}
+	}
+	const size_t conversion_size = (channel_block > 0 ? workspace_size - conversion_offset : 0);
+	conversion_offset	= (channel_block > 0 ? (layer_workspace_size + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment : 0);
+	workspace_size		= std::max(layer_workspace_size, conversion_offset + conversion_size);
+	allocate_workspace();
+
+	fprintf(stderr, "Autotuned %d convolutional layers (%d read from the cache), %d changed from the default algorithm\n", tuned_count + cached_count, cached_count, changed_count);
+
+	return *this;
+}
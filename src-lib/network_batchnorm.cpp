@@ -0,0 +1,59 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+void Darknet_ng::forward_batchnorm_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_batchnorm_layer(layer l, network_state state)
+
+	/// @todo This is only called by convolutional layers.  Stand-alone [batchnorm] layers have not been ported.
+
+	const int spatial = layer.out_h * layer.out_w;
+
+	if (state.train)
+	{
+		LayerTraining & training = *layer.training;
+
+		mean_cpu(layer.output, layer.batch, layer.out_c, spatial, training.mean);
+		variance_cpu(layer.output, training.mean, layer.batch, layer.out_c, spatial, training.variance);
+
+		for (int i = 0; i < layer.out_c; ++i)
+		{
+			layer.rolling_mean[i]		= 0.9f * layer.rolling_mean[i]		+ 0.1f * training.mean[i];
+			layer.rolling_variance[i]	= 0.9f * layer.rolling_variance[i]	+ 0.1f * training.variance[i];
+		}
+
+		memcpy(training.x, layer.output, layer.outputs * layer.batch * sizeof(float));
+		normalize_cpu(layer.output, training.mean, training.variance, layer.batch, layer.out_c, spatial);
+		memcpy(training.x_norm, layer.output, layer.outputs * layer.batch * sizeof(float));
+	}
+	else
+	{
+		normalize_cpu(layer.output, layer.rolling_mean, layer.rolling_variance, layer.batch, layer.out_c, spatial);
+	}
+
+	scale_bias(layer.output, layer.scales, layer.batch, layer.out_c, spatial);
+	add_bias(layer.output, layer.biases, layer.batch, layer.out_c, spatial);
+
+	return;
+}
+
+
+void Darknet_ng::scale_bias(float * output, const float * scales, const int batch, const int n, const int size)
+{
+	#pragma omp parallel for
+	for (int bi = 0; bi < batch * n; ++bi)
+	{
+		const float scale = scales[bi % n];
+
+		float * ptr = output + bi * size;
+		for (int j = 0; j < size; ++j)
+		{
+			ptr[j] *= scale;
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,627 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <algorithm>
+#include <omp.h>
+#include "darknet-ng.hpp"
+
+#if DNG_X86
+#include <immintrin.h>
+#endif
+
+
+/* Blocked NCHWc layout, see Network::use_blocked_layout().
+ *
+ * Instead of storing each channel as a separate plane, the channels are split into blocks of 8 or 16 (the width of a
+ * SIMD register) and the channels of a block are stored together for every pixel:  [batch][channels/block][h][w][block].
+ * An entire block of channels for one pixel can then be loaded into a single register.
+ *
+ * The convolutions are computed directly on this layout.  Each microkernel computes several consecutive pixels for one
+ * block of output channels, and keeps one register of results per pixel.  Every input value is broadcast and multiplied
+ * with a register holding the weights for all the output channels of the block.
+ */
+
+
+namespace
+{
+	/** Computes @p XB consecutive output pixels for one block of output channels.  @p src contains @p taps groups of
+	 * @p XB pixels x block input channels, each @p tap_stride floats apart.  @p w contains @p taps x block x block weights
+	 * laid out as @p [tap][input channel][output channel].  When @p accumulate is @p false the results start from
+	 * @p bias, otherwise from the values which are already in @p dst.
+	 */
+	using BlockedKernel = void (*)(const int taps, const float * src, const size_t tap_stride, const float * w, const float * bias, const bool accumulate, float * dst);
+
+
+	/// The microkernels for one block size, which is chosen at runtime based on the CPU.
+	struct BlockedKernels final
+	{
+		const char *	name;
+		int				block;		///< number of channels per block
+		int				pixels;		///< number of pixels computed at once by @p wide
+		BlockedKernel	wide;
+		BlockedKernel	narrow;		///< 4 pixels at once
+		BlockedKernel	single;		///< 1 pixel at once
+	};
+
+
+	/// Portable version used when the CPU does not support AVX2.
+	template <int B, int XB>
+	void kernel_scalar(const int taps, const float * src, const size_t tap_stride, const float * w, const float * bias, const bool accumulate, float * dst)
+	{
+		float acc[XB][B];
+		for (int i = 0; i < XB; ++i)
+		{
+			for (int o = 0; o < B; ++o)
+			{
+				acc[i][o] = (accumulate ? dst[i * B + o] : bias[o]);
+			}
+		}
+
+		for (int t = 0; t < taps; ++t)
+		{
+			const float * const s	= src + t * tap_stride;
+			const float * const wt	= w + t * B * B;
+			for (int ic = 0; ic < B; ++ic)
+			{
+				for (int i = 0; i < XB; ++i)
+				{
+					const float v = s[i * B + ic];
+					for (int o = 0; o < B; ++o)
+					{
+						acc[i][o] += v * wt[ic * B + o];
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < XB; ++i)
+		{
+			for (int o = 0; o < B; ++o)
+			{
+				dst[i * B + o] = acc[i][o];
+			}
+		}
+
+		return;
+	}
+
+
+#if DNG_X86
+	/// Blocks of 8 channels fill one ymm register, and up to 12 pixels leaves room for the weights and the broadcast.
+	template <int XB>
+	__attribute__((target("avx2,fma")))
+	void kernel_avx2(const int taps, const float * src, const size_t tap_stride, const float * w, const float * bias, const bool accumulate, float * dst)
+	{
+		__m256 acc[XB];
+		for (int i = 0; i < XB; ++i)
+		{
+			acc[i] = _mm256_loadu_ps(accumulate ? dst + i * 8 : bias);
+		}
+
+		for (int t = 0; t < taps; ++t)
+		{
+			const float * const s	= src + t * tap_stride;
+			const float * const wt	= w + t * 64;
+			for (int ic = 0; ic < 8; ++ic)
+			{
+				const __m256 wv = _mm256_loadu_ps(wt + ic * 8);
+				for (int i = 0; i < XB; ++i)
+				{
+					acc[i] = _mm256_fmadd_ps(_mm256_broadcast_ss(s + i * 8 + ic), wv, acc[i]);
+				}
+			}
+		}
+
+		for (int i = 0; i < XB; ++i)
+		{
+			_mm256_storeu_ps(dst + i * 8, acc[i]);
+		}
+
+		return;
+	}
+
+
+	/// Blocks of 16 channels fill one zmm register, and the broadcasts are folded into the FMA instructions.
+	template <int XB>
+	__attribute__((target("avx512f")))
+	void kernel_avx512(const int taps, const float * src, const size_t tap_stride, const float * w, const float * bias, const bool accumulate, float * dst)
+	{
+		__m512 acc[XB];
+		for (int i = 0; i < XB; ++i)
+		{
+			acc[i] = _mm512_loadu_ps(accumulate ? dst + i * 16 : bias);
+		}
+
+		for (int t = 0; t < taps; ++t)
+		{
+			const float * const s	= src + t * tap_stride;
+			const float * const wt	= w + t * 256;
+			for (int ic = 0; ic < 16; ++ic)
+			{
+				const __m512 wv = _mm512_loadu_ps(wt + ic * 16);
+				for (int i = 0; i < XB; ++i)
+				{
+					acc[i] = _mm512_fmadd_ps(_mm512_set1_ps(s[i * 16 + ic]), wv, acc[i]);
+				}
+			}
+		}
+
+		for (int i = 0; i < XB; ++i)
+		{
+			_mm512_storeu_ps(dst + i * 16, acc[i]);
+		}
+
+		return;
+	}
+#endif
+
+
+	const BlockedKernels & get_blocked_kernels()
+	{
+		static const BlockedKernels kernels = []()
+		{
+#if DNG_X86
+			if (Darknet_ng::is_avx512())
+			{
+				return BlockedKernels{"avx512 NCHW16c", 16, 24, kernel_avx512<24>, kernel_avx512<4>, kernel_avx512<1>};
+			}
+			if (Darknet_ng::is_fma_avx2())
+			{
+				return BlockedKernels{"avx2 NCHW8c", 8, 12, kernel_avx2<12>, kernel_avx2<4>, kernel_avx2<1>};
+			}
+#endif
+			return BlockedKernels{"scalar NCHW8c", 8, 8, kernel_scalar<8, 8>, kernel_scalar<8, 4>, kernel_scalar<8, 1>};
+		}();
+
+		return kernels;
+	}
+
+
+	/// Reorder the weights of a convolutional layer as @p [out block][in block][ky][kx][in channel][out channel].
+	void reorder_blocked_weights(const Darknet_ng::Layer & layer, const int block, float * dst)
+	{
+		const int taps			= layer.size * layer.size;
+		const int in_blocks		= layer.c / block;
+		const int out_blocks	= layer.n / block;
+
+		#pragma omp parallel for
+		for (int ob = 0; ob < out_blocks; ++ob)
+		{
+			for (int ib = 0; ib < in_blocks; ++ib)
+			{
+				for (int t = 0; t < taps; ++t)
+				{
+					float * const w = dst + ((static_cast<size_t>(ob) * in_blocks + ib) * taps + t) * block * block;
+					for (int ic = 0; ic < block; ++ic)
+					{
+						for (int oc = 0; oc < block; ++oc)
+						{
+							const size_t filter	= ob * block + oc;
+							const size_t channel= ib * block + ic;
+							w[ic * block + oc] = layer.weights[(filter * layer.c + channel) * taps + t];
+						}
+					}
+				}
+			}
+		}
+
+		return;
+	}
+
+
+	/// Returns @p true if the layer has an NCHWc kernel and all of its channels can be split into blocks.
+	bool supports_blocked_layout(const Darknet_ng::Network & network, const Darknet_ng::Layer & layer, const int block)
+	{
+		using namespace Darknet_ng;
+
+		switch (layer.type)
+		{
+			case ELayerType::kConvolutional:
+			{
+				// the batchnorm must already be folded into the weights, and the packed weights are re-used for the new order
+				return
+					layer.fused			and
+					layer.groups == 1	and
+					layer.c % block == 0	and
+					layer.n % block == 0	and
+					not layer.binary		and
+					not layer.xnor			and
+					not layer.antialiasing	and
+					is_elementwise(layer.activation) and
+					(layer.packed_weights or layer.winograd_weights);
+			}
+			case ELayerType::kMaxPool:
+			{
+				return layer.c % block == 0 and not layer.maxpool_depth and not layer.antialiasing;
+			}
+			case ELayerType::kUpsample:
+			{
+				return layer.c % block == 0 and not layer.reverse;
+			}
+			case ELayerType::kRoute:
+			{
+				// each part copied by the route must start and end on a block, in which case the NCHW copy also works for NCHWc
+				for (int i = 0; i < layer.n; ++i)
+				{
+					const Layer & input = network.layers[layer.input_layers[i]];
+					if (input.out_c % block != 0 or (input.out_c / layer.groups) % block != 0)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+			case ELayerType::kShortcut:
+			{
+				// when every layer has the same size and whole blocks of channels, the NCHW additions also work for NCHWc
+				if (layer.c % block != 0)
+				{
+					return false;
+				}
+				for (int i = 0; i < layer.n; ++i)
+				{
+					const Layer & input = network.layers[layer.input_layers[i]];
+					if (input.out_c % block != 0 or input.out_w != layer.w or input.out_h != layer.h)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+			default:
+			{
+				// for example, the YOLO layers need plain NCHW to decode the boxes
+				return false;
+			}
+		}
+	}
+
+
+	template <int B>
+	void blocked_maxpool(Darknet_ng::Layer & layer, const float * input)
+	{
+		const int w_offset	= -layer.pad / 2;
+		const int h_offset	= -layer.pad / 2;
+		const int blocks	= layer.c / B;
+
+		#pragma omp parallel for
+		for (int bk = 0; bk < layer.batch * blocks; ++bk)
+		{
+			const float * in	= input + static_cast<size_t>(bk) * layer.h * layer.w * B;
+			float * out			= layer.output + static_cast<size_t>(bk) * layer.out_h * layer.out_w * B;
+
+			for (int i = 0; i < layer.out_h; ++i)
+			{
+				for (int j = 0; j < layer.out_w; ++j)
+				{
+					float max[B];
+					std::fill(max, max + B, -FLT_MAX);
+
+					for (int n = 0; n < layer.size; ++n)
+					{
+						const int cur_h = h_offset + i * layer.stride_y + n;
+						if (cur_h < 0 or cur_h >= layer.h)
+						{
+							continue;
+						}
+						for (int m = 0; m < layer.size; ++m)
+						{
+							const int cur_w = w_offset + j * layer.stride_x + m;
+							if (cur_w < 0 or cur_w >= layer.w)
+							{
+								continue;
+							}
+
+							// all the channels in the block are compared at once
+							const float * val = in + (cur_h * layer.w + cur_w) * B;
+							for (int c = 0; c < B; ++c)
+							{
+								max[c] = std::max(max[c], val[c]);
+							}
+						}
+					}
+
+					std::copy(max, max + B, out + (i * layer.out_w + j) * B);
+				}
+			}
+		}
+
+		return;
+	}
+
+
+	template <int B>
+	void blocked_upsample(Darknet_ng::Layer & layer, const float * input)
+	{
+		const int w			= layer.w;
+		const int h			= layer.h;
+		const int stride	= layer.stride;
+		const float scale	= layer.scale;
+		const int blocks	= layer.c / B;
+
+		#pragma omp parallel for
+		for (int bk = 0; bk < layer.batch * blocks; ++bk)
+		{
+			const float * in	= input + static_cast<size_t>(bk) * w * h * B;
+			float * out			= layer.output + static_cast<size_t>(bk) * w * h * stride * stride * B;
+			for (int j = 0; j < h * stride; ++j)
+			{
+				for (int i = 0; i < w * stride; ++i)
+				{
+					const float * src	= in + ((j / stride) * w + i / stride) * B;
+					float * dst			= out + (j * w * stride + i) * B;
+					for (int c = 0; c < B; ++c)
+					{
+						dst[c] = scale * src[c];
+					}
+				}
+			}
+		}
+
+		return;
+	}
+}
+
+
+int Darknet_ng::get_channel_block()
+{
+	return get_blocked_kernels().block;
+}
+
+
+std::string Darknet_ng::blocked_kernel_name()
+{
+	return get_blocked_kernels().name;
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::use_blocked_layout(const bool enable)
+{
+	if (settings.train)
+	{
+		/// @throw Exception The blocked layout is only implemented for inference.
+		throw Exception("cannot use the blocked NCHWc layout for a network which is being trained", DNG_LOC);
+	}
+
+	// start by putting back the plain NCHW layout
+	for (auto & layer : layers)
+	{
+		if (layer.blocked and layer.type == ELayerType::kConvolutional)
+		{
+			layer.blocked_weights = nullptr;
+			pack_convolutional_weights(layer);
+		}
+		layer.blocked = false;
+	}
+
+	const int block = (enable ? get_channel_block() : 0);
+	channel_block = block;
+
+	int blocked_count = 0;
+	if (enable)
+	{
+		for (auto & layer : layers)
+		{
+			layer.blocked = supports_blocked_layout(*this, layer, block);
+		}
+
+		/* Routes and shortcuts read the outputs of earlier layers directly, so they must use the same layout as all of
+		 * those layers.  Only the output of the previous layer (passed in as the input) can be converted by forward().
+		 */
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (auto & layer : layers)
+			{
+				if (layer.type != ELayerType::kRoute and layer.type != ELayerType::kShortcut)
+				{
+					continue;
+				}
+
+				bool same_layout = true;
+				for (int i = 0; i < layer.n; ++i)
+				{
+					same_layout = same_layout and layers[layer.input_layers[i]].blocked == layer.blocked;
+				}
+
+				if (not same_layout)
+				{
+					layer.blocked = false;
+					for (int i = 0; i < layer.n; ++i)
+					{
+						layers[layer.input_layers[i]].blocked = false;
+					}
+					changed = true;
+				}
+			}
+		}
+
+		for (auto & layer : layers)
+		{
+			if (layer.blocked and layer.type == ELayerType::kConvolutional)
+			{
+				// the packed copy of the weights is no longer needed by the GEMM, so that memory is re-used
+				layer.blocked_weights = (layer.packed_weights ? layer.packed_weights : layer.winograd_weights);
+				layer.weights_packed = false;
+				reorder_blocked_weights(layer, block, layer.blocked_weights);
+			}
+			blocked_count += (layer.blocked ? 1 : 0);
+		}
+	}
+
+	/* The input of a layer must be converted when the previous layer used a different layout.  The converted input is
+	 * stored in the workspace, after the part used by the layers themselves.
+	 */
+	size_t layer_workspace_size = 0;
+	size_t conversion_size = 0;
+	for (size_t idx = 0; idx < layers.size(); idx ++)
+	{
+		const Layer & layer = layers[idx];
+		layer_workspace_size = std::max(layer_workspace_size, layer.workspace_size);
+		if (layer.input_layer)
+		{
+			layer_workspace_size = std::max(layer_workspace_size, layer.input_layer->workspace_size);
+		}
+
+		const bool input_blocked = (idx > 0 and layers[idx - 1].blocked);
+		if (layer.type != ELayerType::kRoute and layer.blocked != input_blocked)
+		{
+			conversion_size = std::max(conversion_size, static_cast<size_t>(settings.batch) * layer.inputs);
+		}
+	}
+	if (not layers.empty() and layers.back().blocked)
+	{
+		// see predict()
+		conversion_size = std::max(conversion_size, static_cast<size_t>(settings.batch) * layers.back().outputs);
+	}
+
+	conversion_offset	= (layer_workspace_size + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+	workspace_size		= conversion_offset + conversion_size * sizeof(float);
+	allocate_workspace();
+
+	if (enable)
+	{
+		fprintf(stderr, "Using the NCHW%dc layout (%s) for %d of %d layers\n", block, get_blocked_kernels().name, blocked_count, static_cast<int>(layers.size()));
+	}
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_blocked_convolutional_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	/* Same as forward_fused_convolutional_layer(), but for the NCHWc layout.  The output pixels are split into chunks.
+	 * For each block of input channels, the pixels of the chunk needed by each tap of the kernel are copied next to each
+	 * other (with zeros for the padding), and are then used for every block of output channels.  The results for the
+	 * chunk stay in cache until all the input channels have been added and the activation has been applied.
+	 */
+
+	const BlockedKernels & kernels = get_blocked_kernels();
+	const int block			= kernels.block;
+	const int xb			= kernels.pixels;
+	const int taps			= layer.size * layer.size;
+	const int in_blocks		= layer.c / block;
+	const int out_blocks	= layer.n / block;
+	const int spatial		= layer.out_h * layer.out_w;
+	const GemmConvInput in	= get_convolutional_gemm_input(layer, nullptr);
+
+	const int chunk			= 4 * xb;
+	const int chunks		= (spatial + chunk - 1) / chunk;
+
+	// small images don't have enough chunks to keep all the threads busy, so the output blocks are also split up
+	const int threads		= omp_get_max_threads();
+	const int groups		= std::clamp((2 * threads + layer.batch * chunks - 1) / (layer.batch * chunks), 1, out_blocks);
+	const int group_size	= (out_blocks + groups - 1) / groups;
+	const int items			= layer.batch * chunks * groups;
+	const bool activate		= layer.activation != EActivation::kLinear;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int item = 0; item < items; ++item)
+	{
+		const int b				= item / (chunks * groups);
+		const int chunk_index	= (item / groups) % chunks;
+		const int group			= item % groups;
+		const int first_pixel	= chunk_index * chunk;
+		const int pixels		= std::min(chunk, spatial - first_pixel);
+		const int ob_start		= group * group_size;
+		const int ob_end		= std::min(out_blocks, ob_start + group_size);
+
+		const float * image	= state.input + static_cast<size_t>(b) * layer.inputs;
+		float * output		= layer.output + static_cast<size_t>(b) * layer.outputs;
+
+		thread_local VF staged;
+		staged.resize(static_cast<size_t>(taps) * chunk * block);
+		const size_t tap_stride = static_cast<size_t>(chunk) * block;
+
+		for (int ib = 0; ib < in_blocks; ++ib)
+		{
+			const float * channels = image + static_cast<size_t>(ib) * in.height * in.width * block;
+
+			for (int ky = 0; ky < layer.size; ++ky)
+			{
+				for (int kx = 0; kx < layer.size; ++kx)
+				{
+					float * dst = staged.data() + (ky * layer.size + kx) * tap_stride;
+					for (int p = 0; p < pixels; ++p)
+					{
+						const int y		= (first_pixel + p) / layer.out_w;
+						const int x		= (first_pixel + p) % layer.out_w;
+						const int iy	= y * in.stride_h - in.pad_h + ky * in.dilation_h;
+						const int ix	= x * in.stride_w - in.pad_w + kx * in.dilation_w;
+						if (iy < 0 or iy >= in.height or ix < 0 or ix >= in.width)
+						{
+							std::fill(dst + p * block, dst + (p + 1) * block, 0.0f);
+						}
+						else
+						{
+							std::copy_n(channels + (static_cast<size_t>(iy) * in.width + ix) * block, block, dst + p * block);
+						}
+					}
+				}
+			}
+
+			const bool accumulate = (ib > 0);
+			const bool last = (ib == in_blocks - 1);
+
+			for (int ob = ob_start; ob < ob_end; ++ob)
+			{
+				const float * w		= layer.blocked_weights + (static_cast<size_t>(ob) * in_blocks + ib) * taps * block * block;
+				const float * bias	= layer.biases + ob * block;
+				float * out			= output + (static_cast<size_t>(ob) * spatial + first_pixel) * block;
+
+				int p = 0;
+				for (; p + xb <= pixels; p += xb)
+				{
+					kernels.wide(taps, staged.data() + p * block, tap_stride, w, bias, accumulate, out + p * block);
+				}
+				for (; p + 4 <= pixels; p += 4)
+				{
+					kernels.narrow(taps, staged.data() + p * block, tap_stride, w, bias, accumulate, out + p * block);
+				}
+				for (; p < pixels; ++p)
+				{
+					kernels.single(taps, staged.data() + p * block, tap_stride, w, bias, accumulate, out + p * block);
+				}
+
+				if (last and activate)
+				{
+					// the bias is already included, and the activation is the same for every channel
+					layer.activation_kernel(out, pixels * block, 0.0f);
+				}
+			}
+		}
+	}
+
+	return;
+}
+
+
+void Darknet_ng::forward_blocked_maxpool_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	if (get_channel_block() == 16)
+	{
+		blocked_maxpool<16>(layer, state.input);
+	}
+	else
+	{
+		blocked_maxpool<8>(layer, state.input);
+	}
+
+	return;
+}
+
+
+void Darknet_ng::forward_blocked_upsample_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	if (get_channel_block() == 16)
+	{
+		blocked_upsample<16>(layer, state.input);
+	}
+	else
+	{
+		blocked_upsample<8>(layer, state.input);
+	}
+
+	return;
+}
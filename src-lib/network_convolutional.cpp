@@ -3,6 +3,29 @@
 
 #include "darknet-ng.hpp"
 #include <cmath>
+#include <omp.h>
+
+
+namespace
+{
+	/// Layers need at least this many input channels and filters to use Winograd.  @see @ref Darknet_ng::choose_convolutional_algorithm()
+	constexpr int kWinogradMinChannels = 16;
+
+	/** Layers need more than this many 4x4 output tiles per image to use Winograd.  A 13x13 output only has 16 tiles,
+	 * and those layers are slower with Winograd than with the implicit GEMM.
+	 */
+	constexpr int kWinogradMinTiles = 16;
+
+	/** Grouped layers use the direct convolution when the number of input channels times the number of filters in each
+	 * group is at most this.  Depthwise layers have 1 of each.  Larger groups are faster with the GEMM microkernel.
+	 */
+	constexpr int kGroupedMaxGroupSize = 4;
+
+	/** When the threads share the blocks of a single item, each thread needs about this many blocks for the dynamic
+	 * scheduling to keep the threads balanced.  @see @ref Darknet_ng::choose_convolutional_parallel_items()
+	 */
+	constexpr int kMinBlocksPerThread = 2;
+}
 
 
 Darknet_ng::Network & Darknet_ng::Network::parse_convolutional(const Darknet_ng::Section & section, const size_t layer_index)
@@ -62,15 +85,20 @@ Darknet_ng::Network & Darknet_ng::Network::parse_convolutional(const Darknet_ng:
 		share_layer = &layers.at(layer_index + share_index);
 	}
 
+	int h = 0;
+	int w = 0;
+	int c = 0;
+	get_input_dimensions(layer_index, h, w, c);
+
 	Layer & layer = layers.at(layer_index);
 
 	make_convolutional_layer(
 		layer,
 		settings.batch,
 		1,
-		settings.h,
-		settings.w,
-		settings.c,
+		h,
+		w,
+		c,
 		n,
 		groups,
 		size,
@@ -104,11 +132,11 @@ Darknet_ng::Network & Darknet_ng::Network::parse_convolutional(const Darknet_ng:
 	layer.stream			= section.i("stream"		, -1	);
 	layer.wait_stream_id	= section.i("wait_stream"	, -1	);
 
-	if (settings.adam)
+	if (settings.adam and layer.training)
 	{
-		layer.B1	= settings.B1;
-		layer.B2	= settings.B2;
-		layer.eps	= settings.eps;
+		layer.training->B1	= settings.B1;
+		layer.training->B2	= settings.B2;
+		layer.training->eps	= settings.eps;
 	}
 
 	//	return layer;
@@ -118,10 +146,8 @@ Darknet_ng::Network & Darknet_ng::Network::parse_convolutional(const Darknet_ng:
 
 
 // was: convolutional_layer make_convolutional_layer(int batch, int steps, int h, int w, int c, int n, int groups, int size, int stride_x, int stride_y, int dilation, int padding, ACTIVATION activation, int batch_normalize, int binary, int xnor, int adam, int use_bin_output, int index, int antialiasing, convolutional_layer *share_layer, int assisted_excitation, int deform, int train);
-Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer, int batch, int steps, int h, int w, int c, int n, int groups, int size, int stride_x, int stride_y, int dilation, int padding, Darknet_ng::EActivation activation, int batch_normalize, int binary, int xnor, int adam, int use_bin_output, int index, int antialiasing, Layer *share_layer, int assisted_excitation, int deform, int train)
+Darknet_ng::Layer & Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer, int batch, int steps, int h, int w, int c, int n, int groups, int size, int stride_x, int stride_y, int dilation, int padding, Darknet_ng::EActivation activation, int batch_normalize, int binary, int xnor, int adam, int use_bin_output, int index, int antialiasing, Layer *share_layer, int assisted_excitation, int deform, int train)
 {
-	int total_batch = batch * steps;
-	int i;
 //	Layer layer = {0};// = { (LAYER_TYPE)0 };
 //	layer = {0};
 	layer.type = ELayerType::kConvolutional;
@@ -160,7 +186,12 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 	layer.size = size;
 	layer.pad = padding;
 	layer.batch_normalize = batch_normalize;
-	layer.learning_rate_scale = 1;
+	if (train)
+	{
+		// the training state is only allocated when it is needed, so inference-only networks stay compact
+		layer.training = std::make_shared<LayerTraining>();
+		layer.training->learning_rate_scale = 1;
+	}
 	layer.nweights = (c / groups) * n * size * size;
 
 	if (layer.share_layer)
@@ -170,46 +201,11 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 			printf(" Layer size, nweights, channels or filters don't match for the share_layer");
 			getchar(); ///< @todo
 		}
-
-		layer.weights = layer.share_layer->weights;
-		layer.weight_updates = layer.share_layer->weight_updates;
-
-		layer.biases = layer.share_layer->biases;
-		layer.bias_updates = layer.share_layer->bias_updates;
 	}
-	else
-	{
-		layer.weights = (float*)xcalloc(layer.nweights, sizeof(float));
-		layer.biases = (float*)xcalloc(n, sizeof(float));
 
-		if (train)
-		{
-			layer.weight_updates = (float*)xcalloc(layer.nweights, sizeof(float));
-			layer.bias_updates = (float*)xcalloc(n, sizeof(float));
-
-			layer.weights_ema = (float*)xcalloc(layer.nweights, sizeof(float));
-			layer.biases_ema = (float*)xcalloc(n, sizeof(float));
-		}
-	}
-
-	// float scale = 1./sqrt(size*size*c);
-	float scale = std::sqrt(2.0f / (size * size * c / groups));
-	if (layer.activation == EActivation::kNormCHAN			or
-		layer.activation == EActivation::kNormCHANSoftmax	or
-		layer.activation == EActivation::kNormCHANSoftmaxMaxVal)
-	{
-		for (i = 0; i < layer.nweights; ++i)
-		{
-			layer.weights[i] = 1;   // rand_normal();
-		}
-	}
-	else
-	{
-		for (i = 0; i < layer.nweights; ++i)
-		{
-			layer.weights[i] = scale * rand_uniform(-1, 1);   // rand_normal();
-		}
-	}
+	/* None of the buffers are allocated here.  Once all the layers have been created, they are carved out of the
+	 * network arena by carve_convolutional_layer() and then initialized by init_convolutional_layer().
+	 */
 
 	const int out_h		= convolutional_out_height(layer);
 	const int out_w		= convolutional_out_width(layer);
@@ -220,229 +216,137 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 	layer.outputs		= layer.out_h * layer.out_w * layer.out_c;
 	layer.inputs		= layer.w * layer.h * layer.c;
 	layer.activation	= activation;
-
-	layer.output = (float*)xcalloc(total_batch*layer.outputs, sizeof(float));
-	#ifndef GPU
-	if (train)
-	{
-		layer.delta = (float*)xcalloc(total_batch * layer.outputs, sizeof(float));
-	}
-	#endif  // not GPU
-
-#if STEPHANE /// @todo
-	layer.forward	= forward_convolutional_layer;
-	layer.backward	= backward_convolutional_layer;
-	layer.update	= update_convolutional_layer;
-#endif
-
-	if (binary)
-	{
-		layer.binary_weights = (float*)xcalloc(layer.nweights, sizeof(float));
-		layer.cweights = (char*)xcalloc(layer.nweights, sizeof(char));
-		layer.scales = (float*)xcalloc(n, sizeof(float));
-	}
+	layer.activation_kernel = (is_elementwise(activation) ? get_activation_kernel(activation) : nullptr);
 
 	if (xnor)
 	{
-		layer.binary_weights = (float*)xcalloc(layer.nweights, sizeof(float));
-		layer.binary_input = (float*)xcalloc(layer.inputs * layer.batch, sizeof(float));
-
 		int align = 32;// 8;
 		int src_align = layer.out_h * layer.out_w;
 		layer.bit_align = src_align + (align - src_align % align);
-
-		layer.mean_arr = (float*)xcalloc(layer.n, sizeof(float));
-
-		const size_t new_c = layer.c / 32;
-		size_t in_re_packed_input_size = new_c * layer.w * layer.h + 1;
-		layer.bin_re_packed_input = (uint32_t*)xcalloc(in_re_packed_input_size, sizeof(uint32_t));
-
 		layer.lda_align = 256;  // AVX2
-		int k = layer.size * layer.size * layer.c;
-		size_t k_aligned = k + (layer.lda_align - k % layer.lda_align);
-		size_t t_bit_input_size = k_aligned * layer.bit_align / 8;
-		layer.t_bit_input = (char*)xcalloc(t_bit_input_size, sizeof(char));
 	}
 
-	if (batch_normalize)
-	{
-		if (layer.share_layer)
-		{
-			layer.scales			= layer.share_layer->scales;
-			layer.scale_updates		= layer.share_layer->scale_updates;
-			layer.mean				= layer.share_layer->mean;
-			layer.variance			= layer.share_layer->variance;
-			layer.mean_delta		= layer.share_layer->mean_delta;
-			layer.variance_delta	= layer.share_layer->variance_delta;
-			layer.rolling_mean		= layer.share_layer->rolling_mean;
-			layer.rolling_variance	= layer.share_layer->rolling_variance;
-		}
-		else
-		{
-			layer.scales = (float*)xcalloc(n, sizeof(float));
-			for (i = 0; i < n; ++i)
-			{
-				layer.scales[i] = 1;
-			}
-			if (train)
-			{
-				layer.scales_ema		= (float*)xcalloc(n, sizeof(float));
-				layer.scale_updates		= (float*)xcalloc(n, sizeof(float));
-
-				layer.mean				= (float*)xcalloc(n, sizeof(float));
-				layer.variance			= (float*)xcalloc(n, sizeof(float));
-
-				layer.mean_delta		= (float*)xcalloc(n, sizeof(float));
-				layer.variance_delta	= (float*)xcalloc(n, sizeof(float));
-			}
-
-			layer.rolling_mean		= (float*)xcalloc(n, sizeof(float));
-			layer.rolling_variance	= (float*)xcalloc(n, sizeof(float));
-		}
-
-		#ifndef GPU
-		if (train)
-		{
-			layer.x = (float*)xcalloc(total_batch * layer.outputs, sizeof(float));
-			layer.x_norm = (float*)xcalloc(total_batch * layer.outputs, sizeof(float));
-		}
-		#endif  // not GPU
-	}
-
-	#ifndef GPU
-	if (layer.activation == EActivation::kSWISH	or
-		layer.activation == EActivation::kMISH	or
-		layer.activation == EActivation::kHardMISH)
-	{
-		layer.activation_input = (float*)calloc(total_batch * layer.outputs, sizeof(float));
-	}
-	#endif  // not GPU
-
 	if (adam)
 	{
 		layer.adam = 1;
-		layer.m = (float*)xcalloc(layer.nweights, sizeof(float));
-		layer.v = (float*)xcalloc(layer.nweights, sizeof(float));
-		layer.bias_m = (float*)xcalloc(n, sizeof(float));
-		layer.scale_m = (float*)xcalloc(n, sizeof(float));
-		layer.bias_v = (float*)xcalloc(n, sizeof(float));
-		layer.scale_v = (float*)xcalloc(n, sizeof(float));
 	}
 
 	#ifdef GPU
+	const int total_batch = batch * steps;
 
-	layer.forward_gpu = forward_convolutional_layer_gpu;
-	layer.backward_gpu = backward_convolutional_layer_gpu;
-	layer.update_gpu = update_convolutional_layer_gpu;
+	layer.gpu = std::make_shared<LayerGPU>();
+	layer.gpu->forward_gpu = forward_convolutional_layer_gpu;
+	layer.gpu->backward_gpu = backward_convolutional_layer_gpu;
+	layer.gpu->update_gpu = update_convolutional_layer_gpu;
 
 	if(gpu_index >= 0)
 	{
 		if (train && (layer.activation == SWISH or layer.activation == MISH or layer.activation == HARD_MISH))
 		{
-			layer.activation_input_gpu = cuda_make_array(layer.activation_input, total_batch * layer.outputs);
+			layer.gpu->activation_input_gpu = cuda_make_array(layer.activation_input, total_batch * layer.outputs);
 		}
 
 		if (layer.deform)
 		{
-			layer.weight_deform_gpu = cuda_make_array(NULL, layer.nweights);
+			layer.gpu->weight_deform_gpu = cuda_make_array(NULL, layer.nweights);
 		}
 
 		if (adam)
 		{
-			layer.m_gpu = cuda_make_array(layer.m, layer.nweights);
-			layer.v_gpu = cuda_make_array(layer.v, layer.nweights);
-			layer.bias_m_gpu = cuda_make_array(layer.bias_m, n);
-			layer.bias_v_gpu = cuda_make_array(layer.bias_v, n);
-			layer.scale_m_gpu = cuda_make_array(layer.scale_m, n);
-			layer.scale_v_gpu = cuda_make_array(layer.scale_v, n);
+			layer.gpu->m_gpu = cuda_make_array(layer.training->m, layer.nweights);
+			layer.gpu->v_gpu = cuda_make_array(layer.training->v, layer.nweights);
+			layer.gpu->bias_m_gpu = cuda_make_array(layer.training->bias_m, n);
+			layer.gpu->bias_v_gpu = cuda_make_array(layer.training->bias_v, n);
+			layer.gpu->scale_m_gpu = cuda_make_array(layer.training->scale_m, n);
+			layer.gpu->scale_v_gpu = cuda_make_array(layer.training->scale_v, n);
 		}
 		if (l.share_layer)
 		{
-			layer.weights_gpu = layer.share_layer->weights_gpu;
-			layer.weight_updates_gpu = layer.share_layer->weight_updates_gpu;
-			layer.weights_gpu16 = layer.share_layer->weights_gpu16;
-			layer.weight_updates_gpu16 = layer.share_layer->weight_updates_gpu16;
-			layer.biases_gpu = layer.share_layer->biases_gpu;
-			layer.bias_updates_gpu = layer.share_layer->bias_updates_gpu;
+			layer.gpu->weights_gpu = layer.share_layer->gpu->weights_gpu;
+			layer.gpu->weight_updates_gpu = layer.share_layer->gpu->weight_updates_gpu;
+			layer.gpu->weights_gpu16 = layer.share_layer->gpu->weights_gpu16;
+			layer.gpu->weight_updates_gpu16 = layer.share_layer->gpu->weight_updates_gpu16;
+			layer.gpu->biases_gpu = layer.share_layer->gpu->biases_gpu;
+			layer.gpu->bias_updates_gpu = layer.share_layer->gpu->bias_updates_gpu;
 		}
 		else
 		{
-			layer.weights_gpu = cuda_make_array(layer.weights, layer.nweights);
+			layer.gpu->weights_gpu = cuda_make_array(layer.weights, layer.nweights);
 			if (train)
 			{
-				layer.weight_updates_gpu = cuda_make_array(layer.weight_updates, layer.nweights);
+				layer.gpu->weight_updates_gpu = cuda_make_array(layer.training->weight_updates, layer.nweights);
 			}
 			#ifdef CUDNN_HALF
-			layer.weights_gpu16 = cuda_make_array(NULL, layer.nweights / 2 + 1);
+			layer.gpu->weights_gpu16 = cuda_make_array(NULL, layer.nweights / 2 + 1);
 			if (train)
 			{
-				layer.weight_updates_gpu16 = cuda_make_array(NULL, layer.nweights / 2 + 1);
+				layer.gpu->weight_updates_gpu16 = cuda_make_array(NULL, layer.nweights / 2 + 1);
 			}
 			#endif  // CUDNN_HALF
-			layer.biases_gpu = cuda_make_array(layer.biases, n);
+			layer.gpu->biases_gpu = cuda_make_array(layer.biases, n);
 			if (train)
 			{
-				layer.bias_updates_gpu = cuda_make_array(layer.bias_updates, n);
+				layer.gpu->bias_updates_gpu = cuda_make_array(layer.training->bias_updates, n);
 			}
 		}
 
-		layer.output_gpu = cuda_make_array(layer.output, total_batch * out_h * out_w * n);
+		layer.gpu->output_gpu = cuda_make_array(layer.output, total_batch * out_h * out_w * n);
 		if (train)
 		{
-			layer.delta_gpu = cuda_make_array(layer.delta, total_batch * out_h * out_w * n);
+			layer.gpu->delta_gpu = cuda_make_array(layer.training->delta, total_batch * out_h * out_w * n);
 		}
 
 		if (binary)
 		{
-			layer.binary_weights_gpu = cuda_make_array(layer.weights, layer.nweights);
+			layer.gpu->binary_weights_gpu = cuda_make_array(layer.weights, layer.nweights);
 		}
 		if (xnor)
 		{
-			layer.binary_weights_gpu = cuda_make_array(layer.weights, layer.nweights);
-			layer.mean_arr_gpu = cuda_make_array(0, layer.n);
-			layer.binary_input_gpu = cuda_make_array(0, layer.inputs * layer.batch);
+			layer.gpu->binary_weights_gpu = cuda_make_array(layer.weights, layer.nweights);
+			layer.gpu->mean_arr_gpu = cuda_make_array(0, layer.n);
+			layer.gpu->binary_input_gpu = cuda_make_array(0, layer.inputs * layer.batch);
 		}
 
 		if (batch_normalize)
 		{
 			if (layer.share_layer)
 			{
-				layer.scales_gpu = layer.share_layer->scales_gpu;
-				layer.scale_updates_gpu = layer.share_layer->scale_updates_gpu;
-				layer.mean_gpu = layer.share_layer->mean_gpu;
-				layer.variance_gpu = layer.share_layer->variance_gpu;
-				layer.rolling_mean_gpu = layer.share_layer->rolling_mean_gpu;
-				layer.rolling_variance_gpu = layer.share_layer->rolling_variance_gpu;
-				layer.mean_delta_gpu = layer.share_layer->mean_delta_gpu;
-				layer.variance_delta_gpu = layer.share_layer->variance_delta_gpu;
+				layer.gpu->scales_gpu = layer.share_layer->gpu->scales_gpu;
+				layer.gpu->scale_updates_gpu = layer.share_layer->gpu->scale_updates_gpu;
+				layer.gpu->mean_gpu = layer.share_layer->gpu->mean_gpu;
+				layer.gpu->variance_gpu = layer.share_layer->gpu->variance_gpu;
+				layer.gpu->rolling_mean_gpu = layer.share_layer->gpu->rolling_mean_gpu;
+				layer.gpu->rolling_variance_gpu = layer.share_layer->gpu->rolling_variance_gpu;
+				layer.gpu->mean_delta_gpu = layer.share_layer->gpu->mean_delta_gpu;
+				layer.gpu->variance_delta_gpu = layer.share_layer->gpu->variance_delta_gpu;
 			}
 			else
 			{
-				layer.scales_gpu = cuda_make_array(layer.scales, n);
+				layer.gpu->scales_gpu = cuda_make_array(layer.scales, n);
 
 				if (train)
 				{
-					layer.scale_updates_gpu = cuda_make_array(layer.scale_updates, n);
+					layer.gpu->scale_updates_gpu = cuda_make_array(layer.training->scale_updates, n);
 
-					layer.mean_gpu = cuda_make_array(layer.mean, n);
-					layer.variance_gpu = cuda_make_array(layer.variance, n);
-					layer.m_cbn_avg_gpu = cuda_make_array(layer.mean, n);
-					layer.v_cbn_avg_gpu = cuda_make_array(layer.variance, n);
+					layer.gpu->mean_gpu = cuda_make_array(layer.training->mean, n);
+					layer.gpu->variance_gpu = cuda_make_array(layer.training->variance, n);
+					layer.gpu->m_cbn_avg_gpu = cuda_make_array(layer.training->mean, n);
+					layer.gpu->v_cbn_avg_gpu = cuda_make_array(layer.training->variance, n);
 					#ifndef CUDNN
-					layer.mean_delta_gpu = cuda_make_array(layer.mean, n);
-					layer.variance_delta_gpu = cuda_make_array(layer.variance, n);
+					layer.gpu->mean_delta_gpu = cuda_make_array(layer.training->mean, n);
+					layer.gpu->variance_delta_gpu = cuda_make_array(layer.training->variance, n);
 					#endif  // CUDNN
 				}
 
-				layer.rolling_mean_gpu = cuda_make_array(layer.mean, n);
-				layer.rolling_variance_gpu = cuda_make_array(layer.variance, n);
+				layer.gpu->rolling_mean_gpu = cuda_make_array(layer.training->mean, n);
+				layer.gpu->rolling_variance_gpu = cuda_make_array(layer.training->variance, n);
 			}
 
 			if (train)
 			{
-				layer.x_gpu = cuda_make_array(l.output, total_batch * out_h * out_w  *n);
+				layer.gpu->x_gpu = cuda_make_array(l.output, total_batch * out_h * out_w  *n);
 				#ifndef CUDNN
-				layer.x_norm_gpu = cuda_make_array(layer.output, total_batch * out_h * out_w * n);
+				layer.gpu->x_norm_gpu = cuda_make_array(layer.output, total_batch * out_h * out_w * n);
 				#endif  // CUDNN
 			}
 		}
@@ -450,8 +354,8 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 		if (layer.assisted_excitation)
 		{
 			const int size = layer.out_w * layer.out_h * layer.batch;
-			layer.gt_gpu = cuda_make_array(NULL, size);
-			layer.a_avg_gpu = cuda_make_array(NULL, size);
+			layer.gpu->gt_gpu = cuda_make_array(NULL, size);
+			layer.gpu->a_avg_gpu = cuda_make_array(NULL, size);
 		}
 		#ifdef CUDNN
 		create_convolutional_cudnn_tensors(&layer);
@@ -459,7 +363,7 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 		#endif  // CUDNN
 	}
 	#endif  // GPU
-	layer.workspace_size = get_convolutional_workspace_size(layer);
+	set_convolutional_algorithm(layer, choose_convolutional_algorithm(layer));
 
 	//fprintf(stderr, "conv  %5d %2d x%2d /%2d  %4d x%4d x%4d   ->  %4d x%4d x%4d\n", n, size, size, stride, w, h, c, l.out_w, l.out_h, l.out_c);
 	layer.bflops = (2.0 * layer.nweights * layer.out_h * layer.out_w) / 1000000000.0f;
@@ -520,7 +424,7 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 	if (layer.antialiasing)
 	{
 		printf("AA:  ");
-		layer.input_layer = (Layer*)calloc(1, sizeof(Layer)); // I think this line had a bug in the memory it would allocate
+		layer.input_layer = new Layer(); // value-initialized, so all the fields start as zero
 		int blur_size = 3;
 		int blur_pad = blur_size / 2;
 		if (layer.antialiasing == 2)
@@ -529,50 +433,275 @@ Darknet_ng::Layer Darknet_ng::make_convolutional_layer(Darknet_ng::Layer & layer
 			blur_pad = 0;
 		}
 		make_convolutional_layer(*layer.input_layer, batch, steps, out_h, out_w, n, n, n, blur_size, blur_stride_x, blur_stride_y, 1, blur_pad, EActivation::kLinear, 0, 0, 0, 0, 0, index, 0, NULL, 0, 0, train);
-		const int blur_nweights = n * blur_size * blur_size;  // (n / n) * n * blur_size * blur_size;
-		int i;
-		if (blur_size == 2)
+		// the blur weights are set in init_convolutional_layer() once the arena has been allocated
+		#ifdef GPU
+		if (gpu_index >= 0)
+		{
+			layer.gpu->input_antialiasing_gpu = cuda_make_array(NULL, layer.batch * layer.outputs);
+			push_convolutional_layer(*(layer.input_layer));
+		}
+		#endif  // GPU
+	}
+
+	return layer;
+}
+
+
+void Darknet_ng::carve_convolutional_layer(Darknet_ng::Arena & arena, Darknet_ng::Layer & layer)
+{
+	// this must make the exact same sequence of calls to carve() every time it is called for a given layer
+
+	const size_t total_batch	= layer.batch * layer.steps;
+	const size_t n				= layer.n;
+	const size_t nweights		= layer.nweights;
+
+	if (layer.share_layer == nullptr)
+	{
+		// shared layers point to the weights in the original layer, see init_convolutional_layer()
+		layer.weights	= arena.carve<float>(nweights);
+		layer.biases	= arena.carve<float>(n);
+
+		if (layer.training)
 		{
-			for (i = 0; i < blur_nweights; i += (blur_size*blur_size))
+			layer.training->weight_updates	= arena.carve<float>(nweights);
+			layer.training->bias_updates	= arena.carve<float>(n);
+
+			layer.training->weights_ema		= arena.carve<float>(nweights);
+			layer.training->biases_ema		= arena.carve<float>(n);
+		}
+	}
+
+	if (not layer.training and not layer.binary and not layer.xnor and layer.share_layer == nullptr)
+	{
+		// inference uses a 2nd copy of the weights which is already packed for the GEMM microkernel
+		const int m = layer.n / layer.groups;
+		const int k = layer.size * layer.size * layer.c / layer.groups;
+
+		// look at the shape instead of conv_algorithm, which is changed if the layer falls back to the implicit GEMM
+		const EConvAlgorithm algorithm = choose_convolutional_algorithm(layer);
+		if (algorithm == EConvAlgorithm::kWinograd)
+		{
+			layer.winograd_weights = arena.carve<float>(winograd_filters_size(layer.n, layer.c));
+		}
+		else if (algorithm != EConvAlgorithm::kGrouped)
+		{
+			layer.packed_weights = arena.carve<float>(gemm_packed_a_size(m, k) * layer.groups);
+		}
+	}
+
+	// the output of the layer is carved out by Network::allocate_layers() since it may be shared with other layers
+
+	#ifndef GPU
+	if (layer.training)
+	{
+		layer.training->delta = arena.carve<float>(total_batch * layer.outputs);
+	}
+	#endif  // not GPU
+
+	if (layer.binary)
+	{
+		layer.binary_weights	= arena.carve<float>(nweights);
+		layer.cweights			= arena.carve<char>(nweights);
+		if (layer.batch_normalize == 0)
+		{
+			// when batch normalization is enabled the scales are carved out below
+			layer.scales		= arena.carve<float>(n);
+		}
+	}
+
+	if (layer.xnor)
+	{
+		layer.mean_arr = arena.carve<float>(n);
+	}
+	carve_convolutional_scratch(arena, layer);
+
+	if (layer.batch_normalize)
+	{
+		if (layer.share_layer == nullptr)
+		{
+			layer.scales = arena.carve<float>(n);
+			if (layer.training)
 			{
-				layer.input_layer->weights[i + 0] = 1 / 4.f;
-				layer.input_layer->weights[i + 1] = 1 / 4.f;
-				layer.input_layer->weights[i + 2] = 1 / 4.f;
-				layer.input_layer->weights[i + 3] = 1 / 4.f;
+				layer.training->scales_ema		= arena.carve<float>(n);
+				layer.training->scale_updates	= arena.carve<float>(n);
+
+				layer.training->mean			= arena.carve<float>(n);
+				layer.training->variance		= arena.carve<float>(n);
+
+				layer.training->mean_delta		= arena.carve<float>(n);
+				layer.training->variance_delta	= arena.carve<float>(n);
 			}
+
+			layer.rolling_mean		= arena.carve<float>(n);
+			layer.rolling_variance	= arena.carve<float>(n);
 		}
-		else
+
+		#ifndef GPU
+		if (layer.training)
+		{
+			layer.training->x		= arena.carve<float>(total_batch * layer.outputs);
+			layer.training->x_norm	= arena.carve<float>(total_batch * layer.outputs);
+		}
+		#endif  // not GPU
+	}
+
+	#ifndef GPU
+	// the values before the activation are only needed by the backward pass
+	if (layer.training and (
+		layer.activation == EActivation::kSWISH	or
+		layer.activation == EActivation::kMISH	or
+		layer.activation == EActivation::kHardMISH))
+	{
+		layer.activation_input = arena.carve<float>(total_batch * layer.outputs);
+	}
+	#endif  // not GPU
+
+	if (layer.adam and layer.training)
+	{
+		layer.training->m		= arena.carve<float>(nweights);
+		layer.training->v		= arena.carve<float>(nweights);
+		layer.training->bias_m	= arena.carve<float>(n);
+		layer.training->scale_m	= arena.carve<float>(n);
+		layer.training->bias_v	= arena.carve<float>(n);
+		layer.training->scale_v	= arena.carve<float>(n);
+	}
+
+	if (layer.input_layer)
+	{
+		// antialiasing uses a 2nd convolutional layer to blur the output
+		carve_convolutional_layer(arena, *layer.input_layer);
+		layer.input_layer->output = arena.carve<float>(total_batch * layer.input_layer->outputs);
+	}
+
+	return;
+}
+
+
+void Darknet_ng::carve_convolutional_scratch(Darknet_ng::Arena & arena, Darknet_ng::Layer & layer)
+{
+	if (layer.xnor)
+	{
+		// forward_convolutional_layer() binarizes the weights and the input into these, and swaps the weights
+		layer.binary_weights	= arena.carve<float>(layer.nweights);
+		layer.binary_input		= arena.carve<float>(layer.inputs * layer.batch);
+
+		const size_t new_c = layer.c / 32;
+		const size_t in_re_packed_input_size = new_c * layer.w * layer.h + 1;
+		layer.bin_re_packed_input = arena.carve<uint32_t>(in_re_packed_input_size);
+
+		const size_t k = layer.size * layer.size * layer.c;
+		const size_t k_aligned = k + (layer.lda_align - k % layer.lda_align);
+		const size_t t_bit_input_size = k_aligned * layer.bit_align / 8;
+		layer.t_bit_input = arena.carve<char>(t_bit_input_size);
+	}
+
+	return;
+}
+
+
+void Darknet_ng::init_convolutional_layer(Darknet_ng::Layer & layer)
+{
+	if (layer.share_layer)
+	{
+		const Layer & shared = *layer.share_layer;
+
+		layer.weights	= shared.weights;
+		layer.biases	= shared.biases;
+
+		if (layer.batch_normalize)
 		{
-			for (i = 0; i < blur_nweights; i += (blur_size*blur_size)) {
-				layer.input_layer->weights[i + 0] = 1 / 16.0f;
-				layer.input_layer->weights[i + 1] = 2 / 16.0f;
-				layer.input_layer->weights[i + 2] = 1 / 16.0f;
+			layer.scales			= shared.scales;
+			layer.rolling_mean		= shared.rolling_mean;
+			layer.rolling_variance	= shared.rolling_variance;
+		}
 
-				layer.input_layer->weights[i + 3] = 2 / 16.0f;
-				layer.input_layer->weights[i + 4] = 4 / 16.0f;
-				layer.input_layer->weights[i + 5] = 2 / 16.0f;
+		if (layer.training and shared.training)
+		{
+			layer.training->weight_updates	= shared.training->weight_updates;
+			layer.training->bias_updates	= shared.training->bias_updates;
+
+			if (layer.batch_normalize)
+			{
+				layer.training->scale_updates	= shared.training->scale_updates;
+				layer.training->mean			= shared.training->mean;
+				layer.training->variance		= shared.training->variance;
+				layer.training->mean_delta		= shared.training->mean_delta;
+				layer.training->variance_delta	= shared.training->variance_delta;
+			}
+		}
+	}
+	else
+	{
+		// float scale = 1./sqrt(size*size*c);
+		const float scale = std::sqrt(2.0f / (layer.size * layer.size * layer.c / layer.groups));
+		if (layer.activation == EActivation::kNormCHAN			or
+			layer.activation == EActivation::kNormCHANSoftmax	or
+			layer.activation == EActivation::kNormCHANSoftmaxMaxVal)
+		{
+			for (int i = 0; i < layer.nweights; ++i)
+			{
+				layer.weights[i] = 1;   // rand_normal();
+			}
+		}
+		else
+		{
+			for (int i = 0; i < layer.nweights; ++i)
+			{
+				layer.weights[i] = scale * rand_uniform(-1, 1);   // rand_normal();
+			}
+		}
 
-				layer.input_layer->weights[i + 6] = 1 / 16.0f;
-				layer.input_layer->weights[i + 7] = 2 / 16.0f;
-				layer.input_layer->weights[i + 8] = 1 / 16.0f;
+		if (layer.batch_normalize)
+		{
+			for (int i = 0; i < layer.n; ++i)
+			{
+				layer.scales[i] = 1;
 			}
 		}
+	}
+
+	if (layer.input_layer)
+	{
+		Layer & blur = *layer.input_layer;
+		init_convolutional_layer(blur);
 
-		for (i = 0; i < n; ++i)
+		const int blur_size = blur.size;
+		const int blur_nweights = blur.nweights;  // (n / n) * n * blur_size * blur_size;
+		if (blur_size == 2)
 		{
-			layer.input_layer->biases[i] = 0;
+			for (int i = 0; i < blur_nweights; i += (blur_size*blur_size))
+			{
+				blur.weights[i + 0] = 1 / 4.f;
+				blur.weights[i + 1] = 1 / 4.f;
+				blur.weights[i + 2] = 1 / 4.f;
+				blur.weights[i + 3] = 1 / 4.f;
+			}
 		}
+		else
+		{
+			for (int i = 0; i < blur_nweights; i += (blur_size*blur_size))
+			{
+				blur.weights[i + 0] = 1 / 16.0f;
+				blur.weights[i + 1] = 2 / 16.0f;
+				blur.weights[i + 2] = 1 / 16.0f;
 
-		#ifdef GPU
-		if (gpu_index >= 0)
+				blur.weights[i + 3] = 2 / 16.0f;
+				blur.weights[i + 4] = 4 / 16.0f;
+				blur.weights[i + 5] = 2 / 16.0f;
+
+				blur.weights[i + 6] = 1 / 16.0f;
+				blur.weights[i + 7] = 2 / 16.0f;
+				blur.weights[i + 8] = 1 / 16.0f;
+			}
+		}
+
+		for (int i = 0; i < blur.n; ++i)
 		{
-			layer.input_antialiasing_gpu = cuda_make_array(NULL, layer.batch * layer.outputs);
-			push_convolutional_layer(*(layer.input_layer));
+			blur.biases[i] = 0;
 		}
-		#endif  // GPU
 	}
 
-	return layer;
+	return;
 }
 
 
@@ -590,6 +719,25 @@ int Darknet_ng::convolutional_out_height(const Layer & layer)
 
 size_t Darknet_ng::get_convolutional_workspace_size(const Layer & layer)
 {
+	if (layer.conv_algorithm == EConvAlgorithm::kWinograd)
+	{
+		// the transformed tiles of each thread, or of each item when the items run side-by-side on a single thread each
+		const int threads = (layer.parallel_items > 1 ? 1 : omp_get_max_threads());
+		return winograd_workspace_size(layer.n / layer.groups, get_convolutional_gemm_input(layer, nullptr), threads);
+	}
+
+	if (layer.conv_algorithm == EConvAlgorithm::kImplicitGEMM or layer.conv_algorithm == EConvAlgorithm::kWinograd or layer.conv_algorithm == EConvAlgorithm::kGrouped)
+	{
+		// the input is read directly by gemm_conv() and grouped_conv(), the im2col matrix is never written out
+		return 0;
+	}
+
+	if (not layer.train and not layer.xnor and layer.size == 1 and layer.stride_x == 1 and layer.stride_y == 1 and layer.dilation == 1)
+	{
+		// 1x1 layers pass the input straight to gemm() during inference
+		return 0;
+	}
+
 	size_t workspace_size	= get_workspace_size32(layer);
 	size_t workspace_size16	= get_workspace_size16(layer);
 	if (workspace_size16 > workspace_size)
@@ -601,13 +749,144 @@ size_t Darknet_ng::get_convolutional_workspace_size(const Layer & layer)
 }
 
 
+int Darknet_ng::get_convolutional_winograd_threads(const Darknet_ng::Layer & layer)
+{
+	if (layer.parallel_items > 1)
+	{
+		return 1;
+	}
+
+	// the workspace was sized for omp_get_max_threads() when the layer was set up, which may have changed since then
+	const size_t thread_size = winograd_workspace_size(layer.n / layer.groups, get_convolutional_gemm_input(layer, nullptr), 1);
+	const int threads = static_cast<int>(layer.workspace_size / thread_size);
+
+	return std::max(1, std::min(threads, omp_get_max_threads()));
+}
+
+
+Darknet_ng::EConvAlgorithm Darknet_ng::choose_convolutional_algorithm(const Darknet_ng::Layer & layer)
+{
+	if (layer.train or layer.binary or layer.xnor)
+	{
+		// the backward pass and the binary layers work on the im2col matrix in the workspace
+		return EConvAlgorithm::kIm2col;
+	}
+
+	if (layer.size == 1 and layer.stride_x == 1 and layer.stride_y == 1 and layer.dilation == 1)
+	{
+		// the input already is the B matrix, so there is nothing to gather and im2col is skipped
+		return EConvAlgorithm::kIm2col;
+	}
+
+	if (layer.groups > 1 and (layer.c / layer.groups) * (layer.n / layer.groups) <= kGroupedMaxGroupSize)
+	{
+		// the GEMM of each group would only have a few rows and a short K, so packing it costs more than it saves
+		return EConvAlgorithm::kGrouped;
+	}
+
+	const int tiles = ((layer.out_w + 3) / 4) * ((layer.out_h + 3) / 4);
+	if (layer.size == 3 and layer.stride_x == 1 and layer.stride_y == 1 and layer.dilation == 1 and layer.groups == 1 and
+		layer.c >= kWinogradMinChannels and layer.n >= kWinogradMinChannels and tiles > kWinogradMinTiles)
+	{
+		// with few channels the transforms cost more than the multiplications saved, and with few tiles the 36 GEMMs
+		// spend their time reading the transformed filters
+		return EConvAlgorithm::kWinograd;
+	}
+
+	return EConvAlgorithm::kImplicitGEMM;
+}
+
+
+void Darknet_ng::set_convolutional_algorithm(Darknet_ng::Layer & layer, const Darknet_ng::EConvAlgorithm algorithm)
+{
+	layer.conv_algorithm = algorithm;
+	layer.parallel_items = choose_convolutional_parallel_items(layer);
+	layer.workspace_size = get_convolutional_workspace_size(layer);
+	if (layer.parallel_items > 1)
+	{
+		// one aligned slice of the workspace for each item which runs at the same time
+		const size_t slice = (layer.workspace_size + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+		layer.workspace_size = slice * layer.parallel_items;
+	}
+
+	return;
+}
+
+
+int Darknet_ng::choose_convolutional_parallel_items(const Darknet_ng::Layer & layer)
+{
+	const int threads = omp_get_max_threads();
+	const int items = layer.batch * (layer.conv_algorithm == EConvAlgorithm::kGrouped ? 1 : layer.groups);
+
+	if (threads < 2 or items < 2 or layer.xnor)
+	{
+		// the XNOR code uses buffers which belong to the layer, so it cannot run on several items at once
+		return 1;
+	}
+
+	// how many blocks of work a single item can give to the threads
+	int blocks = 0;
+	switch (layer.conv_algorithm)
+	{
+		case EConvAlgorithm::kGrouped:	blocks = layer.n;						break;	// one filter per block
+		case EConvAlgorithm::kWinograd:	blocks = (layer.out_h + 3) / 4;			break;	// at most one row of 4x4 tiles per block
+		default:						blocks = gemm_parallel_blocks(layer.n / layer.groups, layer.out_h * layer.out_w);	break;
+	}
+
+	// compare how many threads are kept busy by splitting each item against running the items side-by-side
+	const int busy_within_item	= std::min(threads, blocks / kMinBlocksPerThread);
+	const int busy_across_items	= std::min(threads, items);
+	if (busy_across_items <= busy_within_item)
+	{
+		return 1;
+	}
+
+	return busy_across_items;
+}
+
+
+Darknet_ng::GemmConvInput Darknet_ng::get_convolutional_gemm_input(const Darknet_ng::Layer & layer, const float * im)
+{
+	GemmConvInput input;
+	input.image			= im;
+	input.channels		= layer.c / layer.groups;
+	input.height		= layer.h;
+	input.width			= layer.w;
+	input.kernel_h		= layer.size;
+	input.kernel_w		= layer.size;
+	input.pad_h			= layer.pad * layer.dilation;	// same as the call to im2col_cpu_ext()
+	input.pad_w			= layer.pad * layer.dilation;
+	input.stride_h		= layer.stride_y;
+	input.stride_w		= layer.stride_x;
+	input.dilation_h	= layer.dilation;
+	input.dilation_w	= layer.dilation;
+	input.out_h			= layer.out_h;
+	input.out_w			= layer.out_w;
+
+	return input;
+}
+
+
 void Darknet_ng::forward_convolutional_layer(Layer & layer, NetworkState & state)
 {
 	// was: void forward_convolutional_layer(convolutional_layer l, network_state state)
 
+	if (layer.blocked and not state.train)
+	{
+		// see Network::use_blocked_layout()
+		forward_blocked_convolutional_layer(layer, state);
+		return;
+	}
+
+	if (layer.fused and not state.train)
+	{
+		// see Network::fuse_layers()
+		forward_fused_convolutional_layer(layer, state);
+		return;
+	}
+
 	int out_h = convolutional_out_height(layer);
 	int out_w = convolutional_out_width(layer);
-	int i, j;
 
 	fill_cpu(layer.outputs * layer.batch, 0, layer.output, 1);
 
@@ -615,7 +894,7 @@ void Darknet_ng::forward_convolutional_layer(Layer & layer, NetworkState & state
 	{
 		if (not layer.align_bit_weights or state.train)
 		{
-			binarize_weights(layer.weights, layer.n, layer.nweights, layer.binary_weights);
+			binarize_weights(layer.weights, layer.n, layer.nweights / layer.n, layer.binary_weights);
 			//printf("\n binarize_weights l.align_bit_weights = %p \n", l.align_bit_weights);
 		}
 		swap_binary(layer);
@@ -627,172 +906,188 @@ void Darknet_ng::forward_convolutional_layer(Layer & layer, NetworkState & state
 	int k = layer.size * layer.size * layer.c / layer.groups;
 	int n = out_h * out_w;
 
-	static int u = 0;
-	u++;
-
-	for(i = 0; i < layer.batch; ++i)
+	if (layer.xnor and layer.align_bit_weights and not state.train and layer.stride_x == layer.stride_y)
 	{
-		for (j = 0; j < layer.groups; ++j)
-		{
-			float *a = layer.weights + j * layer.nweights / layer.groups;
-			float *b = state.workspace;
-			float *c = layer.output +(i * layer.groups + j) * n * m;
+		// the XNOR code uses the bit buffers of the layer, and returns after the first item just like the original code
+		float *c = layer.output;
 
-			//gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
-			//gemm_nn_custom(m, n, k, 1, a, k, b, n, c, n);
-			if (layer.xnor and layer.align_bit_weights and not state.train and layer.stride_x == layer.stride_y)
-			{
-				memset(b, 0, layer.bit_align * layer.size * layer.size * layer.c * sizeof(float));
+		memset(state.workspace, 0, layer.bit_align * layer.size * layer.size * layer.c * sizeof(float));
 
-				if (layer.c % 32 == 0)
-				{
-					//printf(" l.index = %d - new XNOR \n", l.index);
+		if (layer.c % 32 == 0)
+		{
+			//printf(" l.index = %d - new XNOR \n", l.index);
 
-					int ldb_align = layer.lda_align;
-					size_t new_ldb = k + (ldb_align - k % ldb_align); // (k / 8 + 1) * 8;
-					//size_t t_intput_size = new_ldb * l.bit_align;// n;
-					//size_t t_bit_input_size = t_intput_size / 8;// +1;
+			int ldb_align = layer.lda_align;
+			size_t new_ldb = k + (ldb_align - k % ldb_align); // (k / 8 + 1) * 8;
+			//size_t t_intput_size = new_ldb * l.bit_align;// n;
+			//size_t t_bit_input_size = t_intput_size / 8;// +1;
 
-					int re_packed_input_size = layer.c * layer.w * layer.h;
-					memset(state.workspace, 0, re_packed_input_size * sizeof(float));
+			int re_packed_input_size = layer.c * layer.w * layer.h;
+			memset(state.workspace, 0, re_packed_input_size * sizeof(float));
 
-					const size_t new_c = layer.c / 32;
-					size_t in_re_packed_input_size = new_c * layer.w * layer.h + 1;
-					memset(layer.bin_re_packed_input, 0, in_re_packed_input_size * sizeof(uint32_t));
+			const size_t new_c = layer.c / 32;
+			size_t in_re_packed_input_size = new_c * layer.w * layer.h + 1;
+			memset(layer.bin_re_packed_input, 0, in_re_packed_input_size * sizeof(uint32_t));
 
-					//float *re_packed_input = calloc(l.c * l.w * l.h, sizeof(float));
-					//uint32_t *bin_re_packed_input = calloc(new_c * l.w * l.h + 1, sizeof(uint32_t));
+			//float *re_packed_input = calloc(l.c * l.w * l.h, sizeof(float));
+			//uint32_t *bin_re_packed_input = calloc(new_c * l.w * l.h + 1, sizeof(uint32_t));
 
-					// float32x4 by channel (as in cuDNN)
-					repack_input(state.input, state.workspace, layer.w, layer.h, layer.c);
+			// float32x4 by channel (as in cuDNN)
+			repack_input(state.input, state.workspace, layer.w, layer.h, layer.c);
 
-					// 32 x floats -> 1 x uint32_t
-					float_to_bit(state.workspace, (unsigned char *)layer.bin_re_packed_input, layer.c * layer.w * layer.h);
+			// 32 x floats -> 1 x uint32_t
+			float_to_bit(state.workspace, (unsigned char *)layer.bin_re_packed_input, layer.c * layer.w * layer.h);
 
-					//free(re_packed_input);
+			//free(re_packed_input);
 
-					// slow - convolution the packed inputs and weights: float x 32 by channel (as in cuDNN)
-					//convolution_repacked((uint32_t *)bin_re_packed_input, (uint32_t *)l.align_bit_weights, l.output,
-					//    l.w, l.h, l.c, l.n, l.size, l.pad, l.new_lda, l.mean_arr);
+			// slow - convolution the packed inputs and weights: float x 32 by channel (as in cuDNN)
+			//convolution_repacked((uint32_t *)bin_re_packed_input, (uint32_t *)l.align_bit_weights, l.output,
+			//    l.w, l.h, l.c, l.n, l.size, l.pad, l.new_lda, l.mean_arr);
 
-					// // then exit from if()
+			// // then exit from if()
 
 
-					im2col_cpu_custom((float *)layer.bin_re_packed_input, new_c, layer.h, layer.w, layer.size, layer.stride, layer.pad, state.workspace);
-					//im2col_cpu((float *)bin_re_packed_input, new_c, l.h, l.w, l.size, l.stride, l.pad, b);
+			im2col_cpu_custom((float *)layer.bin_re_packed_input, new_c, layer.h, layer.w, layer.size, layer.stride, layer.pad, state.workspace);
+			//im2col_cpu((float *)bin_re_packed_input, new_c, l.h, l.w, l.size, l.stride, l.pad, b);
 
-					//free(bin_re_packed_input);
+			//free(bin_re_packed_input);
 
-					int new_k = layer.size * layer.size * layer.c / 32;
+			int new_k = layer.size * layer.size * layer.c / 32;
 
-					// good for (l.c == 64)
-					//gemm_nn_bin_32bit_packed(m, n, new_k, 1,
-					//    l.align_bit_weights, l.new_lda/32,
-					//    b, n,
-					//    c, n, l.mean_arr);
+			// good for (l.c == 64)
+			//gemm_nn_bin_32bit_packed(m, n, new_k, 1,
+			//    l.align_bit_weights, l.new_lda/32,
+			//    b, n,
+			//    c, n, l.mean_arr);
 
-					// // then exit from if()
+			// // then exit from if()
 
-					transpose_uint32((uint32_t *)state.workspace, (uint32_t*)layer.t_bit_input, new_k, n, n, new_ldb);
+			transpose_uint32((uint32_t *)state.workspace, (uint32_t*)layer.t_bit_input, new_k, n, n, new_ldb);
 
-					// the main GEMM function
-					gemm_nn_custom_bin_mean_transposed(m, n, k, 1, (unsigned char*)layer.align_bit_weights, new_ldb, (unsigned char*)layer.t_bit_input, new_ldb, c, n, layer.mean_arr);
+			// the main GEMM function
+			gemm_nn_custom_bin_mean_transposed(m, n, k, 1, (unsigned char*)layer.align_bit_weights, new_ldb, (unsigned char*)layer.t_bit_input, new_ldb, c, n, layer.mean_arr);
 
-					// // alternative GEMM
-					//gemm_nn_bin_transposed_32bit_packed(m, n, new_k, 1,
-					//    l.align_bit_weights, l.new_lda/32,
-					//    t_bit_input, new_ldb / 32,
-					//    c, n, l.mean_arr);
+			// // alternative GEMM
+			//gemm_nn_bin_transposed_32bit_packed(m, n, new_k, 1,
+			//    l.align_bit_weights, l.new_lda/32,
+			//    t_bit_input, new_ldb / 32,
+			//    c, n, l.mean_arr);
 
-					//free(t_bit_input);
+			//free(t_bit_input);
 
-				}
-				else
-				{ // else (l.c % 32 != 0)
+		}
+		else
+		{ // else (l.c % 32 != 0)
 
-					//--------------------------------------------------------
-					//printf(" l.index = %d - old XNOR \n", l.index);
+			//--------------------------------------------------------
+			//printf(" l.index = %d - old XNOR \n", l.index);
 
-					//im2col_cpu_custom_align(state.input, l.c, l.h, l.w, l.size, l.stride, l.pad, b, l.bit_align);
-					im2col_cpu_custom_bin(state.input, layer.c, layer.h, layer.w, layer.size, layer.stride, layer.pad, state.workspace, layer.bit_align);
+			//im2col_cpu_custom_align(state.input, l.c, l.h, l.w, l.size, l.stride, l.pad, b, l.bit_align);
+			im2col_cpu_custom_bin(state.input, layer.c, layer.h, layer.w, layer.size, layer.stride, layer.pad, state.workspace, layer.bit_align);
 
-					//size_t output_size = l.outputs;
-					//float *count_output = calloc(output_size, sizeof(float));
-					//size_t bit_output_size = output_size / 8 + 1;
-					//char *bit_output = calloc(bit_output_size, sizeof(char));
+			//size_t output_size = l.outputs;
+			//float *count_output = calloc(output_size, sizeof(float));
+			//size_t bit_output_size = output_size / 8 + 1;
+			//char *bit_output = calloc(bit_output_size, sizeof(char));
 
-					//size_t intput_size = n * k; // (out_h*out_w) X (l.size*l.size*l.c) : after im2col()
-					//size_t bit_input_size = intput_size / 8 + 1;
-					//char *bit_input = calloc(bit_input_size, sizeof(char));
+			//size_t intput_size = n * k; // (out_h*out_w) X (l.size*l.size*l.c) : after im2col()
+			//size_t bit_input_size = intput_size / 8 + 1;
+			//char *bit_input = calloc(bit_input_size, sizeof(char));
 
-					//size_t weights_size = k * m; //l.size*l.size*l.c*l.n; // l.nweights
-					//size_t bit_weights_size = weights_size / 8 + 1;
+			//size_t weights_size = k * m; //l.size*l.size*l.c*l.n; // l.nweights
+			//size_t bit_weights_size = weights_size / 8 + 1;
 
-					//char *bit_weights = calloc(bit_weights_size, sizeof(char));
-					//float *mean_arr = calloc(l.n, sizeof(float));
+			//char *bit_weights = calloc(bit_weights_size, sizeof(char));
+			//float *mean_arr = calloc(l.n, sizeof(float));
 
-					// transpose B from NxK to KxN (x-axis (ldb = l.size*l.size*l.c) - should be multiple of 8 bits)
-					{
-						//size_t ldb_align = 256; // 256 bit for AVX2
-						int ldb_align = layer.lda_align;
-						size_t new_ldb = k + (ldb_align - k % ldb_align);
+			// transpose B from NxK to KxN (x-axis (ldb = l.size*l.size*l.c) - should be multiple of 8 bits)
+			{
+				//size_t ldb_align = 256; // 256 bit for AVX2
+				int ldb_align = layer.lda_align;
+				size_t new_ldb = k + (ldb_align - k % ldb_align);
 //						size_t t_intput_size =
-						binary_transpose_align_input(k, n, state.workspace, &layer.t_bit_input, ldb_align, layer.bit_align);
+				binary_transpose_align_input(k, n, state.workspace, &layer.t_bit_input, ldb_align, layer.bit_align);
 
-						// 5x times faster than gemm()-float32
-						gemm_nn_custom_bin_mean_transposed(m, n, k, 1, (unsigned char*)layer.align_bit_weights, new_ldb, (unsigned char*)layer.t_bit_input, new_ldb, c, n, layer.mean_arr);
+				// 5x times faster than gemm()-float32
+				gemm_nn_custom_bin_mean_transposed(m, n, k, 1, (unsigned char*)layer.align_bit_weights, new_ldb, (unsigned char*)layer.t_bit_input, new_ldb, c, n, layer.mean_arr);
 
-						//gemm_nn_custom_bin_mean_transposed(m, n, k, 1, bit_weights, k, t_bit_input, new_ldb, c, n, mean_arr);
+				//gemm_nn_custom_bin_mean_transposed(m, n, k, 1, bit_weights, k, t_bit_input, new_ldb, c, n, mean_arr);
 
-						//free(t_input);
-						//free(t_bit_input);
-						//}
-					}
+				//free(t_input);
+				//free(t_bit_input);
+				//}
+			}
 
-				}
+		}
 
-				add_bias(layer.output, layer.biases, layer.batch, layer.n, out_h * out_w);
+		add_bias(layer.output, layer.biases, layer.batch, layer.n, out_h * out_w);
 
-				//activate_array(l.output, m*n*l.batch, l.activation);
-				if (layer.activation == EActivation::kSWISH)						activate_array_swish						(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
-				else if (layer.activation == EActivation::kMISH)					activate_array_mish							(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
-				else if (layer.activation == EActivation::kHardMISH)				activate_array_hard_mish					(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
-				else if (layer.activation == EActivation::kNormCHAN)				activate_array_normalize_channels			(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output);
-				else if (layer.activation == EActivation::kNormCHANSoftmax)			activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 0);
-				else if (layer.activation == EActivation::kNormCHANSoftmaxMaxVal)	activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 1);
-				else																activate_array_cpu_custom					(layer.output, m * n * layer.batch, layer.activation);
+		//activate_array(l.output, m*n*l.batch, l.activation);
+		if (layer.activation_input and layer.activation == EActivation::kSWISH)			activate_array_swish						(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+		else if (layer.activation_input and layer.activation == EActivation::kMISH)		activate_array_mish							(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+		else if (layer.activation_input and layer.activation == EActivation::kHardMISH)	activate_array_hard_mish					(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+		else if (layer.activation == EActivation::kNormCHAN)							activate_array_normalize_channels			(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output);
+		else if (layer.activation == EActivation::kNormCHANSoftmax)						activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 0);
+		else if (layer.activation == EActivation::kNormCHANSoftmaxMaxVal)				activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 1);
+		else																			layer.activation_kernel						(layer.output, m * n * layer.batch, 0.0f);
 
-				return;
-			}
-			else
-			{
-				//printf(" l.index = %d - FP32 \n", l.index);
-				float *im = state.input + (i * layer.groups + j) * (layer.c / layer.groups) * layer.h * layer.w;
-				if (layer.size == 1 and layer.stride == 1 and layer.dilation == 1)
-				{
-					b = im;
-				}
-				else
-				{
-					//im2col_cpu(im, l.c / l.groups, l.h, l.w, l.size, l.stride, l.pad, b);
+		return;
+	}
 
-					im2col_cpu_ext(im,   // input
-								   layer.c / layer.groups,     // input channels
-					layer.h, layer.w,           // input size (h, w)
-					layer.size, layer.size,     // kernel size (h, w)
-					layer.pad * layer.dilation, layer.pad * layer.dilation,       // padding (h, w)
-					layer.stride_y, layer.stride_x, // stride (h, w)
-					layer.dilation, layer.dilation, // dilation (h, w)
-					b);                 // output
+	// each item is either given all the threads, or runs on a single thread with its own slice of the workspace
+	// see choose_convolutional_parallel_items()
+	const bool grouped = (layer.conv_algorithm == EConvAlgorithm::kGrouped);
+	const int items = layer.batch * (grouped ? 1 : layer.groups);
+	const size_t slice = layer.workspace_size / sizeof(float) / layer.parallel_items;
+	const int parallel = std::min(items, layer.parallel_items);
 
-				}
+	#pragma omp parallel for schedule(dynamic) num_threads(parallel) if (parallel > 1)
+	for (int item = 0; item < items; ++item)
+	{
+		float * workspace = state.workspace + omp_get_thread_num() * slice;
 
-				gemm(0, 0, m, n, k, 1, a, k, b, n, 1, c, n);
-				// bit-count to float
-			}
-			//c += n*m;
-			//state.input += l.c*l.h*l.w;
+		if (grouped)
+		{
+			// all the groups at once, see choose_convolutional_algorithm()
+			grouped_conv(layer.groups, m, layer.weights, get_convolutional_gemm_input(layer, state.input + item * layer.inputs), layer.output + item * layer.outputs, n);
+			continue;
 		}
+
+		const int i = item / layer.groups;
+		const int j = item % layer.groups;
+		float *a = layer.weights + j * layer.nweights / layer.groups;
+		const float *b = workspace;
+		float *c = layer.output +(i * layer.groups + j) * n * m;
+
+		//printf(" l.index = %d - FP32 \n", l.index);
+		const float *im = state.input + (i * layer.groups + j) * (layer.c / layer.groups) * layer.h * layer.w;
+		if (layer.conv_algorithm == EConvAlgorithm::kImplicitGEMM or layer.conv_algorithm == EConvAlgorithm::kWinograd)
+		{
+			// the transformed Winograd filters are only used by forward_fused_convolutional_layer()
+			gemm_conv(m, n, k, 1, a, k, nullptr, get_convolutional_gemm_input(layer, im), 1, c, n);
+			continue;
+		}
+		if (layer.size == 1 and layer.stride == 1 and layer.dilation == 1)
+		{
+			b = im;
+		}
+		else
+		{
+			//im2col_cpu(im, l.c / l.groups, l.h, l.w, l.size, l.stride, l.pad, b);
+
+			im2col_cpu_ext(im,   // input
+						   layer.c / layer.groups,     // input channels
+			layer.h, layer.w,           // input size (h, w)
+			layer.size, layer.size,     // kernel size (h, w)
+			layer.pad * layer.dilation, layer.pad * layer.dilation,       // padding (h, w)
+			layer.stride_y, layer.stride_x, // stride (h, w)
+			layer.dilation, layer.dilation, // dilation (h, w)
+			workspace);   // output
+
+		}
+
+		gemm(0, 0, m, n, k, 1, a, k, b, n, 1, c, n);
+		// bit-count to float
 	}
 
 	if(layer.batch_normalize)
@@ -805,13 +1100,13 @@ void Darknet_ng::forward_convolutional_layer(Layer & layer, NetworkState & state
 	}
 
 	//activate_array(l.output, m*n*l.batch, l.activation);
-	if (layer.activation == EActivation::kSWISH) activate_array_swish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
-	else if (layer.activation == EActivation::kMISH) activate_array_mish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
-	else if (layer.activation == EActivation::kHardMISH) activate_array_hard_mish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+	if (layer.activation_input and layer.activation == EActivation::kSWISH) activate_array_swish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+	else if (layer.activation_input and layer.activation == EActivation::kMISH) activate_array_mish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
+	else if (layer.activation_input and layer.activation == EActivation::kHardMISH) activate_array_hard_mish(layer.output, layer.outputs * layer.batch, layer.activation_input, layer.output);
 	else if (layer.activation == EActivation::kNormCHAN) activate_array_normalize_channels(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output);
 	else if (layer.activation == EActivation::kNormCHANSoftmax) activate_array_normalize_channels_softmax(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 0);
 	else if (layer.activation == EActivation::kNormCHANSoftmaxMaxVal) activate_array_normalize_channels_softmax(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 1);
-	else activate_array_cpu_custom(layer.output, layer.outputs * layer.batch, layer.activation);
+	else layer.activation_kernel(layer.output, layer.outputs * layer.batch, 0.0f);
 
 	if (layer.binary or layer.xnor)
 	{
@@ -821,22 +1116,103 @@ void Darknet_ng::forward_convolutional_layer(Layer & layer, NetworkState & state
 	//visualize_convolutional_layer(l, "conv_visual", NULL);
 	//wait_until_press_key_cv();
 
-	if(layer.assisted_excitation && state.train) assisted_excitation_forward(layer, state);
+	if (layer.assisted_excitation and state.train)
+	{
+		/// @throw Exception Assisted excitation is only used during training, and has not been ported.
+		throw Exception("assisted excitation is not yet supported in [convolutional] layer #" + std::to_string(layer.index), DNG_LOC);
+	}
 
 	if (layer.antialiasing)
 	{
-		network_state s = { 0 };
-		s.train = state.train;
-		s.workspace = state.workspace;
-		s.net = state.net;
-		s.input = l.output;
-		forward_convolutional_layer(*(l.input_layer), s);
+		NetworkState s = state;
+		s.input = layer.output;
+		forward_convolutional_layer(*layer.input_layer, s);
 		//simple_copy_ongpu(l.outputs*l.batch, l.output, l.input_antialiasing);
 		memcpy(layer.output, layer.input_layer->output, layer.input_layer->outputs * layer.input_layer->batch * sizeof(float));
 	}
 }
 
 
+void Darknet_ng::pack_convolutional_weights(Darknet_ng::Layer & layer)
+{
+	if (layer.packed_weights == nullptr and layer.winograd_weights == nullptr)
+	{
+		/// @throw Exception The packed weights are only allocated when the network is loaded for inference.
+		throw Exception("cannot pack the weights of [convolutional] layer #" + std::to_string(layer.index) + " since it has no packed_weights buffer", DNG_LOC);
+	}
+
+	if (layer.winograd_weights)
+	{
+		winograd_transform_filters(layer.n, layer.c, layer.weights, layer.winograd_weights);
+	}
+
+	if (layer.packed_weights)
+	{
+		const int m = layer.n / layer.groups;
+		const int k = layer.size * layer.size * layer.c / layer.groups;
+		const size_t group_size = gemm_packed_a_size(m, k);
+
+		for (int j = 0; j < layer.groups; ++j)
+		{
+			gemm_pack_a(0, m, k, 1.0f, layer.weights + j * layer.nweights / layer.groups, k, layer.packed_weights + j * group_size);
+		}
+	}
+
+	layer.weights_packed = true;
+
+	return;
+}
+
+
+float Darknet_ng::get_winograd_error(const Darknet_ng::Layer & layer)
+{
+	if (layer.winograd_weights == nullptr or not layer.weights_packed)
+	{
+		/// @throw Exception The filters must have been transformed by pack_convolutional_weights().
+		throw Exception("[convolutional] layer #" + std::to_string(layer.index) + " does not have transformed Winograd filters", DNG_LOC);
+	}
+
+	// a small patch is enough since the errors come from the size of the weights, not from the size of the image
+	const int h = std::min(layer.h, 12);
+	const int w = std::min(layer.w, 12);
+
+	GemmConvInput input = get_convolutional_gemm_input(layer, nullptr);
+	input.height	= h;
+	input.width		= w;
+	input.out_h		= h + 2 * input.pad_h - 2;
+	input.out_w		= w + 2 * input.pad_w - 2;
+
+	const int m = layer.n;
+	const int n = input.out_h * input.out_w;
+	const int k = 9 * layer.c;
+
+	// something which looks like the output of a leaky or mish activation, mostly positive with a few small negatives
+	VF image(static_cast<size_t>(layer.c) * h * w);
+	for (size_t i = 0; i < image.size(); i ++)
+	{
+		image[i] = std::fabs(std::sin(i * 0.618f)) * 2.0f - 0.1f;
+	}
+	input.image = image.data();
+
+	VF expected(static_cast<size_t>(m) * n);
+	VF result(static_cast<size_t>(m) * n);
+	const int threads = omp_get_max_threads();
+	VF workspace(winograd_workspace_size(m, input, threads) / sizeof(float));
+	gemm_conv(m, n, k, 1.0f, layer.weights, k, nullptr, input, 0.0f, expected.data(), n);
+	winograd_conv(m, layer.winograd_weights, input, workspace.data(), threads, result.data(), n);
+
+	float max_diff = 0.0f;
+	float max_val = 0.0f;
+	for (size_t i = 0; i < expected.size(); i ++)
+	{
+		max_diff	= std::max(max_diff	, std::fabs(result[i] - expected[i]));
+		max_val		= std::max(max_val	, std::fabs(expected[i]));
+	}
+
+	return (max_val > 0.0f ? max_diff / max_val : max_diff);
+}
+
+
 void Darknet_ng::binarize_weights(float * weights, const int n, const int size, float *binary)
 {
 	for(int f = 0; f < n; ++f)
@@ -867,14 +1243,14 @@ void Darknet_ng::swap_binary(Darknet_ng::Layer & l)
 #endif
 
 	#ifdef GPU
-	swap = l->weights_gpu;
-	l->weights_gpu = l->binary_weights_gpu;
-	l->binary_weights_gpu = swap;
+	swap = l->gpu->weights_gpu;
+	l->gpu->weights_gpu = l->gpu->binary_weights_gpu;
+	l->gpu->binary_weights_gpu = swap;
 	#endif
 }
 
 
-void Darknet_ng::binarize_cpu(float *input, int n, float *binary)
+void Darknet_ng::binarize_cpu(const float *input, int n, float *binary)
 {
 	for(int i = 0; i < n; ++i)
 	{
@@ -907,81 +1283,17 @@ size_t Darknet_ng::binary_transpose_align_input(int k, int n, float *b, char **t
 }
 
 
-void Darknet_ng::add_bias(float * output, float * biases, int batch, int n, int size)
+void Darknet_ng::add_bias(float * output, const float * biases, const int batch, const int n, const int size)
 {
-	for (int b = 0; b < batch; ++b)
+	#pragma omp parallel for
+	for (int bi = 0; bi < batch * n; ++bi)
 	{
-		for (int i = 0; i < n; ++i)
-		{
-			for (int j = 0; j < size; ++j)
-			{
-				output[(b * n + i) * size + j] += biases[i];
-			}
-		}
-	}
-
-	return;
-}
-
-
-// Function uses casting from int to unsigned to compare if value of
-// parameter a is greater or equal to zero and lower than value of
-// parameter b. The b parameter is of type signed and is always positive,
-// therefore its value is always lower than 0x800... where casting
-// negative value of a parameter converts it to value higher than 0x800...
-// The casting allows to use one condition instead of two.
-inline static int is_a_ge_zero_and_a_lt_b(int a, int b)
-{
-	return (unsigned)(a) < (unsigned)(b);
-}
-
-
-void Darknet_ng::im2col_cpu_ext(
-		const float * data_im, const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
-		const int pad_h, const int pad_w, const int stride_h, const int stride_w, const int dilation_h, const int dilation_w,
-		float * data_col)
-{
-	const int output_h = (height + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
-	const int output_w = (width + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-	const int channel_size = height * width;
-
-//	int channel, kernel_row, kernel_col, output_rows, output_col;
+		const float bias = biases[bi % n];
 
-	for (int channel = channels; channel--; data_im += channel_size)
-	{
-		for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++)
+		float * ptr = output + bi * size;
+		for (int j = 0; j < size; ++j)
 		{
-			for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++)
-			{
-				int input_row = -pad_h + kernel_row * dilation_h;
-				for (int output_rows = output_h; output_rows; output_rows--)
-				{
-					if (!is_a_ge_zero_and_a_lt_b(input_row, height))
-					{
-						for (int output_col = output_w; output_col; output_col--)
-						{
-							*(data_col++) = 0;
-						}
-					}
-					else
-					{
-						int input_col = -pad_w + kernel_col * dilation_w;
-						for (int output_col = output_w; output_col; output_col--)
-						{
-							if (is_a_ge_zero_and_a_lt_b(input_col, width))
-							{
-								*(data_col++) = data_im[input_row * width + input_col];
-							}
-							else
-							{
-								*(data_col++) = 0;
-							}
-							input_col += stride_w;
-						}
-					}
-					input_row += stride_h;
-				}
-			}
+			ptr[j] += bias;
 		}
 	}
 
@@ -0,0 +1,142 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <array>
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::LayerKernel Darknet_ng::get_forward_kernel(const Darknet_ng::ELayerType layer_type)
+{
+	/* The original code stored a "forward" function pointer in every layer, and each call copied the entire layer and
+	 * network state structures since they were passed by value.  Instead, there is a single table indexed by the layer
+	 * type, and every kernel takes the layer and the state by reference.
+	 */
+	static const auto kernels = []()
+	{
+		std::array<LayerKernel, static_cast<size_t>(ELayerType::kMax)> table;
+		table.fill(nullptr);
+
+		table[static_cast<size_t>(ELayerType::kConvolutional)]	= forward_convolutional_layer;
+		table[static_cast<size_t>(ELayerType::kMaxPool)]		= forward_maxpool_layer;
+		table[static_cast<size_t>(ELayerType::kRoute)]			= forward_route_layer;
+		table[static_cast<size_t>(ELayerType::kShortcut)]		= forward_shortcut_layer;
+		table[static_cast<size_t>(ELayerType::kUpsample)]		= forward_upsample_layer;
+		table[static_cast<size_t>(ELayerType::kYOLO)]			= forward_yolo_layer;
+
+		return table;
+	}();
+
+	const size_t idx = static_cast<size_t>(layer_type);
+	if (idx >= kernels.size() or kernels[idx] == nullptr)
+	{
+		/// @throw Exception There is no forward kernel for this type of layer.
+		throw Exception("layer type #" + std::to_string(idx) + " does not have a forward kernel", DNG_LOC);
+	}
+
+	return kernels[idx];
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::forward(Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_network(network net, network_state state)
+
+	forward(layers, state);
+
+	return *this;
+}
+
+
+const Darknet_ng::Network & Darknet_ng::Network::forward(Darknet_ng::Layers & run_layers, Darknet_ng::NetworkState & state) const
+{
+	if (state.workspace == nullptr)
+	{
+		state.workspace = get_workspace();
+	}
+	state.net = this;
+	state.layers = run_layers.data();
+
+	for (size_t idx = 0; idx < run_layers.size(); idx ++)
+	{
+		Layer & layer = run_layers[idx];
+
+		state.index = idx;
+
+		const bool input_blocked = (idx > 0 and run_layers[idx - 1].blocked);
+		if (layer.type != ELayerType::kRoute and layer.blocked != input_blocked)
+		{
+			// the previous layer used a different layout, see use_blocked_layout()
+			float * converted = state.workspace + conversion_offset / sizeof(float);
+			if (layer.blocked)
+			{
+				nchw_to_nchwc(state.input, converted, layer.batch, layer.c, layer.h * layer.w, channel_block);
+			}
+			else
+			{
+				nchwc_to_nchw(state.input, converted, layer.batch, layer.c, layer.h * layer.w, channel_block);
+			}
+			state.input = converted;
+		}
+
+		get_forward_kernel(layer.type)(layer, state);
+		state.input = layer.output;
+	}
+
+	return *this;
+}
+
+
+const float * Darknet_ng::Network::predict(const float * input, const size_t batch)
+{
+	// was:  float *network_predict(network net, float *input)
+
+	return predict(layers, get_workspace(), input, batch);
+}
+
+
+const float * Darknet_ng::Network::predict(Darknet_ng::Layers & run_layers, float * run_workspace, const float * input, const size_t batch) const
+{
+	if (run_layers.empty())
+	{
+		/// @throw Exception The network must be loaded before it can be used.
+		throw Exception("cannot run inference since the network has not been loaded", DNG_LOC);
+	}
+
+	if (batch < 1 or batch > static_cast<size_t>(settings.batch))
+	{
+		/// @throw Exception The buffers are sized for the batch in the configuration, so larger batches are not possible.
+		throw Exception("cannot run inference on a batch of " + std::to_string(batch) + " since the network was loaded with batch=" + std::to_string(settings.batch), DNG_LOC);
+	}
+
+	if (static_cast<size_t>(run_layers.front().batch) != batch)
+	{
+		// all the buffers are sized for the full batch, so running fewer images only uses the start of each buffer
+		for (auto & layer : run_layers)
+		{
+			layer.batch = batch;
+			if (layer.input_layer)
+			{
+				layer.input_layer->batch = batch;
+			}
+		}
+	}
+
+	NetworkState state;
+	std::memset(&state, '\0', sizeof(state));
+	state.input		= input;
+	state.train		= 0;
+	state.workspace	= run_workspace;
+
+	forward(run_layers, state);
+
+	Layer & last = run_layers.back();
+	if (last.blocked)
+	{
+		// the caller always gets NCHW
+		float * converted = state.workspace + conversion_offset / sizeof(float);
+		nchwc_to_nchw(last.output, converted, last.batch, last.out_c, last.out_h * last.out_w, channel_block);
+		std::memcpy(last.output, converted, sizeof(float) * last.batch * last.outputs);
+	}
+
+	return last.output;
+}
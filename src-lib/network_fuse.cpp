@@ -0,0 +1,237 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include <set>
+#include <omp.h>
+#include "darknet-ng.hpp"
+
+
+namespace
+{
+	/// Fold the batchnorm into the weights and biases of a single convolutional layer.  Returns the number of passes saved.
+	size_t fuse_convolutional(Darknet_ng::Layer & layer)
+	{
+		using namespace Darknet_ng;
+
+		if (layer.fused or layer.xnor or layer.binary)
+		{
+			// the binary layers work on the sign of the weights, and have their own bias and activation code
+			return 0;
+		}
+
+		size_t passes_saved = 1; // the output no longer needs to be zeroed before the GEMM
+
+		if (layer.batch_normalize)
+		{
+			// was:  void fuse_conv_batchnorm(network net)
+
+			const size_t filter_size = layer.size * layer.size * layer.c / layer.groups;
+
+			for (int f = 0; f < layer.n; ++f)
+			{
+				// this must match the epsilon used by normalize_cpu()
+				const double precomputed = layer.scales[f] / std::sqrt(static_cast<double>(layer.rolling_variance[f]) + 0.00001);
+
+				layer.biases[f] = layer.biases[f] - precomputed * layer.rolling_mean[f];
+
+				float * weights = layer.weights + f * filter_size;
+				for (size_t i = 0; i < filter_size; ++i)
+				{
+					weights[i] *= precomputed;
+				}
+			}
+
+			passes_saved += 3; // normalize_cpu(), scale_bias(), and add_bias()
+		}
+		else
+		{
+			passes_saved += 1; // add_bias()
+		}
+
+		if (layer.activation != EActivation::kLinear and is_elementwise(layer.activation))
+		{
+			passes_saved += 1; // activate_array_*()
+		}
+
+		layer.fused = true;
+
+		if (layer.packed_weights or layer.winograd_weights)
+		{
+			// the weights won't change again, so they only need to be packed once instead of on every GEMM
+			pack_convolutional_weights(layer);
+		}
+
+		if (layer.conv_algorithm == EConvAlgorithm::kWinograd)
+		{
+			const float error = (layer.winograd_weights ? get_winograd_error(layer) : 0.0f);
+			if (layer.winograd_weights == nullptr or error > kWinogradTolerance)
+			{
+				// large weights make the rounding errors of the Winograd transforms too large
+				fprintf(stderr, "Winograd is not used for [convolutional] layer #%d (error=%g)\n", layer.index, error);
+				set_convolutional_algorithm(layer, EConvAlgorithm::kImplicitGEMM);
+			}
+		}
+
+		return passes_saved;
+	}
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::fuse_layers()
+{
+	if (settings.train)
+	{
+		/// @throw Exception The fused weights cannot be trained since the batchnorm parameters no longer apply.
+		throw Exception("cannot fuse the layers of a network which is being trained", DNG_LOC);
+	}
+
+	// layers which share their weights with another layer must be left alone, since both layers would be modified
+	std::set<const Layer *> shared;
+	for (const auto & layer : layers)
+	{
+		if (layer.share_layer)
+		{
+			shared.insert(&layer);
+			shared.insert(layer.share_layer);
+		}
+	}
+
+	int fused_count = 0;
+	fused_passes_saved = 0;
+
+	for (auto & layer : layers)
+	{
+		if (layer.type != ELayerType::kConvolutional or shared.count(&layer))
+		{
+			continue;
+		}
+
+		size_t passes_saved = fuse_convolutional(layer);
+		if (layer.input_layer)
+		{
+			// antialiasing blur
+			passes_saved += fuse_convolutional(*layer.input_layer);
+		}
+
+		if (layer.fused)
+		{
+			fused_count ++;
+		}
+		fused_passes_saved += passes_saved;
+	}
+
+	fprintf(stderr, "Fused %d convolutional layers, saving %d passes over the layer outputs per inference\n", fused_count, static_cast<int>(fused_passes_saved));
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_fused_convolutional_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	/* Same as forward_convolutional_layer(), but the batchnorm has been folded into the weights by Network::fuse_layers().
+	 * Each block of the output is multiplied, biased, and activated by the same thread one after the other, so the block
+	 * is still in cache instead of making one pass over the entire output for each of those steps.
+	 */
+
+	const int m = layer.n / layer.groups;
+	const int k = layer.size * layer.size * layer.c / layer.groups;
+	const int n = layer.out_h * layer.out_w;
+
+	// activations like normalize_channels need all the channels, so those cannot be applied one row at a time
+	const ActivationKernel epilogue_activation = (layer.activation_kernel ? layer.activation_kernel : get_activation_kernel(EActivation::kLinear));
+
+	const bool use_packed_weights = layer.weights_packed and layer.packed_weights and not state.train;
+	const bool use_winograd = layer.conv_algorithm == EConvAlgorithm::kWinograd and layer.weights_packed and not state.train;
+	const int winograd_threads = (use_winograd ? get_convolutional_winograd_threads(layer) : 1);
+	const size_t packed_group_size = gemm_packed_a_size(m, k);
+
+	// see choose_convolutional_parallel_items()
+	const bool grouped = (layer.conv_algorithm == EConvAlgorithm::kGrouped);
+	const int items = layer.batch * (grouped ? 1 : layer.groups);
+	const size_t slice = layer.workspace_size / sizeof(float) / layer.parallel_items;
+	const int parallel = std::min(items, layer.parallel_items);
+
+	#pragma omp parallel for schedule(dynamic) num_threads(parallel) if (parallel > 1)
+	for (int item = 0; item < items; ++item)
+	{
+		float * workspace = state.workspace + omp_get_thread_num() * slice;
+
+		if (grouped)
+		{
+			// the filters of all the groups are computed at once, so the epilogue is given the index of the filter
+			const float * biases = layer.biases;
+			const auto epilogue = [biases, epilogue_activation](float * C, const int, const int row, const int, const int, const int cols)
+			{
+				epilogue_activation(C, cols, biases[row]);
+			};
+
+			grouped_conv(layer.groups, m, layer.weights, get_convolutional_gemm_input(layer, state.input + item * layer.inputs), layer.output + item * layer.outputs, n, epilogue);
+			continue;
+		}
+
+		const int i = item / layer.groups;
+		const int j = item % layer.groups;
+		const float * a = layer.weights + j * layer.nweights / layer.groups;
+		const float * b = workspace;
+		const float * biases = layer.biases + j * m;
+		float * c = layer.output + (i * layer.groups + j) * n * m;
+
+		const auto epilogue = [biases, epilogue_activation](float * C, const int ldc, const int row, const int, const int rows, const int cols)
+		{
+			for (int r = 0; r < rows; ++r)
+			{
+				epilogue_activation(C + r * ldc, cols, biases[row + r]);
+			}
+		};
+
+		const float * packed_a = (use_packed_weights ? layer.packed_weights + j * packed_group_size : nullptr);
+		const float * im = state.input + (i * layer.groups + j) * (layer.c / layer.groups) * layer.h * layer.w;
+
+		// BETA is zero so the output does not need to be cleared, and the epilogue runs on each block of the output
+		if (use_winograd)
+		{
+			winograd_conv(m, layer.winograd_weights, get_convolutional_gemm_input(layer, im), workspace, winograd_threads, c, n, epilogue);
+			continue;
+		}
+
+		if (layer.conv_algorithm == EConvAlgorithm::kImplicitGEMM or layer.conv_algorithm == EConvAlgorithm::kWinograd)
+		{
+			gemm_conv(m, n, k, 1.0f, a, k, packed_a, get_convolutional_gemm_input(layer, im), 0.0f, c, n, epilogue);
+			continue;
+		}
+
+		if (layer.size == 1 and layer.stride == 1 and layer.dilation == 1)
+		{
+			b = im;
+		}
+		else
+		{
+			im2col_cpu_ext(im, layer.c / layer.groups, layer.h, layer.w, layer.size, layer.size,
+					layer.pad * layer.dilation, layer.pad * layer.dilation, layer.stride_y, layer.stride_x,
+					layer.dilation, layer.dilation, workspace);
+		}
+
+		if (packed_a)
+		{
+			gemm_prepacked(0, m, n, k, packed_a, b, n, 0.0f, c, n, epilogue);
+		}
+		else
+		{
+			gemm(0, 0, m, n, k, 1.0f, a, k, b, n, 0.0f, c, n, epilogue);
+		}
+	}
+
+	if (layer.activation == EActivation::kNormCHAN)					activate_array_normalize_channels			(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output);
+	else if (layer.activation == EActivation::kNormCHANSoftmax)			activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 0);
+	else if (layer.activation == EActivation::kNormCHANSoftmaxMaxVal)	activate_array_normalize_channels_softmax	(layer.output, layer.outputs * layer.batch, layer.batch, layer.out_c, layer.out_w * layer.out_h, layer.output, 1);
+
+	if (layer.antialiasing)
+	{
+		NetworkState s = state;
+		s.input = layer.output;
+		forward_convolutional_layer(*layer.input_layer, s);
+		memcpy(layer.output, layer.input_layer->output, layer.input_layer->outputs * layer.input_layer->batch * sizeof(float));
+	}
+
+	return;
+}
@@ -0,0 +1,170 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::Network & Darknet_ng::Network::parse_maxpool(const Darknet_ng::Section & section, const size_t layer_index)
+{
+	// was:  maxpool_layer parse_maxpool(list *options, size_params params);
+
+	const int stride				= section.i("stride"				, 1			);
+	const int stride_x				= section.i("stride_x"				, stride	);
+	const int stride_y				= section.i("stride_y"				, stride	);
+	const int size					= section.i("size"					, stride	);
+	const int padding				= section.i("padding"				, size - 1	);
+	const int maxpool_depth			= section.i("maxpool_depth"			, 0			);
+	const int out_channels			= section.i("out_channels"			, 1			);
+	const int antialiasing			= section.i("antialiasing"			, 0			);
+
+	int h = 0;
+	int w = 0;
+	int c = 0;
+	get_input_dimensions(layer_index, h, w, c);
+
+	Layer & layer = layers.at(layer_index);
+
+	/// @todo This only sets up the shape of the layer.  The antialiasing blur layer still needs to be ported.
+	layer.type					= ELayerType::kMaxPool;
+	layer.index					= layer_index;
+	layer.batch					= settings.batch;
+	layer.train					= settings.train;
+	layer.h						= h;
+	layer.w						= w;
+	layer.c						= c;
+	layer.size					= size;
+	layer.stride				= stride_x;
+	layer.stride_x				= stride_x;
+	layer.stride_y				= stride_y;
+	layer.pad					= padding;
+	layer.maxpool_depth			= maxpool_depth;
+	layer.out_channels			= out_channels;
+	layer.antialiasing			= antialiasing;
+	layer.maxpool_zero_nonmax	= section.i("maxpool_zero_nonmax", 0);
+
+	if (maxpool_depth)
+	{
+		layer.out_c = out_channels;
+		layer.out_w = w;
+		layer.out_h = h;
+	}
+	else
+	{
+		layer.out_w = (w + padding - size) / stride_x + 1;
+		layer.out_h = (h + padding - size) / stride_y + 1;
+		layer.out_c = c;
+	}
+	layer.inputs	= h * w * c;
+	layer.outputs	= layer.out_h * layer.out_w * layer.out_c;
+	layer.bflops	= (layer.size * layer.size * layer.c * layer.out_h * layer.out_w) / 1000000000.0f;
+
+	fprintf(stderr, "max         %2dx%2d/%2d   %4d x%4d x%4d -> %4d x%4d x%4d %5.3f BF\n", size, size, stride_x, w, h, c, layer.out_w, layer.out_h, layer.out_c, layer.bflops);
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_maxpool_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_maxpool_layer(const maxpool_layer l, network_state state)
+
+	if (layer.blocked and not state.train)
+	{
+		// see Network::use_blocked_layout()
+		forward_blocked_maxpool_layer(layer, state);
+		return;
+	}
+
+	if (layer.maxpool_depth)
+	{
+		// the maximum is taken across groups of channels instead of across a spatial window
+		for (int b = 0; b < layer.batch; ++b)
+		{
+			#pragma omp parallel for
+			for (int i = 0; i < layer.h; ++i)
+			{
+				for (int j = 0; j < layer.w; ++j)
+				{
+					for (int g = 0; g < layer.out_c; ++g)
+					{
+						const int out_index = j + layer.w * (i + layer.h * (g + layer.out_c * b));
+						float max = -FLT_MAX;
+						int max_i = -1;
+
+						for (int k = g; k < layer.c; k += layer.out_c)
+						{
+							const int in_index = j + layer.w * (i + layer.h * (k + layer.c * b));
+							const float val = state.input[in_index];
+
+							max_i	= (val > max) ? in_index	: max_i;
+							max		= (val > max) ? val			: max;
+						}
+						layer.output[out_index] = max;
+						if (layer.indexes)
+						{
+							layer.indexes[out_index] = max_i;
+						}
+					}
+				}
+			}
+		}
+
+		return;
+	}
+
+	const int w_offset	= -layer.pad / 2;
+	const int h_offset	= -layer.pad / 2;
+	const int out_h		= layer.out_h;
+	const int out_w		= layer.out_w;
+	const int c			= layer.c;
+
+	#pragma omp parallel for
+	for (int bk = 0; bk < layer.batch * c; ++bk)
+	{
+		const int b = bk / c;
+		const int k = bk % c;
+		for (int i = 0; i < out_h; ++i)
+		{
+			for (int j = 0; j < out_w; ++j)
+			{
+				const int out_index = j + out_w * (i + out_h * (k + c * b));
+				float max = -FLT_MAX;
+				int max_i = -1;
+				for (int n = 0; n < layer.size; ++n)
+				{
+					for (int m = 0; m < layer.size; ++m)
+					{
+						const int cur_h = h_offset + i * layer.stride_y + n;
+						const int cur_w = w_offset + j * layer.stride_x + m;
+						const int index = cur_w + layer.w * (cur_h + layer.h * (k + b * layer.c));
+						const bool valid = (cur_h >= 0 and cur_h < layer.h and cur_w >= 0 and cur_w < layer.w);
+						const float val = valid ? state.input[index] : -FLT_MAX;
+						max_i	= (val > max) ? index	: max_i;
+						max		= (val > max) ? val		: max;
+					}
+				}
+				layer.output[out_index] = max;
+				if (layer.indexes)
+				{
+					layer.indexes[out_index] = max_i;
+				}
+			}
+		}
+	}
+
+	if (layer.antialiasing)
+	{
+		if (layer.input_layer == nullptr)
+		{
+			/// @throw Exception The blur layer used by antialiased maxpool layers has not been ported.
+			throw Exception("antialiasing is not yet supported in [maxpool] layer #" + std::to_string(layer.index), DNG_LOC);
+		}
+
+		NetworkState s = state;
+		s.input = layer.output;
+		forward_convolutional_layer(*layer.input_layer, s);
+		memcpy(layer.output, layer.input_layer->output, layer.input_layer->outputs * layer.input_layer->batch * sizeof(float));
+	}
+
+	return;
+}
@@ -0,0 +1,130 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::VI Darknet_ng::Network::get_layer_inputs(const size_t layer_index) const
+{
+	const Layer & layer = layers.at(layer_index);
+
+	VI inputs;
+
+	// every layer except a route reads the output of the previous layer (the very first layer reads the network input)
+	if (layer.type != ELayerType::kRoute and layer_index > 0)
+	{
+		inputs.push_back(layer_index - 1);
+	}
+
+	// routes and shortcuts also read the output of earlier layers such as "layers=-1,-4" or "from=-3"
+	if (layer.type == ELayerType::kRoute or layer.type == ELayerType::kShortcut)
+	{
+		for (int i = 0; i < layer.n; i ++)
+		{
+			inputs.push_back(layer.input_layers[i]);
+		}
+	}
+
+	return inputs;
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::plan_activations()
+{
+	/* When running inference, the output of most layers is only needed until the last layer which reads it has run.
+	 * This finds the lifetime of every output, and then uses a greedy interval colouring to assign each output to one of
+	 * a small number of shared "slabs".  Two outputs can share the same slab as long as their lifetimes don't overlap.
+	 */
+
+	const int number_of_layers = layers.size();
+
+	activation_plan = {};
+	activation_plan.last_use.resize(number_of_layers, -1);
+	activation_plan.slab.resize(number_of_layers, -1);
+
+	for (int idx = 0; idx < number_of_layers; idx ++)
+	{
+		const Layer & layer = layers[idx];
+
+		if (layer.type == ELayerType::kYOLO or idx == number_of_layers - 1)
+		{
+			// the network outputs must remain valid after the last layer has run
+			activation_plan.last_use[idx] = number_of_layers;
+		}
+		else
+		{
+			activation_plan.last_use[idx] = std::max(activation_plan.last_use[idx], idx);
+		}
+
+		for (const int input : get_layer_inputs(idx))
+		{
+			activation_plan.last_use[input] = std::max(activation_plan.last_use[input], idx);
+		}
+	}
+
+	// the layer at which each slab becomes available again
+	VI slab_free_after;
+
+	for (int idx = 0; idx < number_of_layers; idx ++)
+	{
+		const Layer & layer = layers[idx];
+		const size_t size = static_cast<size_t>(layer.batch) * layer.outputs;
+		if (size == 0)
+		{
+			continue;
+		}
+
+		activation_plan.naive_size += size;
+
+		/* Look for a slab which is no longer in use.  Note that a layer cannot write to the same slab as one of the inputs
+		 * it is reading, which is why the slab must have been released *before* this layer.  Prefer the smallest slab
+		 * which is large enough; otherwise grow the largest available slab.
+		 */
+		int best = -1;
+		for (size_t slab = 0; slab < slab_free_after.size(); slab ++)
+		{
+			if (slab_free_after[slab] >= idx)
+			{
+				continue;
+			}
+
+			const size_t slab_size = activation_plan.slab_size[slab];
+			if (best < 0)
+			{
+				best = slab;
+				continue;
+			}
+
+			const size_t best_size = activation_plan.slab_size[best];
+			if (slab_size >= size)
+			{
+				if (best_size < size or slab_size < best_size)
+				{
+					best = slab;
+				}
+			}
+			else if (best_size < size and slab_size > best_size)
+			{
+				best = slab;
+			}
+		}
+
+		if (best < 0)
+		{
+			best = activation_plan.slab_size.size();
+			activation_plan.slab_size.push_back(0);
+			slab_free_after.push_back(-1);
+		}
+
+		activation_plan.slab[idx]			= best;
+		activation_plan.slab_size[best]		= std::max(activation_plan.slab_size[best], size);
+		slab_free_after[best]				= activation_plan.last_use[idx];
+	}
+
+	for (const size_t size : activation_plan.slab_size)
+	{
+		activation_plan.planned_size += size;
+	}
+
+	return *this;
+}
@@ -0,0 +1,608 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace
+{
+	/// Read-only memory map of an entire file.  The mapping is released when the object goes out of scope.
+	class MappedFile final
+	{
+		public:
+
+			MappedFile(const std::filesystem::path & filename) :
+				data(nullptr),
+				size(0)
+			{
+				const int fd = open(filename.c_str(), O_RDONLY);
+				if (fd < 0)
+				{
+					/// @throw Exception The file cannot be opened.
+					throw Darknet_ng::Exception("failed to open file: \"" + filename.string() + "\"", DNG_LOC);
+				}
+
+				struct stat st;
+				if (fstat(fd, &st) == 0 and st.st_size > 0)
+				{
+					size = st.st_size;
+					void * ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (ptr != MAP_FAILED)
+					{
+						data = static_cast<const uint8_t*>(ptr);
+					}
+				}
+				close(fd);
+
+				if (data == nullptr)
+				{
+					/// @throw Exception The file cannot be memory-mapped.
+					throw Darknet_ng::Exception("failed to map file: \"" + filename.string() + "\"", DNG_LOC);
+				}
+
+				return;
+			}
+
+			~MappedFile()
+			{
+				munmap(const_cast<uint8_t*>(data), size);
+
+				return;
+			}
+
+			const uint8_t * data;
+			size_t size;
+	};
+
+
+	/** Multiply the dimensions of an image.  Returns @p -1 if a dimension is not positive, or if the result does not
+	 * fit into the @p int fields of a layer.
+	 */
+	int64_t get_volume(const int32_t h, const int32_t w, const int32_t c)
+	{
+		const int64_t limit	= std::numeric_limits<int32_t>::max();
+		const int64_t area	= static_cast<int64_t>(h) * w;
+
+		if (h <= 0 or w <= 0 or c <= 0 or area > limit or area * c > limit)
+		{
+			return -1;
+		}
+
+		return area * c;
+	}
+}
+
+
+bool Darknet_ng::is_plan_file(const std::filesystem::path & filename)
+{
+	char magic[sizeof(kPlanMagic)] = {0};
+
+	std::ifstream ifs(filename, std::ios::binary);
+	ifs.read(magic, sizeof(magic));
+
+	return ifs.good() and std::memcmp(magic, kPlanMagic, sizeof(kPlanMagic)) == 0;
+}
+
+
+const Darknet_ng::Network & Darknet_ng::Network::save_plan(const std::filesystem::path & plan_filename) const
+{
+	if (layers.empty())
+	{
+		/// @throw Exception A network must be loaded before a plan can be saved.
+		throw Exception("cannot save a plan without first loading a network", DNG_LOC);
+	}
+
+	std::vector<PlanLayer> records;
+	std::vector<int32_t> indexes;
+
+	for (const auto & layer : layers)
+	{
+		PlanLayer record;
+		std::memset(&record, '\0', sizeof(record));
+
+		record.type					= static_cast<int32_t>(layer.type);
+		record.activation			= static_cast<int32_t>(layer.activation);
+		record.batch				= layer.batch;
+		record.h					= layer.h;
+		record.w					= layer.w;
+		record.c					= layer.c;
+		record.out_h				= layer.out_h;
+		record.out_w				= layer.out_w;
+		record.out_c				= layer.out_c;
+		record.inputs				= layer.inputs;
+		record.outputs				= layer.outputs;
+		record.index				= layer.index;
+		record.n					= layer.n;
+		record.groups				= layer.groups;
+		record.group_id				= layer.group_id;
+		record.size					= layer.size;
+		record.stride				= layer.stride;
+		record.stride_x				= layer.stride_x;
+		record.stride_y				= layer.stride_y;
+		record.dilation				= layer.dilation;
+		record.pad					= layer.pad;
+		record.batch_normalize		= layer.batch_normalize;
+		record.binary				= layer.binary;
+		record.xnor					= layer.xnor;
+		record.use_bin_output		= layer.use_bin_output;
+		record.antialiasing			= layer.antialiasing;
+		record.assisted_excitation	= layer.assisted_excitation;
+		record.deform				= layer.deform;
+		record.share_index			= (layer.share_layer ? layer.share_layer - layers.data() : -1);
+		record.sway					= layer.sway;
+		record.rotate				= layer.rotate;
+		record.stretch				= layer.stretch;
+		record.stretch_sway			= layer.stretch_sway;
+		record.flipped				= layer.flipped;
+		record.grad_centr			= layer.grad_centr;
+		record.coordconv			= layer.coordconv;
+		record.stream				= layer.stream;
+		record.wait_stream_id		= layer.wait_stream_id;
+		record.maxpool_depth		= layer.maxpool_depth;
+		record.out_channels			= layer.out_channels;
+		record.maxpool_zero_nonmax	= layer.maxpool_zero_nonmax;
+		record.classes				= layer.classes;
+		record.total				= layer.total;
+		record.new_coords			= layer.new_coords;
+		record.dot					= layer.dot;
+		record.angle				= layer.angle;
+		record.reverse				= layer.reverse;
+		record.scale				= layer.scale;
+		record.scale_x_y			= layer.scale_x_y;
+		record.workspace_size		= layer.workspace_size;
+
+		if (layer.type == ELayerType::kConvolutional and layer.antialiasing and layer.input_layer)
+		{
+			// the "host" layer of an antialiased convolution always uses a stride of 1, the real stride is in the blur layer
+			record.stride_x = layer.input_layer->stride_x;
+			record.stride_y = layer.input_layer->stride_y;
+		}
+
+		const int * values = nullptr;
+		if (layer.type == ELayerType::kRoute or layer.type == ELayerType::kShortcut)
+		{
+			values = layer.input_layers;
+		}
+		else if (layer.type == ELayerType::kYOLO)
+		{
+			values = layer.mask;
+		}
+
+		if (values)
+		{
+			record.index_offset	= indexes.size();
+			record.index_count	= layer.n;
+			indexes.insert(indexes.end(), values, values + layer.n);
+		}
+
+		records.push_back(record);
+	}
+
+	PlanHeader header;
+	std::memset(&header, '\0', sizeof(header));
+	std::memcpy(header.magic, kPlanMagic, sizeof(kPlanMagic));
+	header.version			= kPlanVersion;
+	header.header_size		= sizeof(PlanHeader);
+	header.settings_size	= sizeof(Settings);
+	header.layer_size		= sizeof(PlanLayer);
+	header.layer_count		= records.size();
+	header.steps_count		= steps.size();
+	header.scales_count		= scales.size();
+	header.seq_scales_count	= seq_scales.size();
+	header.index_count		= indexes.size();
+	header.workspace_size	= workspace_size;	// see Network::allocate_layers()
+
+	std::vector<int32_t> steps32(steps.begin(), steps.end());
+
+	std::ofstream ofs(plan_filename, std::ios::binary | std::ios::trunc);
+	ofs.write(reinterpret_cast<const char*>(&header)			, sizeof(header)							);
+	ofs.write(reinterpret_cast<const char*>(&settings)			, sizeof(settings)							);
+	ofs.write(reinterpret_cast<const char*>(steps32.data())		, steps32.size()	* sizeof(int32_t)		);
+	ofs.write(reinterpret_cast<const char*>(scales.data())		, scales.size()		* sizeof(float)			);
+	ofs.write(reinterpret_cast<const char*>(seq_scales.data())	, seq_scales.size()	* sizeof(float)			);
+	ofs.write(reinterpret_cast<const char*>(records.data())		, records.size()	* sizeof(PlanLayer)		);
+	ofs.write(reinterpret_cast<const char*>(indexes.data())		, indexes.size()	* sizeof(int32_t)		);
+
+	if (not ofs.good())
+	{
+		/// @throw Exception The plan could not be written to disk.
+		throw Exception("failed to write plan: \"" + plan_filename.string() + "\"", DNG_LOC);
+	}
+
+	return *this;
+}
+
+
+Darknet_ng::Network & Darknet_ng::Network::load_plan(const std::filesystem::path & plan_filename)
+{
+	clear();
+
+	const MappedFile file(plan_filename);
+
+	PlanHeader header;
+	if (file.size < sizeof(header))
+	{
+		/// @throw Exception The file is too small to be a plan.
+		throw Exception("invalid plan file: \"" + plan_filename.string() + "\"", DNG_LOC);
+	}
+	std::memcpy(&header, file.data, sizeof(header));
+
+	if (std::memcmp(header.magic, kPlanMagic, sizeof(kPlanMagic)) != 0	or
+		header.version			!= kPlanVersion							or
+		header.header_size		!= sizeof(PlanHeader)					or
+		header.settings_size	!= sizeof(Settings)						or
+		header.layer_size		!= sizeof(PlanLayer))
+	{
+		/// @throw Exception The plan was created by a different version of Darknet-NG.  Re-compile the @p .cfg file.
+		throw Exception("plan file is not compatible with this version of Darknet-NG: \"" + plan_filename.string() + "\"", DNG_LOC);
+	}
+
+	const size_t expected_size =
+		sizeof(PlanHeader)									+
+		sizeof(Settings)									+
+		header.steps_count		* sizeof(int32_t)			+
+		header.scales_count		* sizeof(float)				+
+		header.seq_scales_count	* sizeof(float)				+
+		header.layer_count		* sizeof(PlanLayer)			+
+		header.index_count		* sizeof(int32_t);
+
+	if (file.size != expected_size or header.layer_count == 0)
+	{
+		/// @throw Exception The plan file has been truncated or is otherwise corrupt.
+		throw Exception("plan file is corrupt: \"" + plan_filename.string() + "\"", DNG_LOC);
+	}
+
+	const uint8_t * ptr = file.data + sizeof(PlanHeader);
+
+	std::memcpy(&settings, ptr, sizeof(Settings));
+	ptr += sizeof(Settings);
+
+	const int32_t * steps32 = reinterpret_cast<const int32_t*>(ptr);
+	steps.assign(steps32, steps32 + header.steps_count);
+	ptr += header.steps_count * sizeof(int32_t);
+
+	const float * floats = reinterpret_cast<const float*>(ptr);
+	scales.assign(floats, floats + header.scales_count);
+	ptr += header.scales_count * sizeof(float);
+
+	floats = reinterpret_cast<const float*>(ptr);
+	seq_scales.assign(floats, floats + header.seq_scales_count);
+	ptr += header.seq_scales_count * sizeof(float);
+
+	const PlanLayer * records = reinterpret_cast<const PlanLayer*>(ptr);
+	ptr += header.layer_count * sizeof(PlanLayer);
+
+	const int32_t * indexes = reinterpret_cast<const int32_t*>(ptr);
+
+	layers.resize(header.layer_count);
+
+	for (size_t idx = 0; idx < layers.size(); idx ++)
+	{
+		const PlanLayer & record = records[idx];
+		Layer & layer = layers[idx];
+
+		const auto corrupt = [&](const std::string & reason)
+		{
+			return Exception("plan file is corrupt at layer #" + std::to_string(idx) + " (" + reason + "): \"" + plan_filename.string() + "\"", DNG_LOC);
+		};
+
+		if (record.index_offset < 0 or record.index_count < 0 or static_cast<uint64_t>(record.index_offset) + static_cast<uint64_t>(record.index_count) > header.index_count)
+		{
+			/// @throw Exception The layer references values outside of the index table.
+			throw corrupt("index table");
+		}
+
+		if (record.type < 0 or record.type >= static_cast<int32_t>(ELayerType::kMax))
+		{
+			/// @throw Exception The layer type is unknown.
+			throw corrupt("layer type " + std::to_string(record.type));
+		}
+
+		if (record.activation < 0 or record.activation >= static_cast<int32_t>(EActivation::kMax))
+		{
+			/// @throw Exception The activation is unknown.
+			throw corrupt("activation " + std::to_string(record.activation));
+		}
+
+		const ELayerType layer_type = static_cast<ELayerType>(record.type);
+
+		if (layer_type == ELayerType::kShortcut and not is_elementwise(static_cast<EActivation>(record.activation)))
+		{
+			/// @throw Exception Shortcut layers only support activations which can be applied to each value, see @ref parse_shortcut().
+			throw corrupt("shortcut activation " + std::to_string(record.activation));
+		}
+
+		/* The forward functions trust these values to index into the layers and the anchors, so they must be checked
+		 * here:  routes and shortcuts can only read from earlier layers, and the YOLO masks must be valid anchors.
+		 */
+		const bool has_indexes = (layer_type == ELayerType::kRoute or layer_type == ELayerType::kShortcut or layer_type == ELayerType::kYOLO);
+		if (has_indexes ? (record.index_count != record.n or record.n <= 0) : record.index_count != 0)
+		{
+			/// @throw Exception The number of indexes does not match the layer.
+			throw corrupt("index count " + std::to_string(record.index_count));
+		}
+
+		const int32_t index_limit = (layer_type == ELayerType::kYOLO ? record.total : static_cast<int32_t>(idx));
+		for (int32_t i = 0; i < record.index_count; i ++)
+		{
+			const int32_t value = indexes[record.index_offset + i];
+			if (value < 0 or value >= index_limit)
+			{
+				/// @throw Exception A route or shortcut references a later layer, or a YOLO mask references an anchor which does not exist.
+				throw corrupt("index " + std::to_string(value));
+			}
+		}
+
+		if (record.share_index >= static_cast<int32_t>(idx) or (record.share_index >= 0 and layers[record.share_index].type != ELayerType::kConvolutional))
+		{
+			/// @throw Exception The weights are shared with a layer which has not been created yet, or which has no weights.
+			throw corrupt("share index " + std::to_string(record.share_index));
+		}
+
+		/* The forward functions also trust the shape of each layer to size and index the activations, so the records
+		 * must describe the same shapes the parse functions would have built from the .cfg file.
+		 */
+		const int64_t inputs	= get_volume(record.h, record.w, record.c);
+		const int64_t outputs	= get_volume(record.out_h, record.out_w, record.out_c);
+		if (record.batch != settings.batch or inputs < 0 or outputs < 0)
+		{
+			/// @throw Exception The batch size or the dimensions of the layer are not valid.
+			throw corrupt("shape " + std::to_string(record.w) + " x " + std::to_string(record.h) + " x " + std::to_string(record.c) + " -> " + std::to_string(record.out_w) + " x " + std::to_string(record.out_h) + " x " + std::to_string(record.out_c));
+		}
+
+		if (layer_type == ELayerType::kRoute)
+		{
+			// a route reads from its own input layers rather than from the previous layer
+			const Layer & first = layers[indexes[record.index_offset]];
+			int64_t input_size		= 0;
+			int64_t input_channels	= 0;
+			for (int32_t i = 0; i < record.index_count; i ++)
+			{
+				const Layer & input_layer = layers[indexes[record.index_offset + i]];
+				if (input_layer.out_w != first.out_w or input_layer.out_h != first.out_h)
+				{
+					/// @throw Exception All the layers combined by a route must have the same width and height.
+					throw corrupt("route input #" + std::to_string(indexes[record.index_offset + i]));
+				}
+				input_size		+= input_layer.outputs;
+				input_channels	+= input_layer.out_c;
+			}
+
+			if (record.groups < 1 or record.group_id < 0 or record.group_id >= record.groups or
+				record.inputs != input_size or
+				record.out_w != first.out_w or record.out_h != first.out_h or record.out_c != input_channels / record.groups or
+				record.w != first.w or record.h != first.h or record.c != record.out_c)
+			{
+				/// @throw Exception The shape of the route does not match the layers it combines.
+				throw corrupt("route shape");
+			}
+		}
+		else
+		{
+			int h = settings.h;
+			int w = settings.w;
+			int c = settings.c;
+			if (idx > 0)
+			{
+				h = layers[idx - 1].out_h;
+				w = layers[idx - 1].out_w;
+				c = layers[idx - 1].out_c;
+			}
+
+			if (record.h != h or record.w != w or record.c != c)
+			{
+				/// @throw Exception The input of the layer does not match the output of the previous layer.
+				throw corrupt("input " + std::to_string(record.w) + " x " + std::to_string(record.h) + " x " + std::to_string(record.c) + " does not match " + std::to_string(w) + " x " + std::to_string(h) + " x " + std::to_string(c));
+			}
+
+			if (record.inputs != inputs)
+			{
+				/// @throw Exception The number of inputs does not match the input dimensions.
+				throw corrupt("inputs " + std::to_string(record.inputs));
+			}
+		}
+
+		if (record.outputs != outputs)
+		{
+			/// @throw Exception The number of outputs does not match the output dimensions.
+			throw corrupt("outputs " + std::to_string(record.outputs));
+		}
+
+		if (layer_type == ELayerType::kConvolutional)
+		{
+			if (record.n <= 0 or record.groups <= 0 or record.c % record.groups != 0 or record.n % record.groups != 0 or
+				record.size <= 0 or record.stride_x <= 0 or record.stride_y <= 0 or record.dilation <= 0 or record.pad < 0 or
+				std::max(record.h, record.w) + 2 * static_cast<int64_t>(record.pad) > std::numeric_limits<int32_t>::max() or
+				static_cast<int64_t>(record.c / record.groups) * record.n * record.size * record.size > std::numeric_limits<int32_t>::max())
+			{
+				/// @throw Exception The filters of the convolutional layer are not valid.
+				throw corrupt("convolutional filters");
+			}
+
+			Layer * share_layer = nullptr;
+			if (record.share_index >= 0)
+			{
+				share_layer = &layers[record.share_index];
+			}
+
+			make_convolutional_layer(
+				layer,
+				record.batch,
+				1,
+				record.h,
+				record.w,
+				record.c,
+				record.n,
+				record.groups,
+				record.size,
+				record.stride_x,
+				record.stride_y,
+				record.dilation,
+				record.pad,
+				static_cast<EActivation>(record.activation),
+				record.batch_normalize,
+				record.binary,
+				record.xnor,
+				settings.adam,
+				record.use_bin_output,
+				idx,
+				record.antialiasing,
+				share_layer,
+				record.assisted_excitation,
+				record.deform,
+				settings.train);
+
+			layer.sway				= record.sway;
+			layer.rotate			= record.rotate;
+			layer.stretch			= record.stretch;
+			layer.stretch_sway		= record.stretch_sway;
+			layer.flipped			= record.flipped;
+			layer.dot				= record.dot;
+			layer.angle				= record.angle;
+			layer.grad_centr		= record.grad_centr;
+			layer.reverse			= record.reverse;
+			layer.coordconv			= record.coordconv;
+			layer.stream			= record.stream;
+			layer.wait_stream_id	= record.wait_stream_id;
+
+			if (layer.out_h != record.out_h or layer.out_w != record.out_w or layer.out_c != record.out_c)
+			{
+				/// @throw Exception The output of the convolutional layer does not match its filters.
+				throw corrupt("convolutional output " + std::to_string(record.out_w) + " x " + std::to_string(record.out_h) + " x " + std::to_string(record.out_c));
+			}
+
+			if (settings.adam and layer.training)
+			{
+				layer.training->B1	= settings.B1;
+				layer.training->B2	= settings.B2;
+				layer.training->eps	= settings.eps;
+			}
+
+			continue;
+		}
+
+		bool valid_shape = true;
+		switch (layer_type)
+		{
+			case ELayerType::kMaxPool:
+			{
+				if (record.size <= 0 or record.stride_x <= 0 or record.stride_y <= 0 or record.pad < 0)
+				{
+					valid_shape = false;
+				}
+				else if (record.maxpool_depth)
+				{
+					valid_shape = (record.out_w == record.w and record.out_h == record.h and record.out_c == record.out_channels);
+				}
+				else
+				{
+					valid_shape =
+						record.out_w == (static_cast<int64_t>(record.w) + record.pad - record.size) / record.stride_x + 1 and
+						record.out_h == (static_cast<int64_t>(record.h) + record.pad - record.size) / record.stride_y + 1 and
+						record.out_c == record.c;
+				}
+				break;
+			}
+			case ELayerType::kUpsample:
+			{
+				// a "reverse" upsample layer is a downsample
+				valid_shape = (record.stride > 0 and record.out_c == record.c and
+					(record.reverse ?
+						(record.out_w == record.w / record.stride and record.out_h == record.h / record.stride) :
+						(record.out_w == static_cast<int64_t>(record.w) * record.stride and record.out_h == static_cast<int64_t>(record.h) * record.stride)));
+				break;
+			}
+			case ELayerType::kShortcut:
+			{
+				valid_shape = (record.out_w == record.w and record.out_h == record.h and record.out_c == record.c);
+				break;
+			}
+			case ELayerType::kYOLO:
+			{
+				valid_shape = (record.classes >= 0 and
+					record.c == static_cast<int64_t>(record.n) * (record.classes + 4 + 1) and
+					record.out_w == record.w and record.out_h == record.h and record.out_c == record.c);
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		if (not valid_shape)
+		{
+			/// @throw Exception The output of the layer does not match its input and settings.
+			throw corrupt("output " + std::to_string(record.out_w) + " x " + std::to_string(record.out_h) + " x " + std::to_string(record.out_c));
+		}
+
+		if (record.workspace_size != 0)
+		{
+			/// @throw Exception Only convolutional layers use the workspace.
+			throw corrupt("workspace size " + std::to_string(record.workspace_size));
+		}
+
+		/// @todo Once the other layer types are fully ported, they'll need to go through their own "make" functions.
+		layer.type					= layer_type;
+		layer.activation			= static_cast<EActivation>(record.activation);
+		layer.activation_kernel		= (is_elementwise(layer.activation) ? get_activation_kernel(layer.activation) : nullptr);
+		layer.train					= settings.train;
+		layer.batch					= record.batch;
+		layer.h						= record.h;
+		layer.w						= record.w;
+		layer.c						= record.c;
+		layer.out_h					= record.out_h;
+		layer.out_w					= record.out_w;
+		layer.out_c					= record.out_c;
+		layer.inputs				= record.inputs;
+		layer.outputs				= record.outputs;
+		layer.index					= record.index;
+		layer.n						= record.n;
+		layer.groups				= record.groups;
+		layer.group_id				= record.group_id;
+		layer.size					= record.size;
+		layer.stride				= record.stride;
+		layer.stride_x				= record.stride_x;
+		layer.stride_y				= record.stride_y;
+		layer.pad					= record.pad;
+		layer.antialiasing			= record.antialiasing;
+		layer.stream				= record.stream;
+		layer.wait_stream_id		= record.wait_stream_id;
+		layer.maxpool_depth			= record.maxpool_depth;
+		layer.out_channels			= record.out_channels;
+		layer.maxpool_zero_nonmax	= record.maxpool_zero_nonmax;
+		layer.classes				= record.classes;
+		layer.total					= record.total;
+		layer.new_coords			= record.new_coords;
+		layer.reverse				= record.reverse;
+		layer.scale					= record.scale;
+		layer.scale_x_y				= record.scale_x_y;
+		layer.workspace_size		= record.workspace_size;
+
+		if (record.index_count > 0)
+		{
+			int * values = (int*)xcalloc(record.index_count, sizeof(int));
+			std::copy(indexes + record.index_offset, indexes + record.index_offset + record.index_count, values);
+
+			if (layer_type == ELayerType::kYOLO)
+			{
+				layer.mask = values;
+			}
+			else
+			{
+				layer.input_layers = values;
+			}
+		}
+	}
+
+	allocate_layers();
+
+	return *this;
+}
@@ -0,0 +1,97 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::Network & Darknet_ng::Network::parse_route(const Darknet_ng::Section & section, const size_t layer_index)
+{
+	// was:  route_layer parse_route(list *options, size_params params);
+
+	const VI indexes = section.vi("layers");
+	if (indexes.empty())
+	{
+		/// @throw Exception The route layer must specify input layers.
+		throw Exception("[route] at line #" + std::to_string(section.line_number) + " must specify input layers", DNG_LOC);
+	}
+
+	Layer & layer = layers.at(layer_index);
+
+	layer.type			= ELayerType::kRoute;
+	layer.index			= layer_index;
+	layer.batch			= settings.batch;
+	layer.train			= settings.train;
+	layer.n				= indexes.size();
+	layer.groups		= section.i("groups"		, 1	);
+	layer.group_id		= section.i("group_id"		, 0	);
+	layer.stream		= section.i("stream"		, -1);
+	layer.wait_stream_id= section.i("wait_stream"	, -1);
+	layer.input_layers	= (int*)xcalloc(layer.n, sizeof(int));
+
+	if (layer.groups < 1)
+	{
+		layer.groups = 1;
+	}
+
+	for (int i = 0; i < layer.n; i ++)
+	{
+		layer.input_layers[i] = get_layer_index(section, layer_index, indexes[i]);
+	}
+
+	const Layer & first = layers.at(layer.input_layers[0]);
+	layer.out_w = first.out_w;
+	layer.out_h = first.out_h;
+	layer.out_c = first.out_c;
+	layer.inputs = first.outputs;
+
+	for (int i = 1; i < layer.n; i ++)
+	{
+		const Layer & next = layers.at(layer.input_layers[i]);
+		if (next.out_w != first.out_w or next.out_h != first.out_h)
+		{
+			/// @throw Exception All the layers combined by a route must have the same width and height.
+			throw Exception("[route] at line #" + std::to_string(section.line_number) + " combines layers with different width and height", DNG_LOC);
+		}
+		layer.out_c		+= next.out_c;
+		layer.inputs	+= next.outputs;
+	}
+
+	layer.out_c		= layer.out_c / layer.groups;
+	layer.w			= first.w;
+	layer.h			= first.h;
+	layer.c			= layer.out_c;
+	layer.outputs	= layer.out_w * layer.out_h * layer.out_c;
+
+	fprintf(stderr, "route      ");
+	for (int i = 0; i < layer.n; i ++)
+	{
+		fprintf(stderr, " %d", layer.input_layers[i]);
+	}
+	fprintf(stderr, " -> %4d x%4d x%4d\n", layer.out_w, layer.out_h, layer.out_c);
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_route_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_route_layer(const route_layer l, network_state state)
+
+	int offset = 0;
+	for (int i = 0; i < layer.n; ++i)
+	{
+		const Layer & input_layer	= state.layers[layer.input_layers[i]];
+		const int input_size		= input_layer.outputs;
+		const int part_input_size	= input_size / layer.groups;
+		for (int b = 0; b < layer.batch; ++b)
+		{
+			memcpy(
+				layer.output + offset + b * layer.outputs,
+				input_layer.output + b * input_size + part_input_size * layer.group_id,
+				part_input_size * sizeof(float));
+		}
+		offset += part_input_size;
+	}
+
+	return;
+}
@@ -0,0 +1,128 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::Network & Darknet_ng::Network::parse_shortcut(const Darknet_ng::Section & section, const size_t layer_index)
+{
+	// was:  layer parse_shortcut(list *options, size_params params, network net);
+
+	const VI indexes = section.vi("from");
+	if (indexes.empty())
+	{
+		/// @throw Exception The shortcut layer must specify input layers.
+		throw Exception("[shortcut] at line #" + std::to_string(section.line_number) + " must specify input layers with \"from=...\"", DNG_LOC);
+	}
+
+	const auto weights_type = section.s("weights_type", "none");
+	if (weights_type != "none")
+	{
+		/// @todo weighted shortcut layers need to be ported
+		throw Exception("[shortcut] at line #" + std::to_string(section.line_number) + " uses unsupported weights_type=" + weights_type, DNG_LOC);
+	}
+
+	int h = 0;
+	int w = 0;
+	int c = 0;
+	get_input_dimensions(layer_index, h, w, c);
+
+	Layer & layer = layers.at(layer_index);
+
+	layer.type			= ELayerType::kShortcut;
+	layer.batch			= settings.batch;
+	layer.train			= settings.train;
+	layer.activation	= activation_from_string(section.s("activation", "linear"));
+	if (not is_elementwise(layer.activation))
+	{
+		/// @throw Exception Shortcut layers only apply activations which work on each value by itself, such as leaky or mish.
+		throw Exception("[shortcut] at line #" + std::to_string(section.line_number) + " uses activation=" + to_string(layer.activation) + " which is not supported by shortcut layers", DNG_LOC);
+	}
+	layer.activation_kernel = get_activation_kernel(layer.activation);
+	layer.n				= indexes.size();
+	layer.input_layers	= (int*)xcalloc(layer.n, sizeof(int));
+
+	for (int i = 0; i < layer.n; i ++)
+	{
+		layer.input_layers[i] = get_layer_index(section, layer_index, indexes[i]);
+
+		const Layer & from = layers.at(layer.input_layers[i]);
+		if (from.out_w != w or from.out_h != h)
+		{
+			/// @throw Exception The shortcut layers must have the same width and height.
+			throw Exception("[shortcut] at line #" + std::to_string(section.line_number) + " combines layers with different width and height", DNG_LOC);
+		}
+	}
+
+	// like the original code, "index" is the first layer referenced by "from=..."
+	layer.index		= layer.input_layers[0];
+	layer.h			= h;
+	layer.w			= w;
+	layer.c			= c;
+	layer.out_h		= h;
+	layer.out_w		= w;
+	layer.out_c		= c;
+	layer.inputs	= h * w * c;
+	layer.outputs	= layer.inputs;
+
+	fprintf(stderr, "shortcut    %3d        %4d x%4d x%4d -> %4d x%4d x%4d\n", layer.index, w, h, c, layer.out_w, layer.out_h, layer.out_c);
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_shortcut_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_shortcut_layer(const layer l, network_state state)
+
+	const int size = layer.outputs * layer.batch;
+
+	const Layer & from = state.layers[layer.index];
+	if (layer.n == 1 and from.w == layer.w and from.h == layer.h and from.c == layer.c)
+	{
+		// this is the common case:  add the output of exactly one layer which has the same shape
+		const float * add = from.output;
+
+		#pragma omp parallel for
+		for (int i = 0; i < size; ++i)
+		{
+			layer.output[i] = state.input[i] + add[i];
+		}
+	}
+	else
+	{
+		// was:  shortcut_multilayer_cpu() without any weights; layers with fewer channels only add to the first channels
+		#pragma omp parallel for
+		for (int id = 0; id < size; ++id)
+		{
+			const int src_i = id % layer.outputs;
+			const int src_b = id / layer.outputs;
+
+			float sum = state.input[id];
+			for (int i = 0; i < layer.n; ++i)
+			{
+				const Layer & add = state.layers[layer.input_layers[i]];
+				if (src_i < add.outputs)
+				{
+					sum += add.output[add.outputs * src_b + src_i];
+				}
+			}
+			layer.output[id] = sum;
+		}
+	}
+
+	if (layer.activation_input and layer.activation == EActivation::kSWISH)
+	{
+		activate_array_swish(layer.output, size, layer.activation_input, layer.output);
+	}
+	else if (layer.activation_input and layer.activation == EActivation::kMISH)
+	{
+		activate_array_mish(layer.output, size, layer.activation_input, layer.output);
+	}
+	else
+	{
+		layer.activation_kernel(layer.output, size, 0.0f);
+	}
+
+	return;
+}
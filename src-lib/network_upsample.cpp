@@ -0,0 +1,105 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::Network & Darknet_ng::Network::parse_upsample(const Darknet_ng::Section & section, const size_t layer_index)
+{
+	// was:  layer parse_upsample(list *options, size_params params, network net);
+
+	int stride = section.i("stride", 2);
+
+	int h = 0;
+	int w = 0;
+	int c = 0;
+	get_input_dimensions(layer_index, h, w, c);
+
+	Layer & layer = layers.at(layer_index);
+
+	layer.type		= ELayerType::kUpsample;
+	layer.index		= layer_index;
+	layer.batch		= settings.batch;
+	layer.train		= settings.train;
+	layer.h			= h;
+	layer.w			= w;
+	layer.c			= c;
+	layer.scale		= section.f("scale", 1.0f);
+	layer.out_w		= w * stride;
+	layer.out_h		= h * stride;
+	layer.out_c		= c;
+
+	if (stride < 0)
+	{
+		// a negative stride means this is actually a "downsample" layer
+		stride			= -stride;
+		layer.reverse	= 1;
+		layer.out_w		= w / stride;
+		layer.out_h		= h / stride;
+	}
+	layer.stride	= stride;
+	layer.inputs	= h * w * c;
+	layer.outputs	= layer.out_h * layer.out_w * layer.out_c;
+
+	fprintf(stderr, "%s              %2dx  %4d x%4d x%4d -> %4d x%4d x%4d\n", (layer.reverse ? "downsample" : "upsample  "), stride, w, h, c, layer.out_w, layer.out_h, layer.out_c);
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_upsample_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_upsample_layer(const layer l, network_state net)
+
+	if (layer.blocked and not state.train)
+	{
+		// see Network::use_blocked_layout()
+		forward_blocked_upsample_layer(layer, state);
+		return;
+	}
+
+	const int w			= layer.w;
+	const int h			= layer.h;
+	const int stride	= layer.stride;
+	const float scale	= layer.scale;
+
+	if (layer.reverse)
+	{
+		// downsample:  every output is the sum of a stride x stride block of inputs
+		fill_cpu(layer.outputs * layer.batch, 0.0f, layer.output, 1);
+
+		#pragma omp parallel for
+		for (int bk = 0; bk < layer.batch * layer.c; ++bk)
+		{
+			// like the original code, the input is assumed to be exactly "stride" times larger than the output
+			const int in_w		= layer.out_w * stride;
+			const float * in	= state.input + bk * in_w * layer.out_h * stride;
+			float * out			= layer.output + bk * layer.out_w * layer.out_h;
+			for (int j = 0; j < layer.out_h * stride; ++j)
+			{
+				for (int i = 0; i < in_w; ++i)
+				{
+					out[(j / stride) * layer.out_w + i / stride] += scale * in[j * in_w + i];
+				}
+			}
+		}
+	}
+	else
+	{
+		#pragma omp parallel for
+		for (int bk = 0; bk < layer.batch * layer.c; ++bk)
+		{
+			const float * in	= state.input + bk * w * h;
+			float * out			= layer.output + bk * w * h * stride * stride;
+			for (int j = 0; j < h * stride; ++j)
+			{
+				for (int i = 0; i < w * stride; ++i)
+				{
+					out[j * w * stride + i] = scale * in[(j / stride) * w + i / stride];
+				}
+			}
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,113 @@
+// Darknet Next Gen - Darknet YOLO framework for computer vision / object detection.
+// MIT license applies.  See "license.txt" for details.
+
+#include "darknet-ng.hpp"
+
+
+Darknet_ng::Network & Darknet_ng::Network::parse_yolo(const Darknet_ng::Section & section, const size_t layer_index)
+{
+	// was:  layer parse_yolo(list *options, size_params params);
+
+	const int classes	= section.i("classes"	, 20);
+	const int total		= section.i("num"		, 1	);
+	VI mask				= section.vi("mask");
+
+	if (mask.empty())
+	{
+		// without a mask, all of the anchors are used by this layer
+		for (int i = 0; i < total; i ++)
+		{
+			mask.push_back(i);
+		}
+	}
+
+	int h = 0;
+	int w = 0;
+	int c = 0;
+	get_input_dimensions(layer_index, h, w, c);
+
+	Layer & layer = layers.at(layer_index);
+
+	/// @todo The anchors and the training half of the forward pass still need to be ported.
+	layer.type		= ELayerType::kYOLO;
+	layer.index		= layer_index;
+	layer.batch		= settings.batch;
+	layer.train		= settings.train;
+	layer.n			= mask.size();
+	layer.total		= total;
+	layer.classes	= classes;
+	layer.mask		= (int*)xcalloc(layer.n, sizeof(int));
+	layer.h			= h;
+	layer.w			= w;
+	layer.c			= layer.n * (classes + 4 + 1);
+	layer.out_h		= h;
+	layer.out_w		= w;
+	layer.out_c		= layer.c;
+	layer.outputs	= h * w * layer.n * (classes + 4 + 1);
+	layer.inputs	= layer.outputs;
+	layer.scale_x_y	= section.f("scale_x_y"	, 1.0f	);
+	layer.new_coords= section.i("new_coords", 0		);
+
+	for (int i = 0; i < layer.n; i ++)
+	{
+		layer.mask[i] = mask[i];
+	}
+
+	if (layer.outputs != h * w * c)
+	{
+		/// @throw Exception The number of filters in the previous layer does not match the YOLO classes and mask.
+		throw Exception("filters=" + std::to_string(c) + " in the layer prior to [yolo] at line #" + std::to_string(section.line_number) + " does not correspond to classes=" + std::to_string(classes) + " and mask", DNG_LOC);
+	}
+
+	fprintf(stderr, "yolo                   %4d x%4d x%4d -> %4d x%4d x%4d\n", w, h, c, layer.out_w, layer.out_h, layer.out_c);
+
+	return *this;
+}
+
+
+void Darknet_ng::forward_yolo_layer(Darknet_ng::Layer & layer, Darknet_ng::NetworkState & state)
+{
+	// was:  void forward_yolo_layer(const layer l, network_state state)
+
+	memcpy(layer.output, state.input, layer.outputs * layer.batch * sizeof(float));
+
+	// each anchor stores x, y, w, h, objectness, and the classes, each as a full w*h plane (see entry_index() in the original code)
+	const int wh		= layer.w * layer.h;
+	const float alpha	= layer.scale_x_y;
+	const float beta	= -0.5f * (layer.scale_x_y - 1.0f);
+
+	for (int b = 0; b < layer.batch; ++b)
+	{
+		for (int n = 0; n < layer.n; ++n)
+		{
+			float * entry = layer.output + b * layer.outputs + n * wh * (4 + layer.classes + 1);
+
+			if (not layer.new_coords)
+			{
+				// x, y, then objectness and all of the classes go through a logistic activation
+				for (int i = 0; i < 2 * wh; ++i)
+				{
+					entry[i] = logistic_activate(entry[i]);
+				}
+				for (int i = 4 * wh; i < (4 + 1 + layer.classes) * wh; ++i)
+				{
+					entry[i] = logistic_activate(entry[i]);
+				}
+			}
+
+			// scale x and y
+			for (int i = 0; i < 2 * wh; ++i)
+			{
+				entry[i] = entry[i] * alpha + beta;
+			}
+		}
+	}
+
+	if (state.train)
+	{
+		/// @throw Exception The training half of the YOLO layer has not been ported.
+		throw Exception("training is not yet supported by [yolo] layer #" + std::to_string(layer.index), DNG_LOC);
+	}
+
+	return;
+}
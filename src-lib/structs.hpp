@@ -8,6 +8,9 @@
 
 namespace Darknet_ng
 {
+	class Network;
+	struct Layer;
+
 #ifdef OLD_UNUSED /// @todo remove?
 	struct Section // was: section
 	{
@@ -55,17 +58,19 @@ namespace Darknet_ng
 		int		t;
 	};
 
+	/** Everything a layer needs to know about the network while it runs.  This is passed by reference to every layer
+	 * kernel, so unlike the original @p network_state the network is referenced by pointer instead of being copied.
+	 */
 	struct NetworkState /// was: network_state
 	{
 		float *truth;
-		float *input;
+		const float *input;
 		float *delta;
 		float *workspace;
 		int train;
 		int index;
-#if 0 /// @todo
-		Network net;
-#endif
+		const Network * net;	///< the network being run
+		const Layer * layers;	///< the layers being run, used by layers such as routes to find the output of other layers @see @ref InferenceContext
 	};
 
 	struct Box /// was: box